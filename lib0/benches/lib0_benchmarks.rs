@@ -1,9 +1,41 @@
 use criterion::{criterion_group, criterion_main, Criterion, SamplingMode};
+use lib0::any::Any;
+use lib0::compact::CompactAny;
 use lib0::decoding::{Cursor, Read};
 use lib0::encoding::Write;
+use std::collections::HashMap;
 
 const BENCHMARK_SIZE: u32 = 100000;
 
+/// Spreads consecutive numbers over the whole 32-bit range, so that their variable length
+/// encoding uses all possible byte lengths.
+fn spread_u32(i: u32) -> u32 {
+    i.wrapping_mul(0x9E37_79B9) >> (i % 32)
+}
+
+/// Spreads consecutive numbers over the whole 64-bit range, so that their variable length
+/// encoding uses all possible byte lengths.
+fn spread_u64(i: u64) -> u64 {
+    i.wrapping_mul(0x9E37_79B9_7F4A_7C15) >> (i % 64)
+}
+
+/// Builds an array of small JSON-like objects, resembling a typical map-heavy document payload.
+fn sample_objects(count: u32) -> Any {
+    let mut values = Vec::with_capacity(count as usize);
+    for i in 0..count {
+        let mut map = HashMap::new();
+        map.insert("id".to_owned(), Any::BigInt(i as i64));
+        map.insert("name".to_owned(), Any::String(format!("item-{}", i)));
+        map.insert("done".to_owned(), Any::Bool(i % 2 == 0));
+        map.insert(
+            "tags".to_owned(),
+            Any::Array(vec![Any::String("a".to_owned()), Any::Number(i as f64)]),
+        );
+        values.push(Any::Map(map));
+    }
+    Any::Array(values)
+}
+
 fn criterion_benchmark(c: &mut Criterion) {
     let mut group = c.benchmark_group("encoding");
     group.sampling_mode(SamplingMode::Flat);
@@ -36,6 +68,18 @@ fn criterion_benchmark(c: &mut Criterion) {
         })
     });
 
+    group.bench_function("var_uint slice (32 bit)", |b| {
+        let values: Vec<u32> = (0..BENCHMARK_SIZE).collect();
+        b.iter(|| {
+            let mut encoder = Vec::with_capacity(BENCHMARK_SIZE as usize * 8);
+            encoder.write_uvar_slice(&values);
+            let mut decoder = Cursor::from(&encoder);
+            let mut decoded: Vec<u32> = Vec::new();
+            decoder.read_uvar_into(values.len(), &mut decoded);
+            assert_eq!(decoded, values);
+        })
+    });
+
     group.bench_function("uint32", |b| {
         b.iter(|| {
             let mut encoder = Vec::with_capacity(BENCHMARK_SIZE as usize * 8);
@@ -64,6 +108,48 @@ fn criterion_benchmark(c: &mut Criterion) {
         })
     });
 
+    group.bench_function("var_uint (32 bit, large values)", |b| {
+        b.iter(|| {
+            let mut encoder = Vec::with_capacity(BENCHMARK_SIZE as usize * 8);
+            for i in 0..BENCHMARK_SIZE {
+                encoder.write_uvar(spread_u32(i));
+            }
+            let mut decoder = Cursor::from(&encoder);
+            for i in 0..BENCHMARK_SIZE {
+                let num: u32 = decoder.read_uvar();
+                assert_eq!(num, spread_u32(i));
+            }
+        })
+    });
+
+    group.bench_function("var_uint (64 bit, large values)", |b| {
+        b.iter(|| {
+            let mut encoder = Vec::with_capacity(BENCHMARK_SIZE as usize * 10);
+            for i in 0..(BENCHMARK_SIZE as u64) {
+                encoder.write_uvar(spread_u64(i));
+            }
+            let mut decoder = Cursor::from(&encoder);
+            for i in 0..(BENCHMARK_SIZE as u64) {
+                let num: u64 = decoder.read_uvar();
+                assert_eq!(num, spread_u64(i));
+            }
+        })
+    });
+
+    group.bench_function("var_int (64 bit, large values)", |b| {
+        b.iter(|| {
+            let mut encoder = Vec::with_capacity(BENCHMARK_SIZE as usize * 10);
+            for i in 0..(BENCHMARK_SIZE as u64) {
+                encoder.write_ivar(spread_u64(i) as i64 >> 8);
+            }
+            let mut decoder = Cursor::from(&encoder);
+            for i in 0..(BENCHMARK_SIZE as u64) {
+                let num = decoder.read_ivar();
+                assert_eq!(num, spread_u64(i) as i64 >> 8);
+            }
+        })
+    });
+
     group.bench_function("uint64", |b| {
         b.iter(|| {
             let mut encoder = Vec::with_capacity(BENCHMARK_SIZE as usize * 8);
@@ -78,6 +164,50 @@ fn criterion_benchmark(c: &mut Criterion) {
         })
     });
 
+    group.bench_function("string (validated)", |b| {
+        let mut encoder = Vec::new();
+        for i in 0..BENCHMARK_SIZE {
+            encoder.write_string(&format!("zażółć gęślą jaźń {}", i));
+        }
+        b.iter(|| {
+            let mut decoder = Cursor::from(&encoder);
+            for _ in 0..BENCHMARK_SIZE {
+                decoder.read_string();
+            }
+        })
+    });
+
+    group.bench_function("string (trusted)", |b| {
+        let mut encoder = Vec::new();
+        for i in 0..BENCHMARK_SIZE {
+            encoder.write_string(&format!("zażółć gęślą jaźń {}", i));
+        }
+        b.iter(|| {
+            let mut decoder = unsafe { Cursor::new_trusted(&encoder) };
+            for _ in 0..BENCHMARK_SIZE {
+                decoder.read_string();
+            }
+        })
+    });
+
+    group.bench_function("any (objects)", |b| {
+        let mut encoder = Vec::new();
+        sample_objects(BENCHMARK_SIZE / 10).encode(&mut encoder);
+        b.iter(|| {
+            let mut decoder = Cursor::from(&encoder);
+            Any::decode(&mut decoder)
+        })
+    });
+
+    group.bench_function("compact any (objects)", |b| {
+        let mut encoder = Vec::new();
+        sample_objects(BENCHMARK_SIZE / 10).encode(&mut encoder);
+        b.iter(|| {
+            let mut decoder = Cursor::from(&encoder);
+            CompactAny::decode(&mut decoder)
+        })
+    });
+
     group.finish();
 }
 
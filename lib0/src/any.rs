@@ -1,8 +1,9 @@
 use crate::decoding::Read;
-use crate::encoding::Write;
+use crate::encoding::{buf_len, ivar_len, uvar_len, Write};
 use std::cmp::PartialEq;
 use std::collections::HashMap;
 use std::convert::TryInto;
+use std::rc::Rc;
 
 #[derive(Debug, Clone, PartialEq)]
 pub enum Any {
@@ -12,56 +13,55 @@ pub enum Any {
     Number(f64),
     BigInt(i64),
     String(String),
-    Buffer(Box<[u8]>),
+    /// Binary payload. It's reference counted, so that large buffers can be shared between
+    /// decoded updates, document store and values read from it without copying.
+    Buffer(Rc<[u8]>),
     Array(Vec<Any>),
     Map(HashMap<String, Any>),
 }
 
 impl Any {
+    /// Decodes a value encoded using [Any::encode]. Nested arrays and maps are decoded
+    /// iteratively, using an explicit stack instead of recursion, so that deeply nested
+    /// payloads cannot overflow the call stack.
     pub fn decode<R: Read>(decoder: &mut R) -> Self {
-        match decoder.read_u8() {
-            // CASE 127: undefined
-            127 => Any::Undefined,
-            // CASE 126: null
-            126 => Any::Null,
-            // CASE 125: integer
-            125 => Any::Number(decoder.read_ivar() as f64),
-            // CASE 124: float32
-            124 => Any::Number(decoder.read_f32() as f64),
-            // CASE 123: float64
-            123 => Any::Number(decoder.read_f64()),
-            // CASE 122: bigint
-            122 => Any::BigInt(decoder.read_i64()),
-            // CASE 121: boolean (false)
-            121 => Any::Bool(false),
-            // CASE 120: boolean (true)
-            120 => Any::Bool(true),
-            // CASE 119: string
-            119 => Any::String(decoder.read_string().to_owned()),
-            // CASE 118: Map<string,Any>
-            118 => {
-                let len: usize = decoder.read_uvar();
-                let mut map = HashMap::with_capacity(len);
-                for _ in 0..len {
-                    let key = decoder.read_string();
-                    map.insert(key.to_owned(), Any::decode(decoder));
+        decode_iterative(decoder)
+    }
+
+    /// Returns a number of bytes used by [Any::encode] to encode current value.
+    pub fn encoded_len(&self) -> usize {
+        match self {
+            Any::Undefined | Any::Null | Any::Bool(_) => 1,
+            Any::String(str) => 1 + buf_len(str.len()),
+            Any::Number(num) => {
+                let num_truncated = num.trunc();
+                if num_truncated == *num
+                    && num_truncated <= crate::number::F64_MAX_SAFE_INTEGER
+                    && num_truncated >= crate::number::F64_MIN_SAFE_INTEGER
+                {
+                    1 + ivar_len(num_truncated as i64)
+                } else if ((*num as f32) as f64) == *num {
+                    1 + 4
+                } else {
+                    1 + 8
                 }
-                Any::Map(map)
             }
-            // CASE 117: Array<Any>
-            117 => {
-                let len: usize = decoder.read_uvar();
-                let mut arr = Vec::with_capacity(len);
-                for _ in 0..len {
-                    arr.push(Any::decode(decoder));
+            Any::BigInt(_) => 1 + 8,
+            Any::Array(arr) => {
+                let mut len = 1 + uvar_len(arr.len());
+                for el in arr.iter() {
+                    len += el.encoded_len();
                 }
-                Any::Array(arr)
+                len
             }
-            // CASE 116: buffer
-            116 => Any::Buffer(Box::from(decoder.read_buf().to_owned())),
-            _ => {
-                panic!("Unable to read Any content");
+            Any::Map(map) => {
+                let mut len = 1 + uvar_len(map.len());
+                for (key, value) in map.iter() {
+                    len += buf_len(key.len()) + value.encoded_len();
+                }
+                len
             }
+            Any::Buffer(buf) => 1 + buf_len(buf.len()),
         }
     }
 
@@ -247,15 +247,21 @@ impl Into<Any> for &str {
     }
 }
 
-impl Into<Any> for Box<[u8]> {
+impl Into<Any> for Rc<[u8]> {
     fn into(self) -> Any {
         Any::Buffer(self)
     }
 }
 
+impl Into<Any> for Box<[u8]> {
+    fn into(self) -> Any {
+        Any::Buffer(Rc::from(self))
+    }
+}
+
 impl Into<Any> for Vec<u8> {
     fn into(self) -> Any {
-        Any::Buffer(self.into_boxed_slice())
+        Any::Buffer(Rc::from(self))
     }
 }
 
@@ -327,3 +333,188 @@ impl TryInto<Any> for usize {
         (self as u64).try_into()
     }
 }
+
+/// Common interface of JSON-like value representations, which can be decoded from lib0 [Any]
+/// encoding format by [decode_iterative].
+pub(crate) trait AnyDecode: Sized {
+    type Key;
+    type Entries;
+
+    fn undefined() -> Self;
+    fn null() -> Self;
+    fn bool(value: bool) -> Self;
+    fn number(value: f64) -> Self;
+    fn bigint(value: i64) -> Self;
+    fn string(value: &str) -> Self;
+    fn buffer(value: &[u8]) -> Self;
+    fn key(key: &str) -> Self::Key;
+    fn array(values: Vec<Self>) -> Self;
+    fn map_with_capacity(capacity: usize) -> Self::Entries;
+    fn map_insert(map: &mut Self::Entries, key: Self::Key, value: Self);
+    fn map(map: Self::Entries) -> Self;
+}
+
+impl AnyDecode for Any {
+    type Key = String;
+    type Entries = HashMap<String, Any>;
+
+    #[inline]
+    fn undefined() -> Self {
+        Any::Undefined
+    }
+
+    #[inline]
+    fn null() -> Self {
+        Any::Null
+    }
+
+    #[inline]
+    fn bool(value: bool) -> Self {
+        Any::Bool(value)
+    }
+
+    #[inline]
+    fn number(value: f64) -> Self {
+        Any::Number(value)
+    }
+
+    #[inline]
+    fn bigint(value: i64) -> Self {
+        Any::BigInt(value)
+    }
+
+    #[inline]
+    fn string(value: &str) -> Self {
+        Any::String(value.to_owned())
+    }
+
+    #[inline]
+    fn buffer(value: &[u8]) -> Self {
+        Any::Buffer(Rc::from(value))
+    }
+
+    #[inline]
+    fn key(key: &str) -> Self::Key {
+        key.to_owned()
+    }
+
+    #[inline]
+    fn array(values: Vec<Self>) -> Self {
+        Any::Array(values)
+    }
+
+    #[inline]
+    fn map_with_capacity(capacity: usize) -> Self::Entries {
+        HashMap::with_capacity(capacity)
+    }
+
+    #[inline]
+    fn map_insert(map: &mut Self::Entries, key: Self::Key, value: Self) {
+        map.insert(key, value);
+    }
+
+    #[inline]
+    fn map(map: Self::Entries) -> Self {
+        Any::Map(map)
+    }
+}
+
+/// Decodes a non-container value identified by a given `tag`. It's shared by all [AnyDecode]
+/// implementations, so that they always recognize the same encoding table.
+fn decode_primitive<T: AnyDecode, R: Read>(tag: u8, decoder: &mut R) -> T {
+    match tag {
+        // CASE 127: undefined
+        127 => T::undefined(),
+        // CASE 126: null
+        126 => T::null(),
+        // CASE 125: integer
+        125 => T::number(decoder.read_ivar() as f64),
+        // CASE 124: float32
+        124 => T::number(decoder.read_f32() as f64),
+        // CASE 123: float64
+        123 => T::number(decoder.read_f64()),
+        // CASE 122: bigint
+        122 => T::bigint(decoder.read_i64()),
+        // CASE 121: boolean (false)
+        121 => T::bool(false),
+        // CASE 120: boolean (true)
+        120 => T::bool(true),
+        // CASE 119: string
+        119 => T::string(decoder.read_string()),
+        // CASE 116: buffer
+        116 => T::buffer(decoder.read_buf()),
+        _ => {
+            panic!("Unable to read Any content");
+        }
+    }
+}
+
+/// A partially decoded container value.
+enum Frame<T: AnyDecode> {
+    Array(Vec<T>, usize),
+    Map(T::Entries, Option<T::Key>, usize),
+}
+
+/// Decodes a JSON-like value without recursion: containers which are not fully decoded yet are
+/// kept on an explicit stack.
+pub(crate) fn decode_iterative<T: AnyDecode, R: Read>(decoder: &mut R) -> T {
+    let mut stack: Vec<Frame<T>> = Vec::new();
+    loop {
+        let mut value = match decoder.read_u8() {
+            // CASE 118: Map<string,Any>
+            118 => {
+                let len: usize = decoder.read_uvar();
+                let map = T::map_with_capacity(len);
+                if len == 0 {
+                    T::map(map)
+                } else {
+                    let key = T::key(decoder.read_string());
+                    stack.push(Frame::Map(map, Some(key), len));
+                    continue;
+                }
+            }
+            // CASE 117: Array<Any>
+            117 => {
+                let len: usize = decoder.read_uvar();
+                if len == 0 {
+                    T::array(Vec::new())
+                } else {
+                    stack.push(Frame::Array(Vec::with_capacity(len), len));
+                    continue;
+                }
+            }
+            tag => decode_primitive(tag, decoder),
+        };
+
+        // attach decoded value to its parent, completing all containers which are full
+        loop {
+            match stack.last_mut() {
+                None => return value,
+                Some(Frame::Array(values, len)) => {
+                    values.push(value);
+                    if values.len() < *len {
+                        break;
+                    }
+                    if let Some(Frame::Array(values, _)) = stack.pop() {
+                        value = T::array(values);
+                    } else {
+                        unreachable!()
+                    }
+                }
+                Some(Frame::Map(map, key, remaining)) => {
+                    T::map_insert(map, key.take().unwrap(), value);
+                    *remaining -= 1;
+                    if *remaining > 0 {
+                        *key = Some(T::key(decoder.read_string()));
+                        break;
+                    }
+                    if let Some(Frame::Map(map, _, _)) = stack.pop() {
+                        value = T::map(map);
+                    } else {
+                        unreachable!()
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,286 @@
+use crate::any::{decode_iterative, Any, AnyDecode};
+use crate::decoding::Read;
+use crate::encoding::Write;
+use std::collections::HashMap;
+use std::rc::Rc;
+
+/// Compact, read-optimized equivalent of [Any]. It uses the same binary encoding format, but:
+///
+/// - Short strings are stored inline, without a separate heap allocation.
+/// - Maps are stored as vectors of entries sorted by their keys instead of hash maps, which is
+///   cheaper to build and more compact for small objects, which are the majority of JSON-like
+///   payloads.
+///
+/// It can be freely converted from and into [Any].
+#[derive(Debug, Clone, PartialEq)]
+pub enum CompactAny {
+    Null,
+    Undefined,
+    Bool(bool),
+    Number(f64),
+    BigInt(i64),
+    String(SmallString),
+    Buffer(Rc<[u8]>),
+    Array(Vec<CompactAny>),
+    Map(CompactMap),
+}
+
+impl CompactAny {
+    /// Decodes a value encoded using [Any::encode] or [CompactAny::encode]. Like [Any::decode]
+    /// it doesn't use recursion.
+    pub fn decode<R: Read>(decoder: &mut R) -> Self {
+        decode_iterative(decoder)
+    }
+
+    /// Encodes current value using the same format as [Any::encode].
+    pub fn encode<W: Write>(&self, encoder: &mut W) {
+        match self {
+            CompactAny::Undefined => encoder.write_u8(127),
+            CompactAny::Null => encoder.write_u8(126),
+            CompactAny::Bool(bool) => encoder.write_u8(if *bool { 120 } else { 121 }),
+            CompactAny::Number(num) => Any::Number(*num).encode(encoder),
+            CompactAny::BigInt(num) => Any::BigInt(*num).encode(encoder),
+            CompactAny::String(str) => {
+                encoder.write_u8(119);
+                encoder.write_string(str.as_str());
+            }
+            CompactAny::Buffer(buf) => {
+                encoder.write_u8(116);
+                encoder.write_buf(buf);
+            }
+            CompactAny::Array(values) => {
+                encoder.write_u8(117);
+                encoder.write_uvar(values.len());
+                for value in values.iter() {
+                    value.encode(encoder);
+                }
+            }
+            CompactAny::Map(map) => {
+                encoder.write_u8(118);
+                encoder.write_uvar(map.len());
+                for (key, value) in map.iter() {
+                    encoder.write_string(key);
+                    value.encode(encoder);
+                }
+            }
+        }
+    }
+}
+
+impl AnyDecode for CompactAny {
+    type Key = SmallString;
+    type Entries = Vec<(SmallString, CompactAny)>;
+
+    #[inline]
+    fn undefined() -> Self {
+        CompactAny::Undefined
+    }
+
+    #[inline]
+    fn null() -> Self {
+        CompactAny::Null
+    }
+
+    #[inline]
+    fn bool(value: bool) -> Self {
+        CompactAny::Bool(value)
+    }
+
+    #[inline]
+    fn number(value: f64) -> Self {
+        CompactAny::Number(value)
+    }
+
+    #[inline]
+    fn bigint(value: i64) -> Self {
+        CompactAny::BigInt(value)
+    }
+
+    #[inline]
+    fn string(value: &str) -> Self {
+        CompactAny::String(SmallString::from(value))
+    }
+
+    #[inline]
+    fn buffer(value: &[u8]) -> Self {
+        CompactAny::Buffer(Rc::from(value))
+    }
+
+    #[inline]
+    fn key(key: &str) -> Self::Key {
+        SmallString::from(key)
+    }
+
+    #[inline]
+    fn array(values: Vec<Self>) -> Self {
+        CompactAny::Array(values)
+    }
+
+    #[inline]
+    fn map_with_capacity(capacity: usize) -> Self::Entries {
+        Vec::with_capacity(capacity)
+    }
+
+    #[inline]
+    fn map_insert(map: &mut Self::Entries, key: Self::Key, value: Self) {
+        map.push((key, value));
+    }
+
+    #[inline]
+    fn map(map: Self::Entries) -> Self {
+        CompactAny::Map(CompactMap::from(map))
+    }
+}
+
+impl From<Any> for CompactAny {
+    fn from(any: Any) -> Self {
+        match any {
+            Any::Null => CompactAny::Null,
+            Any::Undefined => CompactAny::Undefined,
+            Any::Bool(v) => CompactAny::Bool(v),
+            Any::Number(v) => CompactAny::Number(v),
+            Any::BigInt(v) => CompactAny::BigInt(v),
+            Any::String(v) => CompactAny::String(SmallString::from(v.as_str())),
+            Any::Buffer(v) => CompactAny::Buffer(v),
+            Any::Array(v) => CompactAny::Array(v.into_iter().map(CompactAny::from).collect()),
+            Any::Map(v) => CompactAny::Map(CompactMap::from(
+                v.into_iter()
+                    .map(|(key, value)| (SmallString::from(key.as_str()), value.into()))
+                    .collect::<Vec<_>>(),
+            )),
+        }
+    }
+}
+
+impl From<CompactAny> for Any {
+    fn from(any: CompactAny) -> Self {
+        match any {
+            CompactAny::Null => Any::Null,
+            CompactAny::Undefined => Any::Undefined,
+            CompactAny::Bool(v) => Any::Bool(v),
+            CompactAny::Number(v) => Any::Number(v),
+            CompactAny::BigInt(v) => Any::BigInt(v),
+            CompactAny::String(v) => Any::String(v.as_str().to_owned()),
+            CompactAny::Buffer(v) => Any::Buffer(v),
+            CompactAny::Array(v) => Any::Array(v.into_iter().map(Any::from).collect()),
+            CompactAny::Map(v) => {
+                let mut map = HashMap::with_capacity(v.len());
+                for (key, value) in v.0 {
+                    map.insert(key.as_str().to_owned(), value.into());
+                }
+                Any::Map(map)
+            }
+        }
+    }
+}
+
+/// Maximum length (in bytes) of a string, which can be stored inline by [SmallString].
+const INLINE_CAPACITY: usize = 22;
+
+/// Immutable string, which stores strings up to 22 bytes inline, without heap allocation.
+#[derive(Clone)]
+pub enum SmallString {
+    Inline(u8, [u8; INLINE_CAPACITY]),
+    Heap(Box<str>),
+}
+
+impl SmallString {
+    pub fn as_str(&self) -> &str {
+        match self {
+            SmallString::Inline(len, buf) => unsafe {
+                // inline buffer is always filled from a valid string slice
+                std::str::from_utf8_unchecked(&buf[..(*len as usize)])
+            },
+            SmallString::Heap(str) => str,
+        }
+    }
+}
+
+impl<'a> From<&'a str> for SmallString {
+    fn from(str: &'a str) -> Self {
+        if str.len() <= INLINE_CAPACITY {
+            let mut buf = [0u8; INLINE_CAPACITY];
+            buf[..str.len()].copy_from_slice(str.as_bytes());
+            SmallString::Inline(str.len() as u8, buf)
+        } else {
+            SmallString::Heap(Box::from(str))
+        }
+    }
+}
+
+impl std::ops::Deref for SmallString {
+    type Target = str;
+
+    #[inline]
+    fn deref(&self) -> &Self::Target {
+        self.as_str()
+    }
+}
+
+impl PartialEq for SmallString {
+    fn eq(&self, other: &Self) -> bool {
+        self.as_str() == other.as_str()
+    }
+}
+
+impl Eq for SmallString {}
+
+impl PartialOrd for SmallString {
+    fn partial_cmp(&self, other: &Self) -> Option<std::cmp::Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for SmallString {
+    fn cmp(&self, other: &Self) -> std::cmp::Ordering {
+        self.as_str().cmp(other.as_str())
+    }
+}
+
+impl std::fmt::Debug for SmallString {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        std::fmt::Debug::fmt(self.as_str(), f)
+    }
+}
+
+/// Map of JSON-like object entries, stored as a vector sorted by entry keys.
+#[derive(Debug, Clone, PartialEq, Default)]
+pub struct CompactMap(Vec<(SmallString, CompactAny)>);
+
+impl CompactMap {
+    pub fn len(&self) -> usize {
+        self.0.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.0.is_empty()
+    }
+
+    /// Returns a value stored under a given `key`, if any.
+    pub fn get(&self, key: &str) -> Option<&CompactAny> {
+        let idx = self.0.binary_search_by(|(k, _)| k.as_str().cmp(key)).ok()?;
+        Some(&self.0[idx].1)
+    }
+
+    /// Returns an iterator over map entries in order of their keys.
+    pub fn iter(&self) -> impl Iterator<Item = (&str, &CompactAny)> {
+        self.0.iter().map(|(k, v)| (k.as_str(), v))
+    }
+}
+
+impl From<Vec<(SmallString, CompactAny)>> for CompactMap {
+    /// Creates a map from a list of entries. If the same key is used more than once, the last
+    /// entry wins, just like when inserting entries into a [HashMap] one by one.
+    fn from(mut entries: Vec<(SmallString, CompactAny)>) -> Self {
+        // stable sort keeps entries with equal keys in insertion order
+        entries.sort_by(|a, b| a.0.cmp(&b.0));
+        let mut deduped: Vec<(SmallString, CompactAny)> = Vec::with_capacity(entries.len());
+        for entry in entries {
+            match deduped.last_mut() {
+                Some(last) if last.0 == entry.0 => *last = entry,
+                _ => deduped.push(entry),
+            }
+        }
+        CompactMap(deduped)
+    }
+}
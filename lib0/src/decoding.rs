@@ -1,16 +1,42 @@
 use crate::binary;
+use crate::number::Uint;
+use crate::utf8;
 use core::panic;
+use std::convert::TryInto;
 use std::mem::MaybeUninit;
 
 #[derive(Default)]
 pub struct Cursor<'a> {
     pub buf: &'a [u8],
     pub next: usize,
+    /// If set, strings read from this cursor are not validated as UTF-8.
+    trusted: bool,
 }
 
 impl<'a> Cursor<'a> {
     pub fn new(buf: &'a [u8]) -> Cursor<'a> {
-        Cursor { buf, next: 0 }
+        Cursor {
+            buf,
+            next: 0,
+            trusted: false,
+        }
+    }
+
+    /// Creates a cursor over a buffer, which is known to contain only valid UTF-8 strings, eg.
+    /// because it was produced by a local encoder or it has already been read and validated once
+    /// before. Strings read from such cursor are returned as borrowed slices without validating
+    /// them again.
+    ///
+    /// # Safety
+    ///
+    /// Every string read from a returned cursor must be a valid UTF-8 sequence. Reading a string
+    /// containing invalid UTF-8 is undefined behavior.
+    pub unsafe fn new_trusted(buf: &'a [u8]) -> Cursor<'a> {
+        Cursor {
+            buf,
+            next: 0,
+            trusted: true,
+        }
     }
 }
 
@@ -37,6 +63,166 @@ impl<'a> Read for Cursor<'a> {
         self.next += len as usize;
         slice
     }
+
+    /// Read unsigned integer with variable length. When there are at least 10 bytes left in
+    /// the buffer, up to 10 bytes of a number are decoded at once, with a single bounds check.
+    fn read_uvar<T: Uint>(&mut self) -> T {
+        if self.buf.len() - self.next >= 10 {
+            let chunk = &self.buf[self.next..(self.next + 10)];
+            let word = u64::from_le_bytes(chunk[..8].try_into().unwrap());
+            let stops = !word & CONTINUATION_BITS;
+            if stops != 0 {
+                // number fits into the first 8 bytes
+                let bits = stops.trailing_zeros() + 1;
+                let word = if bits == 64 {
+                    word
+                } else {
+                    word & ((1 << bits) - 1)
+                };
+                self.next += (bits / 8) as usize;
+                return T::from_u64(compact_7bit_groups(word));
+            } else if chunk[8] < binary::BIT8 {
+                self.next += 9;
+                let num = compact_7bit_groups(word) | (chunk[8] as u64) << 56;
+                return T::from_u64(num);
+            } else if chunk[9] <= 1 {
+                self.next += 10;
+                let num = compact_7bit_groups(word)
+                    | ((chunk[8] & binary::BITS7) as u64) << 56
+                    | (chunk[9] as u64) << 63;
+                return T::from_u64(num);
+            }
+            // number doesn't fit into 64 bits
+        }
+        read_uvar_bytewise(self)
+    }
+
+    /// Read signed integer with variable length. When there are at least 8 bytes left in
+    /// the buffer, numbers up to 8 bytes long are decoded at once.
+    fn read_ivar(&mut self) -> i64 {
+        if self.buf.len() - self.next >= 8 {
+            let chunk = &self.buf[self.next..(self.next + 8)];
+            let word = u64::from_le_bytes(chunk.try_into().unwrap());
+            let stops = !word & CONTINUATION_BITS;
+            if stops != 0 {
+                let bits = stops.trailing_zeros() + 1;
+                let word = if bits == 64 {
+                    word
+                } else {
+                    word & ((1 << bits) - 1)
+                };
+                self.next += (bits / 8) as usize;
+                let is_negative = word & binary::BIT7 as u64 != 0;
+                // first byte carries only 6 bits of a number, the 7th one being a sign
+                let groups = compact_7bit_groups(word & !(binary::BIT7 as u64));
+                let num = ((groups & binary::BITS6 as u64) | (groups >> 7) << 6) as i64;
+                return if is_negative { -num } else { num };
+            }
+        }
+        read_ivar_bytewise(self)
+    }
+
+    /// Read string of variable length. Unless current cursor has been created using
+    /// [Cursor::new_trusted], string is validated first.
+    fn read_string(&mut self) -> &str {
+        let len: u32 = self.read_uvar();
+        let start = self.next;
+        let end = start + len as usize;
+        let buf = &self.buf[start..end];
+        self.next = end;
+        if self.trusted {
+            unsafe { std::str::from_utf8_unchecked(buf) }
+        } else {
+            read_utf8(buf)
+        }
+    }
+
+    /// Read `len` variable length unsigned integers into `out`. Chunks of 8 single-byte numbers
+    /// are recognized with a single check and decoded at once.
+    fn read_uvar_into<T: Uint>(&mut self, len: usize, out: &mut Vec<T>) {
+        out.reserve(len);
+        let mut remaining = len;
+        while remaining >= 8 && self.buf.len() - self.next >= 8 {
+            let chunk = &self.buf[self.next..(self.next + 8)];
+            let word = u64::from_le_bytes(chunk.try_into().unwrap());
+            if word & CONTINUATION_BITS == 0 {
+                out.extend(chunk.iter().map(|&b| T::from_u64(b as u64)));
+                self.next += 8;
+                remaining -= 8;
+            } else {
+                for _ in 0..8 {
+                    out.push(self.read_uvar());
+                }
+                remaining -= 8;
+            }
+        }
+        while remaining > 0 {
+            out.push(self.read_uvar());
+            remaining -= 1;
+        }
+    }
+}
+
+/// Mask of continuation bits of 8 consecutive bytes of variable length encoded number.
+const CONTINUATION_BITS: u64 = 0x8080_8080_8080_8080;
+
+/// Given up to 8 bytes of variable length encoded number in little endian order, drops their
+/// continuation bits and joins remaining 7-bit groups together. It's a portable equivalent of
+/// BMI2 `pext` instruction with a `0x7f7f7f7f7f7f7f7f` mask.
+#[inline(always)]
+fn compact_7bit_groups(word: u64) -> u64 {
+    let x = word & 0x7f7f_7f7f_7f7f_7f7f;
+    let x = (x & 0x007f_007f_007f_007f) | ((x & 0x7f00_7f00_7f00_7f00) >> 1);
+    let x = (x & 0x0000_3fff_0000_3fff) | ((x & 0x3fff_0000_3fff_0000) >> 2);
+    (x & 0x0000_0000_0fff_ffff) | ((x & 0x0fff_ffff_0000_0000) >> 4)
+}
+
+/// Converts bytes of a decoded string into a string slice, panicking if they're not a valid UTF-8.
+#[inline]
+fn read_utf8(buf: &[u8]) -> &str {
+    match utf8::from_utf8(buf) {
+        Some(str) => str,
+        None => panic!("Invalid UTF-8 string!"),
+    }
+}
+
+/// Reads unsigned integer with variable length one byte at a time.
+fn read_uvar_bytewise<R: Read + ?Sized, T: Uint>(reader: &mut R) -> T {
+    let mut num: T = Default::default();
+    let mut len: usize = 0;
+    loop {
+        let r = reader.read_u8();
+        num.unshift_add(len, r & binary::BITS7);
+        len += 7;
+        if r < binary::BIT8 {
+            return num;
+        }
+        if len > 128 {
+            panic!("Integer out of range!");
+        }
+    }
+}
+
+/// Reads signed integer with variable length one byte at a time.
+fn read_ivar_bytewise<R: Read + ?Sized>(reader: &mut R) -> i64 {
+    let mut r = reader.read_u8();
+    let mut num = (r & binary::BITS6 as u8) as i64;
+    let mut len: u32 = 6;
+    let is_negative = r & binary::BIT7 as u8 > 0;
+    if r & binary::BIT8 as u8 == 0 {
+        return if is_negative { -num } else { num };
+    }
+    loop {
+        r = reader.read_u8();
+        num |= (r as i64 & binary::BITS7 as i64) << len;
+        len += 7;
+        if r < binary::BIT8 as u8 {
+            return if is_negative { -num } else { num };
+        }
+        if len > 128 {
+            panic!("Integer out of range!");
+        }
+    }
 }
 
 pub trait Read {
@@ -77,20 +263,8 @@ pub trait Read {
     /// * numbers < 2^7 are stored in one byte
     /// * numbers < 2^14 are stored in two bytes
     // @todo currently, only 32 bits supported
-    fn read_uvar<T: crate::number::Uint>(&mut self) -> T {
-        let mut num: T = Default::default();
-        let mut len: usize = 0;
-        loop {
-            let r = self.read_u8();
-            num.unshift_add(len, r & binary::BITS7);
-            len += 7;
-            if r < binary::BIT8 {
-                return num;
-            }
-            if len > 128 {
-                panic!("Integer out of range!");
-            }
-        }
+    fn read_uvar<T: Uint>(&mut self) -> T {
+        read_uvar_bytewise(self)
     }
 
     /// Read signed integer with variable length.
@@ -98,30 +272,21 @@ pub trait Read {
     /// * numbers < 2^14 are stored in two bytes
     // @todo currently, only 32 bits supported
     fn read_ivar(&mut self) -> i64 {
-        let mut r = self.read_u8();
-        let mut num = (r & binary::BITS6 as u8) as i64;
-        let mut len: u32 = 6;
-        let is_negative = r & binary::BIT7 as u8 > 0;
-        if r & binary::BIT8 as u8 == 0 {
-            return if is_negative { -num } else { num };
-        }
-        loop {
-            r = self.read_u8();
-            num |= (r as i64 & binary::BITS7 as i64) << len;
-            len += 7;
-            if r < binary::BIT8 as u8 {
-                return if is_negative { -num } else { num };
-            }
-            if len > 128 {
-                panic!("Integer out of range!");
-            }
+        read_ivar_bytewise(self)
+    }
+
+    /// Read `len` variable length unsigned integers and append them to `out`.
+    fn read_uvar_into<T: Uint>(&mut self, len: usize, out: &mut Vec<T>) {
+        out.reserve(len);
+        for _ in 0..len {
+            out.push(self.read_uvar());
         }
     }
 
-    /// Read string of variable length.
+    /// Read string of variable length. Panics if string is not a valid UTF-8 sequence.
     fn read_string(&mut self) -> &str {
         let buf = self.read_buf();
-        unsafe { std::str::from_utf8_unchecked(buf) }
+        read_utf8(buf)
     }
 
     /// Read float32 in big endian order
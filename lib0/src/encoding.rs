@@ -1,6 +1,9 @@
 use crate::binary;
 use crate::number::Uint;
 
+/// Maximum number of bytes used by variable length encoding of a 128-bit number.
+const MAX_VAR_LEN: usize = 19;
+
 impl Write for Vec<u8> {
     fn write_u8(&mut self, value: u8) {
         self.push(value);
@@ -9,6 +12,256 @@ impl Write for Vec<u8> {
     fn write(&mut self, buf: &[u8]) {
         self.extend_from_slice(buf);
     }
+
+    /// Write a sequence of variable length unsigned integers. Space for the worst case encoding
+    /// of all `values` is reserved up front, so that numbers are written directly into a buffer
+    /// without checking its capacity for every byte. Chunks of 8 single-byte numbers are written
+    /// at once.
+    ///
+    /// If a buffer has been presized and has less spare capacity than the worst case would need,
+    /// only the exact encoded length is reserved, so that the buffer is not grown needlessly.
+    /// Numbers are written directly only while spare capacity fits their longest possible
+    /// encoding, remaining ones fall back to [Write::write_uvar].
+    fn write_uvar_slice<T: Uint + Copy>(&mut self, values: &[T]) {
+        let max_len = max_uvar_len::<T>();
+        if self.capacity() - self.len() < values.len() * max_len {
+            let exact: usize = values.iter().map(|&v| uvar_len(v)).sum();
+            self.reserve(exact);
+        }
+        let single_byte = T::from_u64(binary::BIT8 as u64);
+        let mut i = 0;
+        unsafe {
+            let start = self.as_mut_ptr().add(self.len());
+            let end = self.as_mut_ptr().add(self.capacity());
+            let mut dst = start;
+            while i + 8 <= values.len() && end.offset_from(dst) as usize >= 8 * max_len {
+                let chunk = &values[i..i + 8];
+                // no short-circuiting, so that this check can be vectorized
+                let all_single = chunk.iter().fold(true, |acc, &v| acc & (v < single_byte));
+                if all_single {
+                    for &v in chunk {
+                        let mut num = v;
+                        *dst = num.shift7_rest_to_byte();
+                        dst = dst.add(1);
+                    }
+                } else {
+                    for &v in chunk {
+                        dst = write_uvar_unchecked(dst, v, max_len);
+                    }
+                }
+                i += 8;
+            }
+            while i < values.len() && end.offset_from(dst) as usize >= max_len {
+                dst = write_uvar_unchecked(dst, values[i], max_len);
+                i += 1;
+            }
+            let written = dst.offset_from(start) as usize;
+            self.set_len(self.len() + written);
+        }
+        for &v in &values[i..] {
+            self.write_uvar(v);
+        }
+    }
+
+    /// Write a sequence of variable length unsigned integers directly into a buffer, reserving
+    /// space for all of them up front. Like [Write::write_uvar_slice], it reserves only the exact
+    /// encoded length if a buffer has less spare capacity than the worst case would need.
+    ///
+    /// Since `values` are not guaranteed to produce the same numbers when iterated again,
+    /// remaining capacity is checked before every number is written.
+    fn write_uvar_iter<T, I>(&mut self, count: usize, values: I)
+    where
+        T: Uint,
+        I: IntoIterator<Item = T>,
+        I::IntoIter: Clone,
+    {
+        let mut values = values.into_iter().take(count);
+        let max_len = max_uvar_len::<T>();
+        if self.capacity() - self.len() < count * max_len {
+            let exact: usize = values.clone().map(|v| uvar_len(v)).sum();
+            self.reserve(exact);
+        }
+        unsafe {
+            let start = self.as_mut_ptr().add(self.len());
+            let end = self.as_mut_ptr().add(self.capacity());
+            let mut dst = start;
+            while end.offset_from(dst) as usize >= max_len {
+                match values.next() {
+                    Some(v) => dst = write_uvar_unchecked(dst, v, max_len),
+                    None => break,
+                }
+            }
+            let written = dst.offset_from(start) as usize;
+            self.set_len(self.len() + written);
+        }
+        for v in values {
+            self.write_uvar(v);
+        }
+    }
+}
+
+/// Returns a maximum number of bytes used by [Write::write_uvar] to encode a number of type `T`.
+#[inline]
+fn max_uvar_len<T>() -> usize {
+    (std::mem::size_of::<T>() * 8 + 6) / 7
+}
+
+/// Returns a number of bytes used by [Write::write_uvar] to encode a given number.
+#[inline]
+pub fn uvar_len<T: Uint>(mut num: T) -> usize {
+    let mut len = 1;
+    num.shift7_rest_to_byte();
+    while !num.is_null() {
+        num.shift7_rest_to_byte();
+        len += 1;
+    }
+    len
+}
+
+/// Returns a number of bytes used by [Write::write_ivar] to encode a given number.
+#[inline]
+pub fn ivar_len(num: i64) -> usize {
+    let num = num.wrapping_abs() as u64;
+    if num > binary::BITS6 as u64 {
+        1 + uvar_len(num >> 6)
+    } else {
+        1
+    }
+}
+
+/// Returns a number of bytes used by [Write::write_buf] (and [Write::write_string]) to encode
+/// a buffer of a given length.
+#[inline]
+pub fn buf_len(len: usize) -> usize {
+    uvar_len(len) + len
+}
+
+/// Writes a variable length unsigned integer under a given pointer, returning a pointer right
+/// after the last written byte. At most `max_len` bytes are written, even if a [Uint]
+/// implementation would need more. Caller must guarantee that there's enough space for them.
+#[inline(always)]
+unsafe fn write_uvar_unchecked<T: Uint>(mut dst: *mut u8, mut num: T, max_len: usize) -> *mut u8 {
+    let last = dst.add(max_len - 1);
+    loop {
+        let rest = num.shift7_rest_to_byte();
+        if num.is_null() || dst == last {
+            *dst = rest;
+            return dst.add(1);
+        }
+        *dst = binary::BIT8 | rest;
+        dst = dst.add(1);
+    }
+}
+
+/// Default size of a buffer used by [IoWriter].
+const IO_BUFFER_SIZE: usize = 8 * 1024;
+
+/// Adapter, which allows to encode data directly into any [std::io::Write] sink, such as a file
+/// or a socket, without keeping an entire encoded payload in memory.
+///
+/// Encoded bytes are gathered in a fixed-size buffer, which is written into an underlying sink
+/// only once it gets full. Since encoding itself is infallible, the first I/O error is stored
+/// and all writes following it are ignored. It's reported back by [IoWriter::finish], which must
+/// be called once encoding is done.
+pub struct IoWriter<W: std::io::Write> {
+    inner: W,
+    buf: Vec<u8>,
+    error: Option<std::io::Error>,
+}
+
+impl<W: std::io::Write> IoWriter<W> {
+    pub fn new(inner: W) -> Self {
+        Self::with_buffer_size(inner, IO_BUFFER_SIZE)
+    }
+
+    pub fn with_buffer_size(inner: W, size: usize) -> Self {
+        IoWriter {
+            inner,
+            buf: Vec::with_capacity(size.max(MAX_VAR_LEN)),
+            error: None,
+        }
+    }
+
+    /// Writes all buffered data into an underlying sink and flushes it. Returns the sink back or
+    /// the first error which occurred while writing to it.
+    pub fn finish(mut self) -> std::io::Result<W> {
+        self.flush_buf();
+        if let Some(e) = self.error.take() {
+            return Err(e);
+        }
+        self.inner.flush()?;
+        Ok(self.inner)
+    }
+
+    fn flush_buf(&mut self) {
+        if self.error.is_none() && !self.buf.is_empty() {
+            if let Err(e) = self.inner.write_all(&self.buf) {
+                self.error = Some(e);
+            }
+        }
+        self.buf.clear();
+    }
+}
+
+impl<W: std::io::Write> Write for IoWriter<W> {
+    #[inline]
+    fn write_u8(&mut self, value: u8) {
+        if self.buf.len() == self.buf.capacity() {
+            self.flush_buf();
+        }
+        self.buf.push(value);
+    }
+
+    fn write(&mut self, buf: &[u8]) {
+        if buf.len() > self.buf.capacity() - self.buf.len() {
+            self.flush_buf();
+            if buf.len() >= self.buf.capacity() {
+                // large payloads are passed directly to an underlying sink
+                if self.error.is_none() {
+                    if let Err(e) = self.inner.write_all(buf) {
+                        self.error = Some(e);
+                    }
+                }
+                return;
+            }
+        }
+        self.buf.extend_from_slice(buf);
+    }
+}
+
+/// A [Write] implementation, which doesn't store any data but only counts the number of bytes
+/// written into it. It can be used to compute an encoded length of a value without allocating.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct ByteCounter {
+    len: usize,
+}
+
+impl ByteCounter {
+    pub fn new() -> Self {
+        ByteCounter::default()
+    }
+
+    /// Returns a number of bytes written so far.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+}
+
+impl Write for ByteCounter {
+    #[inline]
+    fn write_u8(&mut self, _value: u8) {
+        self.len += 1;
+    }
+
+    #[inline]
+    fn write(&mut self, buf: &[u8]) {
+        self.len += buf.len();
+    }
+
+    #[inline]
+    fn write_uvar(&mut self, num: impl Uint) {
+        self.len += uvar_len(num);
+    }
 }
 
 pub trait Write {
@@ -39,12 +292,46 @@ pub trait Write {
 
     /// Write a variable length unsigned integer.
     fn write_uvar(&mut self, mut num: impl Uint) {
+        let rest = num.shift7_rest_to_byte();
+        if num.is_null() {
+            // most of the numbers fit into a single byte
+            self.write_u8(rest);
+            return;
+        }
+        // encode into a stack buffer first, so that the output is grown only once
+        let mut buf = [0u8; MAX_VAR_LEN];
+        buf[0] = 0b10000000 | rest;
+        let mut len = 1;
         while {
             let rest = num.shift7_rest_to_byte();
             let c = !num.is_null();
-            self.write_u8(if c { 0b10000000 | rest } else { rest });
+            buf[len] = if c { 0b10000000 | rest } else { rest };
+            len += 1;
             c
         } {}
+        self.write(&buf[..len]);
+    }
+
+    /// Write a sequence of variable length unsigned integers. It produces the same output as
+    /// calling [Write::write_uvar] for every element of `values`.
+    fn write_uvar_slice<T: Uint + Copy>(&mut self, values: &[T]) {
+        for &v in values {
+            self.write_uvar(v);
+        }
+    }
+
+    /// Write a sequence of `count` variable length unsigned integers produced by `values`,
+    /// without collecting them into a temporary buffer first. It produces the same output as
+    /// calling [Write::write_uvar] for every element. Values past the first `count` are ignored.
+    fn write_uvar_iter<T, I>(&mut self, count: usize, values: I)
+    where
+        T: Uint,
+        I: IntoIterator<Item = T>,
+        I::IntoIter: Clone,
+    {
+        for v in values.into_iter().take(count) {
+            self.write_uvar(v);
+        }
     }
 
     /// Write a variable length integer.
@@ -55,27 +342,28 @@ pub trait Write {
     /// We use the 7th bit instead for signaling that this is a negative number.
     // @todo Support up to 128 bit
     fn write_ivar(&mut self, mut num: i64) {
+        let mut buf = [0u8; MAX_VAR_LEN];
         let is_negative = num < 0;
         num = if is_negative { -num } else { num };
-        self.write_u8(
+        buf[0] =
             // whether to continue reading
             (if num > binary::BITS6 as i64 { binary::BIT8 as u8 } else { 0 })
                 // whether number is negative
                 | (if is_negative { binary::BIT7 as u8 } else { 0 })
                 // number
-                | (binary::BITS6 as i64 & num) as u8,
-        );
+                | (binary::BITS6 as i64 & num) as u8;
+        let mut len = 1;
         num >>= 6;
         while num > 0 {
-            self.write_u8(
-                if num > binary::BITS7 as i64 {
-                    binary::BIT8 as u8
-                } else {
-                    0
-                } | (binary::BITS7 as i64 & num) as u8,
-            );
+            buf[len] = if num > binary::BITS7 as i64 {
+                binary::BIT8 as u8
+            } else {
+                0
+            } | (binary::BITS7 as i64 & num) as u8;
+            len += 1;
             num >>= 7;
         }
+        self.write(&buf[..len]);
     }
 
     /// Write variable length buffer (binary content).
@@ -0,0 +1,389 @@
+use crate::any::Any;
+use std::collections::HashMap;
+use std::io::{Result, Write};
+
+/// Writes a given `value` as a JSON text into a provided `writer`, without any intermediate
+/// string allocations. Since [Any] is a superset of JSON, some of its values are mapped:
+///
+/// - [Any::Undefined] and non-finite numbers are written as `null`.
+/// - [Any::Buffer] is written as an array of byte values.
+pub fn write_any<W: Write>(writer: &mut W, value: &Any) -> Result<()> {
+    match value {
+        Any::Null | Any::Undefined => writer.write_all(b"null"),
+        Any::Bool(true) => writer.write_all(b"true"),
+        Any::Bool(false) => writer.write_all(b"false"),
+        Any::Number(num) => write_f64(writer, *num),
+        Any::BigInt(num) => write!(writer, "{}", num),
+        Any::String(str) => write_string(writer, str),
+        Any::Buffer(buf) => {
+            writer.write_all(b"[")?;
+            for (i, b) in buf.iter().enumerate() {
+                if i != 0 {
+                    writer.write_all(b",")?;
+                }
+                write!(writer, "{}", b)?;
+            }
+            writer.write_all(b"]")
+        }
+        Any::Array(values) => {
+            writer.write_all(b"[")?;
+            for (i, value) in values.iter().enumerate() {
+                if i != 0 {
+                    writer.write_all(b",")?;
+                }
+                write_any(writer, value)?;
+            }
+            writer.write_all(b"]")
+        }
+        Any::Map(entries) => {
+            writer.write_all(b"{")?;
+            for (i, (key, value)) in entries.iter().enumerate() {
+                if i != 0 {
+                    writer.write_all(b",")?;
+                }
+                write_string(writer, key)?;
+                writer.write_all(b":")?;
+                write_any(writer, value)?;
+            }
+            writer.write_all(b"}")
+        }
+    }
+}
+
+/// Writes a given floating point number as a JSON number. Integral values are written without
+/// a fractional part. Non-finite numbers are written as `null`.
+pub fn write_f64<W: Write>(writer: &mut W, num: f64) -> Result<()> {
+    if num.is_finite() {
+        write!(writer, "{}", num)
+    } else {
+        writer.write_all(b"null")
+    }
+}
+
+/// Writes a given string as a quoted JSON string literal, escaping characters when necessary.
+pub fn write_string<W: Write>(writer: &mut W, str: &str) -> Result<()> {
+    writer.write_all(b"\"")?;
+    write_escaped(writer, str)?;
+    writer.write_all(b"\"")
+}
+
+/// Writes contents of a JSON string literal (without surrounding quotes), escaping characters
+/// when necessary. Runs of characters which don't need escaping are written at once. It can be
+/// used to write a single JSON string out of many string chunks.
+pub fn write_escaped<W: Write>(writer: &mut W, str: &str) -> Result<()> {
+    const HEX: &[u8; 16] = b"0123456789abcdef";
+    let bytes = str.as_bytes();
+    let mut unicode = *b"\\u0000";
+    let mut start = 0;
+    for (i, &b) in bytes.iter().enumerate() {
+        let escaped: &[u8] = match b {
+            b'"' => b"\\\"",
+            b'\\' => b"\\\\",
+            b'\n' => b"\\n",
+            b'\r' => b"\\r",
+            b'\t' => b"\\t",
+            0x08 => b"\\b",
+            0x0C => b"\\f",
+            0x00..=0x1F => {
+                unicode[4] = HEX[(b >> 4) as usize];
+                unicode[5] = HEX[(b & 0xF) as usize];
+                &unicode
+            }
+            _ => continue,
+        };
+        writer.write_all(&bytes[start..i])?;
+        writer.write_all(escaped)?;
+        start = i + 1;
+    }
+    writer.write_all(&bytes[start..])
+}
+
+/// Error returned when parsing an invalid JSON text.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ParseError {
+    /// Byte offset in the parsed input at which the error has been detected.
+    pub offset: usize,
+    /// Description of what was expected at a given offset.
+    pub reason: &'static str,
+}
+
+impl std::fmt::Display for ParseError {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{} at offset {}", self.reason, self.offset)
+    }
+}
+
+impl std::error::Error for ParseError {}
+
+/// Parses a given JSON text into an [Any] value. JSON numbers are always parsed as
+/// [Any::Number].
+///
+/// Like [Any::decode], parser doesn't use recursion, so that deeply nested inputs cannot overflow
+/// the stack. Strings without escape sequences are copied straight from the input.
+pub fn parse(json: &str) -> std::result::Result<Any, ParseError> {
+    let mut parser = Parser {
+        src: json,
+        buf: json.as_bytes(),
+        pos: 0,
+    };
+    let value = parser.parse_value()?;
+    parser.skip_whitespace();
+    if parser.pos == parser.buf.len() {
+        Ok(value)
+    } else {
+        Err(parser.error("expected end of input"))
+    }
+}
+
+struct Parser<'a> {
+    src: &'a str,
+    buf: &'a [u8],
+    pos: usize,
+}
+
+/// Collection, which elements are being parsed.
+enum Frame {
+    Array(Vec<Any>),
+    /// Map entries together with a key of an entry, which value is being parsed.
+    Map(HashMap<String, Any>, String),
+}
+
+impl<'a> Parser<'a> {
+    fn error(&self, reason: &'static str) -> ParseError {
+        ParseError {
+            offset: self.pos,
+            reason,
+        }
+    }
+
+    fn skip_whitespace(&mut self) {
+        while let Some(b' ' | b'\t' | b'\n' | b'\r') = self.buf.get(self.pos) {
+            self.pos += 1;
+        }
+    }
+
+    fn peek(&self) -> Option<u8> {
+        self.buf.get(self.pos).cloned()
+    }
+
+    fn next_token(&mut self) -> Option<u8> {
+        self.skip_whitespace();
+        let b = self.peek();
+        self.pos += 1;
+        b
+    }
+
+    fn parse_value(&mut self) -> std::result::Result<Any, ParseError> {
+        let mut stack: Vec<Frame> = Vec::new();
+        loop {
+            self.skip_whitespace();
+            let mut value = match self.peek() {
+                Some(b'[') => {
+                    self.pos += 1;
+                    self.skip_whitespace();
+                    if self.peek() == Some(b']') {
+                        self.pos += 1;
+                        Any::Array(Vec::new())
+                    } else {
+                        stack.push(Frame::Array(Vec::new()));
+                        continue;
+                    }
+                }
+                Some(b'{') => {
+                    self.pos += 1;
+                    self.skip_whitespace();
+                    if self.peek() == Some(b'}') {
+                        self.pos += 1;
+                        Any::Map(HashMap::new())
+                    } else {
+                        let key = self.parse_key()?;
+                        stack.push(Frame::Map(HashMap::new(), key));
+                        continue;
+                    }
+                }
+                Some(b'"') => Any::String(self.parse_string()?),
+                Some(b't') => self.parse_literal("true", Any::Bool(true))?,
+                Some(b'f') => self.parse_literal("false", Any::Bool(false))?,
+                Some(b'n') => self.parse_literal("null", Any::Null)?,
+                Some(b'-' | b'0'..=b'9') => Any::Number(self.parse_number()?),
+                _ => return Err(self.error("expected value")),
+            };
+
+            // append parsed value to its parent collections, closing all the finished ones
+            loop {
+                match stack.last_mut() {
+                    None => return Ok(value),
+                    Some(Frame::Array(values)) => {
+                        values.push(value);
+                        match self.next_token() {
+                            Some(b',') => break,
+                            Some(b']') => {
+                                value = Any::Array(std::mem::take(values));
+                                stack.pop();
+                            }
+                            _ => return Err(self.error("expected ',' or ']'")),
+                        }
+                    }
+                    Some(Frame::Map(entries, key)) => {
+                        entries.insert(std::mem::take(key), value);
+                        match self.next_token() {
+                            Some(b',') => {
+                                *key = self.parse_key()?;
+                                break;
+                            }
+                            Some(b'}') => {
+                                value = Any::Map(std::mem::take(entries));
+                                stack.pop();
+                            }
+                            _ => return Err(self.error("expected ',' or '}'")),
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    fn parse_literal(
+        &mut self,
+        literal: &'static str,
+        value: Any,
+    ) -> std::result::Result<Any, ParseError> {
+        if self.buf[self.pos..].starts_with(literal.as_bytes()) {
+            self.pos += literal.len();
+            Ok(value)
+        } else {
+            Err(self.error("expected value"))
+        }
+    }
+
+    /// Parses an object entry key together with a following colon.
+    fn parse_key(&mut self) -> std::result::Result<String, ParseError> {
+        self.skip_whitespace();
+        if self.peek() != Some(b'"') {
+            return Err(self.error("expected string"));
+        }
+        let key = self.parse_string()?;
+        if self.next_token() != Some(b':') {
+            return Err(self.error("expected ':'"));
+        }
+        Ok(key)
+    }
+
+    fn parse_number(&mut self) -> std::result::Result<f64, ParseError> {
+        let start = self.pos;
+        if self.peek() == Some(b'-') {
+            self.pos += 1;
+        }
+        match self.peek() {
+            Some(b'0') => self.pos += 1,
+            Some(b'1'..=b'9') => self.skip_digits(),
+            _ => return Err(self.error("expected digit")),
+        }
+        if self.peek() == Some(b'.') {
+            self.pos += 1;
+            if !matches!(self.peek(), Some(b'0'..=b'9')) {
+                return Err(self.error("expected digit"));
+            }
+            self.skip_digits();
+        }
+        if let Some(b'e' | b'E') = self.peek() {
+            self.pos += 1;
+            if let Some(b'+' | b'-') = self.peek() {
+                self.pos += 1;
+            }
+            if !matches!(self.peek(), Some(b'0'..=b'9')) {
+                return Err(self.error("expected digit"));
+            }
+            self.skip_digits();
+        }
+        // the grammar has been already verified, so it's always a valid float literal
+        Ok(self.src[start..self.pos].parse().unwrap())
+    }
+
+    fn skip_digits(&mut self) {
+        while let Some(b'0'..=b'9') = self.peek() {
+            self.pos += 1;
+        }
+    }
+
+    /// Parses a string literal, starting at its opening quote.
+    fn parse_string(&mut self) -> std::result::Result<String, ParseError> {
+        self.pos += 1;
+        let mut result = String::new();
+        let mut start = self.pos;
+        loop {
+            match self.peek() {
+                Some(b'"') => {
+                    result.push_str(&self.src[start..self.pos]);
+                    self.pos += 1;
+                    return Ok(result);
+                }
+                Some(b'\\') => {
+                    result.push_str(&self.src[start..self.pos]);
+                    self.pos += 1;
+                    self.parse_escape(&mut result)?;
+                    start = self.pos;
+                }
+                Some(0x00..=0x1F) => return Err(self.error("unescaped control character")),
+                Some(_) => self.pos += 1,
+                None => return Err(self.error("unterminated string")),
+            }
+        }
+    }
+
+    /// Parses an escape sequence following a backslash and appends it to `result`.
+    fn parse_escape(&mut self, result: &mut String) -> std::result::Result<(), ParseError> {
+        let c = match self.peek() {
+            Some(b'"') => '"',
+            Some(b'\\') => '\\',
+            Some(b'/') => '/',
+            Some(b'b') => '\u{8}',
+            Some(b'f') => '\u{c}',
+            Some(b'n') => '\n',
+            Some(b'r') => '\r',
+            Some(b't') => '\t',
+            Some(b'u') => {
+                self.pos += 1;
+                let hi = self.parse_hex4()?;
+                let code = if (0xD800..0xDC00).contains(&hi) {
+                    // high surrogate must be followed by an escaped low surrogate
+                    if !self.buf[self.pos..].starts_with(b"\\u") {
+                        return Err(self.error("expected low surrogate"));
+                    }
+                    self.pos += 2;
+                    let lo = self.parse_hex4()?;
+                    if !(0xDC00..0xE000).contains(&lo) {
+                        return Err(self.error("expected low surrogate"));
+                    }
+                    0x10000 + ((hi - 0xD800) << 10) + (lo - 0xDC00)
+                } else {
+                    hi
+                };
+                match std::char::from_u32(code) {
+                    Some(c) => result.push(c),
+                    None => return Err(self.error("invalid unicode escape")),
+                }
+                return Ok(());
+            }
+            _ => return Err(self.error("invalid escape sequence")),
+        };
+        result.push(c);
+        self.pos += 1;
+        Ok(())
+    }
+
+    fn parse_hex4(&mut self) -> std::result::Result<u32, ParseError> {
+        let mut code = 0;
+        for _ in 0..4 {
+            let digit = match self.peek() {
+                Some(b @ b'0'..=b'9') => b - b'0',
+                Some(b @ b'a'..=b'f') => b - b'a' + 10,
+                Some(b @ b'A'..=b'F') => b - b'A' + 10,
+                _ => return Err(self.error("expected hex digit")),
+            };
+            code = (code << 4) | digit as u32;
+            self.pos += 1;
+        }
+        Ok(code)
+    }
+}
@@ -1,5 +1,8 @@
 pub mod any;
 pub mod binary;
+pub mod compact;
 pub mod decoding;
 pub mod encoding;
+pub mod json;
 pub mod number;
+pub mod utf8;
@@ -6,6 +6,8 @@ pub trait Uint: Eq + Ord + Default {
     fn shift7_rest_to_byte(&mut self) -> u8;
     fn unshift_add(&mut self, unshift: usize, add: u8);
     fn is_null(&self) -> bool;
+    /// Converts a 64-bit number into current type, truncating bits which don't fit into it.
+    fn from_u64(value: u64) -> Self;
 }
 
 impl Uint for u32 {
@@ -29,6 +31,10 @@ impl Uint for u32 {
     fn is_null(&self) -> bool {
         *self == 0
     }
+    #[inline]
+    fn from_u64(value: u64) -> Self {
+        value as Self
+    }
 }
 
 impl Uint for u64 {
@@ -52,6 +58,10 @@ impl Uint for u64 {
     fn is_null(&self) -> bool {
         *self == 0
     }
+    #[inline]
+    fn from_u64(value: u64) -> Self {
+        value as Self
+    }
 }
 
 impl Uint for u128 {
@@ -75,6 +85,10 @@ impl Uint for u128 {
     fn is_null(&self) -> bool {
         *self == 0
     }
+    #[inline]
+    fn from_u64(value: u64) -> Self {
+        value as Self
+    }
 }
 
 impl Uint for usize {
@@ -98,4 +112,8 @@ impl Uint for usize {
     fn is_null(&self) -> bool {
         *self == 0
     }
+    #[inline]
+    fn from_u64(value: u64) -> Self {
+        value as Self
+    }
 }
@@ -0,0 +1,95 @@
+/// Mask of the most significant bits of 8 consecutive bytes. If none of them is set, all bytes
+/// are ASCII characters.
+const NON_ASCII_BITS: u64 = 0x8080_8080_8080_8080;
+
+/// Converts a slice of bytes into a string slice, returning `None` if `buf` is not a valid UTF-8
+/// sequence. It accepts exactly the same inputs as [std::str::from_utf8].
+///
+/// ASCII text is verified 16 bytes at a time, using two 64-bit words per step. Multi-byte
+/// characters are verified one by one, after which validator switches back to the block mode
+/// as soon as it encounters another ASCII character.
+pub fn from_utf8(buf: &[u8]) -> Option<&str> {
+    if validate(buf) {
+        Some(unsafe { std::str::from_utf8_unchecked(buf) })
+    } else {
+        None
+    }
+}
+
+/// Checks if given `buf` is a valid UTF-8 sequence.
+pub fn validate(buf: &[u8]) -> bool {
+    let len = buf.len();
+    let mut i = 0;
+    while i < len {
+        let b0 = buf[i];
+        if b0 < 0x80 {
+            // skip over whole blocks of ASCII characters at once
+            while i + 16 <= len {
+                let lo = read_u64(buf, i);
+                let hi = read_u64(buf, i + 8);
+                if (lo | hi) & NON_ASCII_BITS != 0 {
+                    break;
+                }
+                i += 16;
+            }
+            while i < len && buf[i] < 0x80 {
+                i += 1;
+            }
+            continue;
+        }
+
+        // multi-byte character, see: https://www.unicode.org/versions/Unicode13.0.0/ch03.pdf#G7404
+        match b0 {
+            0xC2..=0xDF => {
+                if i + 1 >= len || !is_continuation(buf[i + 1]) {
+                    return false;
+                }
+                i += 2;
+            }
+            0xE0..=0xEF => {
+                if i + 2 >= len {
+                    return false;
+                }
+                match (b0, buf[i + 1]) {
+                    (0xE0, 0xA0..=0xBF)
+                    | (0xE1..=0xEC, 0x80..=0xBF)
+                    | (0xED, 0x80..=0x9F)
+                    | (0xEE..=0xEF, 0x80..=0xBF) => {}
+                    _ => return false,
+                }
+                if !is_continuation(buf[i + 2]) {
+                    return false;
+                }
+                i += 3;
+            }
+            0xF0..=0xF4 => {
+                if i + 3 >= len {
+                    return false;
+                }
+                match (b0, buf[i + 1]) {
+                    (0xF0, 0x90..=0xBF) | (0xF1..=0xF3, 0x80..=0xBF) | (0xF4, 0x80..=0x8F) => {}
+                    _ => return false,
+                }
+                if !is_continuation(buf[i + 2]) || !is_continuation(buf[i + 3]) {
+                    return false;
+                }
+                i += 4;
+            }
+            _ => return false,
+        }
+    }
+    true
+}
+
+#[inline(always)]
+fn is_continuation(b: u8) -> bool {
+    b & 0b1100_0000 == 0b1000_0000
+}
+
+/// Reads 8 bytes starting at given `offset` as a single number. Caller must guarantee that
+/// there are at least 8 bytes available.
+#[inline(always)]
+fn read_u64(buf: &[u8], offset: usize) -> u64 {
+    debug_assert!(offset + 8 <= buf.len());
+    unsafe { (buf.as_ptr().add(offset) as *const u64).read_unaligned() }
+}
@@ -1,7 +1,11 @@
 use lib0::any::Any;
+use lib0::compact::{CompactAny, SmallString};
 use lib0::decoding::{Cursor, Read};
-use lib0::encoding::Write;
+use lib0::encoding::{ivar_len, uvar_len, IoWriter, Write};
+use lib0::json::{self, write_any};
 use proptest::prelude::*;
+use std::cell::Cell;
+use std::collections::HashMap;
 
 pub fn arb_any() -> impl Strategy<Value = Any> {
     let leaf = prop_oneof![
@@ -11,7 +15,7 @@ pub fn arb_any() -> impl Strategy<Value = Any> {
         any::<f64>().prop_map(Any::Number),
         any::<i64>().prop_map(|i| Any::Number(i as f64)),
         any::<String>().prop_map(Any::String),
-        any::<Box<[u8]>>().prop_map(Any::Buffer),
+        any::<Vec<u8>>().prop_map(|b| Any::Buffer(b.into())),
     ]
     .boxed();
 
@@ -31,6 +35,19 @@ proptest! {
         let mut decoder = Cursor::new(encoder.as_slice());
         let copy = Any::decode(&mut decoder);
         assert_eq!(any, copy);
+        assert_eq!(any.encoded_len(), encoder.len());
+    }
+
+    #[test]
+    fn encoding_compact_any_prop(any in arb_any()) {
+        let mut encoder = Vec::with_capacity(1024);
+        any.encode(&mut encoder);
+        let compact = CompactAny::decode(&mut Cursor::new(encoder.as_slice()));
+        let mut reencoded = Vec::with_capacity(1024);
+        compact.encode(&mut reencoded);
+        let copy = Any::decode(&mut Cursor::new(reencoded.as_slice()));
+        assert_eq!(any, copy);
+        assert_eq!(Any::from(compact), any);
     }
 }
 
@@ -201,3 +218,320 @@ proptest! {
         val.read(&mut decoder)
     }
 }
+
+#[test]
+fn var_int_sequence() {
+    // values are written one after another, so that most of them are decoded while there are
+    // still enough bytes left in the buffer to take the multi-byte decoding path
+    let mut values: Vec<u64> = Vec::new();
+    for shift in 0..64 {
+        values.push(1 << shift);
+        values.push((1 << shift) - 1);
+    }
+    values.push(u64::MAX);
+
+    let mut encoder = Vec::new();
+    for &v in values.iter() {
+        encoder.write_uvar(v);
+        encoder.write_uvar(v as u32);
+        encoder.write_uvar(v as u128 * 1024);
+        encoder.write_ivar((v >> 1) as i64);
+        encoder.write_ivar(-((v >> 1) as i64));
+    }
+
+    let mut decoder = Cursor::new(encoder.as_slice());
+    for &v in values.iter() {
+        assert_eq!(decoder.read_uvar::<u64>(), v);
+        assert_eq!(decoder.read_uvar::<u32>(), v as u32);
+        assert_eq!(decoder.read_uvar::<u128>(), v as u128 * 1024);
+        assert_eq!(decoder.read_ivar(), (v >> 1) as i64);
+        assert_eq!(decoder.read_ivar(), -((v >> 1) as i64));
+    }
+    assert_eq!(decoder.next, encoder.len());
+}
+
+#[test]
+fn var_uint_slice() {
+    // mix of runs of single-byte numbers and multi-byte ones
+    let values: Vec<u32> = (0..1000u32)
+        .map(|i| if i % 100 < 50 { i % 128 } else { i * 7919 })
+        .collect();
+
+    let mut encoder = Vec::new();
+    encoder.write_uvar_slice(&values);
+    let mut expected = Vec::new();
+    for &v in values.iter() {
+        expected.write_uvar(v);
+    }
+    assert_eq!(encoder, expected);
+
+    let mut decoder = Cursor::new(encoder.as_slice());
+    let mut decoded: Vec<u32> = Vec::new();
+    decoder.read_uvar_into(values.len(), &mut decoded);
+    assert_eq!(decoded, values);
+    assert_eq!(decoder.next, encoder.len());
+
+    let mut encoder = Vec::new();
+    encoder.write_uvar_iter(values.len(), values.iter().copied());
+    assert_eq!(encoder, expected);
+}
+
+#[test]
+fn var_uint_iter_growing_values() {
+    // values computed during the 2nd pass are larger than ones used to reserve the buffer
+    let calls = Cell::new(0);
+    let values = (0..100u32).map(|_| {
+        calls.set(calls.get() + 1);
+        if calls.get() <= 100 {
+            1
+        } else {
+            u32::MAX
+        }
+    });
+
+    let mut encoder = Vec::with_capacity(1);
+    encoder.write_uvar_iter(100, values);
+    let mut expected = Vec::new();
+    for _ in 0..100 {
+        expected.write_uvar(u32::MAX);
+    }
+    assert_eq!(encoder, expected);
+}
+
+proptest! {
+    #[test]
+    fn utf8_validation_prop(bytes: Vec<u8>) {
+        assert_eq!(lib0::utf8::validate(&bytes), std::str::from_utf8(&bytes).is_ok());
+    }
+
+    #[test]
+    fn utf8_validation_string_prop(str: String) {
+        assert!(lib0::utf8::validate(str.as_bytes()));
+    }
+}
+
+#[test]
+fn utf8_validation_edge_cases() {
+    let cases: Vec<&[u8]> = vec![
+        b"",
+        b"hello world, this is a plain ASCII text",
+        "zażółć gęślą jaźń".as_bytes(),
+        "ASCII prefix long enough to use block mode 😀 and a suffix".as_bytes(),
+        &[0xC0, 0x80],                   // overlong NUL
+        &[0xE0, 0x80, 0x80],             // overlong 3-byte sequence
+        &[0xED, 0xA0, 0x80],             // UTF-16 surrogate
+        &[0xF4, 0x90, 0x80, 0x80],       // above U+10FFFF
+        &[0xF4, 0x8F, 0xBF, 0xBF],       // U+10FFFF
+        &[0xE2, 0x82],                   // truncated sequence
+        b"0123456789abcdef\x80",         // lone continuation byte after ASCII block
+        &[0xF8, 0x88, 0x80, 0x80, 0x80], // 5-byte sequence
+    ];
+    for case in cases {
+        assert_eq!(
+            lib0::utf8::validate(case),
+            std::str::from_utf8(case).is_ok(),
+            "{:?}",
+            case
+        );
+    }
+}
+
+#[test]
+#[should_panic]
+fn read_invalid_string() {
+    let mut encoder = Vec::new();
+    encoder.write_buf(&[0xED, 0xA0, 0x80]);
+    let mut decoder = Cursor::new(encoder.as_slice());
+    decoder.read_string();
+}
+
+#[test]
+fn read_trusted_string() {
+    let mut encoder = Vec::new();
+    encoder.write_string("zażółć gęślą jaźń");
+    let mut decoder = unsafe { Cursor::new_trusted(encoder.as_slice()) };
+    assert_eq!(decoder.read_string(), "zażółć gęślą jaźń");
+}
+
+#[test]
+fn compact_any_map() {
+    let mut map = HashMap::new();
+    map.insert("short".to_owned(), Any::String("value".to_owned()));
+    map.insert(
+        "a key which is too long to be inlined".to_owned(),
+        Any::Array(vec![Any::Number(1.5), Any::BigInt(-3), Any::Null]),
+    );
+    map.insert("buf".to_owned(), Any::Buffer(vec![1, 2, 3].into()));
+    let any = Any::Map(map);
+
+    let mut encoded = Vec::new();
+    any.encode(&mut encoded);
+    let compact = CompactAny::decode(&mut Cursor::new(&encoded));
+    if let CompactAny::Map(map) = &compact {
+        assert_eq!(
+            map.get("short"),
+            Some(&CompactAny::String(SmallString::from("value")))
+        );
+        assert!(map.get("missing").is_none());
+        let keys: Vec<_> = map.iter().map(|(k, _)| k).collect();
+        assert_eq!(
+            keys,
+            vec!["a key which is too long to be inlined", "buf", "short"]
+        );
+    } else {
+        panic!("expected map, found {:?}", compact)
+    }
+    assert_eq!(CompactAny::from(any), compact);
+}
+
+#[test]
+fn decode_deeply_nested_any() {
+    let depth = 100_000;
+    let mut encoded = Vec::new();
+    for _ in 0..depth {
+        encoded.push(117); // array of length 1
+        encoded.push(1);
+    }
+    encoded.push(126); // null
+
+    let mut any = Any::decode(&mut Cursor::new(&encoded));
+    let mut actual_depth = 0;
+    while let Any::Array(mut values) = any {
+        any = values.pop().unwrap();
+        actual_depth += 1;
+    }
+    assert_eq!(actual_depth, depth);
+    assert_eq!(any, Any::Null);
+}
+
+#[test]
+fn var_int_encoded_len() {
+    let mut values: Vec<u64> = vec![0, 1, 63, 64, 127, 128, u32::MAX as u64, u64::MAX];
+    values.extend((0..64).map(|shift| 1u64 << shift));
+    for &value in values.iter() {
+        let mut encoder = Vec::new();
+        encoder.write_uvar(value);
+        assert_eq!(uvar_len(value), encoder.len(), "uvar {}", value);
+
+        let signed = (value >> 1) as i64;
+        for &num in [signed, -signed].iter() {
+            let mut encoder = Vec::new();
+            encoder.write_ivar(num);
+            assert_eq!(ivar_len(num), encoder.len(), "ivar {}", num);
+        }
+    }
+}
+
+#[test]
+fn io_writer() {
+    let mut expected = Vec::new();
+    let mut writer = IoWriter::with_buffer_size(Vec::new(), 16);
+    for i in 0..1000u32 {
+        expected.write_uvar(i);
+        expected.write_string("hello world");
+        writer.write_uvar(i);
+        writer.write_string("hello world");
+    }
+    let big = vec![1u8; 100];
+    expected.write_buf(&big);
+    writer.write_buf(&big);
+    assert_eq!(writer.finish().unwrap(), expected);
+
+    struct Failing(usize);
+    impl std::io::Write for Failing {
+        fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+            if self.0 == 0 {
+                return Err(std::io::ErrorKind::BrokenPipe.into());
+            }
+            self.0 -= 1;
+            Ok(buf.len())
+        }
+        fn flush(&mut self) -> std::io::Result<()> {
+            Ok(())
+        }
+    }
+    let mut writer = IoWriter::with_buffer_size(Failing(2), 16);
+    for i in 0..100u32 {
+        writer.write_uvar(i);
+    }
+    match writer.finish() {
+        Err(e) => assert_eq!(e.kind(), std::io::ErrorKind::BrokenPipe),
+        Ok(_) => panic!("expected write error"),
+    }
+}
+
+#[test]
+fn json_write_any() {
+    let mut map = HashMap::new();
+    map.insert("key \"quoted\"".to_owned(), Any::Number(-0.5));
+    let value = Any::Array(vec![
+        Any::Null,
+        Any::Undefined,
+        Any::Bool(true),
+        Any::Number(3.0),
+        Any::Number(f64::NAN),
+        Any::BigInt(-42),
+        Any::String("tab\t\u{1}ż\\".to_owned()),
+        Any::Buffer(vec![0u8, 255].into()),
+        Any::Map(map),
+    ]);
+    let mut json = Vec::new();
+    write_any(&mut json, &value).unwrap();
+    assert_eq!(
+        String::from_utf8(json).unwrap(),
+        r#"[null,null,true,3,null,-42,"tab\t\u0001ż\\",[0,255],{"key \"quoted\"":-0.5}]"#
+    );
+}
+
+#[test]
+fn json_parse() {
+    let mut map = HashMap::new();
+    map.insert("k\"ey".to_owned(), Any::Array(vec![]));
+    map.insert("empty".to_owned(), Any::Map(HashMap::new()));
+    let expected = Any::Array(vec![
+        Any::Null,
+        Any::Bool(true),
+        Any::Bool(false),
+        Any::Number(-12.5e2),
+        Any::Number(0.0),
+        Any::String("a\n\u{e9}\u{1F600}ż".to_owned()),
+        Any::Map(map),
+    ]);
+    let json = r#" [null, true,false ,-12.5e2,0, "a\n\u00e9\ud83d\ude00ż",
+        {"k\"ey": [], "empty": {}}] "#;
+    assert_eq!(json::parse(json).unwrap(), expected);
+
+    // parsed value can be written back
+    let mut buf = Vec::new();
+    write_any(&mut buf, &expected).unwrap();
+    let written = String::from_utf8(buf).unwrap();
+    assert_eq!(json::parse(&written).unwrap(), expected);
+
+    for invalid in &[
+        "",
+        "[1,]",
+        "{\"a\" 1}",
+        "01",
+        "1.",
+        "\"abc",
+        "\"\\x\"",
+        "\"\\ud83d\"",
+        "[1] 2",
+        "tru",
+    ] {
+        assert!(json::parse(invalid).is_err(), "{} should fail", invalid);
+    }
+    let err = json::parse("[1, x]").unwrap_err();
+    assert_eq!(err.offset, 4);
+
+    // deeply nested input doesn't overflow the stack
+    let depth = 100_000;
+    let nested = "[".repeat(depth) + "null" + &"]".repeat(depth);
+    let mut any = json::parse(&nested).unwrap();
+    let mut actual_depth = 0;
+    while let Any::Array(mut values) = any {
+        any = values.pop().unwrap();
+        actual_depth += 1;
+    }
+    assert_eq!(actual_depth, depth);
+}
@@ -158,6 +158,25 @@ typedef struct YXmlAttrIter {} YXmlAttrIter;
  */
 typedef struct YXmlTreeWalker {} YXmlTreeWalker;
 
+/**
+ * Append-only log of document updates persisted in a local directory. Updates appended to it
+ * are periodically compacted into a snapshot in the background. A document can be restored from
+ * a snapshot and all updates appended after it.
+ */
+typedef struct YUpdateLog {} YUpdateLog;
+
+/**
+ * A subscription for updates incoming from remote peers, created with [ydoc_observe_updates_v1].
+ * It can be released using [yunobserve_updates_v1].
+ */
+typedef struct YUpdateSubscription {} YUpdateSubscription;
+
+/**
+ * A subscription for updates produced by committed transactions, created with
+ * [ydoc_observe_after_transaction]. It can be released using [yunobserve_after_transaction].
+ */
+typedef struct YAfterTransactionSubscription {} YAfterTransactionSubscription;
+
 
 #include <stdarg.h>
 #include <stdbool.h>
@@ -435,6 +454,41 @@ typedef YXmlAttrIter YXmlAttrIter;
  */
 typedef YXmlTreeWalker YXmlTreeWalker;
 
+/**
+ * Append-only log of document updates persisted in a local directory. Updates appended to it
+ * are periodically compacted into a snapshot in the background. A document can be restored from
+ * a snapshot and all updates appended after it.
+ */
+typedef YUpdateLog YUpdateLog;
+
+/**
+ * A subscription for updates incoming from remote peers, created with [ydoc_observe_updates_v1].
+ * It can be released using [yunobserve_updates_v1].
+ */
+typedef YUpdateSubscription YUpdateSubscription;
+
+/**
+ * A subscription for updates produced by committed transactions, created with
+ * [ydoc_observe_after_transaction]. It can be released using [yunobserve_after_transaction].
+ */
+typedef YAfterTransactionSubscription YAfterTransactionSubscription;
+
+/**
+ * A callback used by document observers (like [ydoc_observe_updates_v1]). It's called
+ * with a caller-provided `ctx` pointer, a pointer to an update binary and its length. Update
+ * memory is valid only for the duration of a call.
+ */
+typedef void (*YUpdateCallback)(void*, const unsigned char*, int);
+
+/**
+ * A callback used by streaming functions (like [ytransaction_state_diff_v1_stream]) to pass
+ * chunks of generated binary data to the caller. It's called with a caller-provided `ctx`
+ * pointer, a pointer to a data chunk and a chunk length. Chunk memory is valid only for the
+ * duration of a call. Callback should return `0` on success - any other value aborts
+ * the streaming function.
+ */
+typedef int (*YWriteCallback)(void*, const unsigned char*, int);
+
 extern const char Y_JSON_BOOL;
 
 extern const char Y_JSON_NUM;
@@ -555,6 +609,59 @@ YDoc *ydoc_new_with_id(unsigned long id);
  */
 unsigned long ydoc_id(YDoc *doc);
 
+/**
+ * Creates a new [Doc] instance and restores its state from a snapshot stored in a file under
+ * a given `path` (ie. a binary produced by [ytransaction_state_diff_v1] with an empty state
+ * vector). A file is memory-mapped and decoded directly from the mapping instead of being read
+ * into an intermediate buffer first.
+ *
+ * A file must not be truncated or modified (by this or any other process) until this function
+ * returns. Otherwise a process may crash with `SIGBUS` or decode inconsistent data.
+ *
+ * Returns a null pointer if a file couldn't be read or if it doesn't contain a valid update
+ * (ie. it's truncated or corrupted). Use [ydoc_destroy] in order to release created [Doc]
+ * resources.
+ */
+YDoc *ydoc_load_mmap(const char *path);
+
+/**
+ * Subscribes a given `callback` to be called, together with a caller-provided `ctx` pointer,
+ * every time an update coming from a remote peer is about to be applied to a given document
+ * (eg. via [ytransaction_apply]). Callback receives an update encoded using lib0 v1 encoding.
+ *
+ * Update binary is not the one passed to [ytransaction_apply]: it's re-encoded from a decoded
+ * update into a fresh buffer for every event. That buffer is released once the callback
+ * returns, so it must be copied in order to be kept and must not be released by the callback.
+ * Callback is called while a transaction applying an update is still active, so it must not
+ * use `doc` itself. Returned subscription must be released using [yunobserve_updates_v1].
+ */
+YUpdateSubscription *ydoc_observe_updates_v1(YDoc *doc, void *ctx, YUpdateCallback callback);
+
+/**
+ * Releases a subscription created with [ydoc_observe_updates_v1]. Its callback will no longer
+ * be called.
+ */
+void yunobserve_updates_v1(YUpdateSubscription *subscription);
+
+/**
+ * Subscribes a given `callback` to be called, together with a caller-provided `ctx` pointer,
+ * every time a transaction, which made changes to a given document, is committed. Callback
+ * receives an update containing only the changes made by that transaction encoded using lib0 v1
+ * encoding, which can be applied on other peers using [ytransaction_apply].
+ *
+ * Callback is called while a committed transaction is still active, so it must not use `doc`
+ * itself. Returned subscription must be released using [yunobserve_after_transaction].
+ */
+YAfterTransactionSubscription *ydoc_observe_after_transaction(YDoc *doc,
+                                                              void *ctx,
+                                                              YUpdateCallback callback);
+
+/**
+ * Releases a subscription created with [ydoc_observe_after_transaction]. Its callback will no
+ * longer be called.
+ */
+void yunobserve_after_transaction(YAfterTransactionSubscription *subscription);
+
 /**
  * Starts a new read-write transaction on a given document. All other operations happen in context
  * of a transaction. Yrs transactions do not follow ACID rules. Once a set of operations is
@@ -648,6 +755,9 @@ unsigned char *ytransaction_state_vector_v1(const YTransaction *txn, int *len);
  * If passed `sv` pointer is null, the generated diff will be a snapshot containing entire state of
  * the document.
  *
+ * Generated diffs are cached by a document until it changes, so that requests from many peers
+ * sharing the same state vector are served without encoding the same update again.
+ *
  * A length of an encoded state vector payload must be passed as `sv_len` parameter.
  *
  * A length of generated delta diff binary will be passed within a `len` out parameter.
@@ -659,6 +769,44 @@ unsigned char *ytransaction_state_diff_v1(const YTransaction *txn,
                                           int sv_len,
                                           int *len);
 
+/**
+ * Works like [ytransaction_state_diff_v1], but the generated delta contains only the contents of
+ * root types, which names were passed within `root_names` array of null-terminated UTF-8
+ * strings. It's meant for remote peers, which replicate only a part of a document.
+ *
+ * Contents of all other root types are sent as garbage collected blocks. Once such delta is
+ * applied, remote peer's state vector covers them, so they will not be sent to it again, even
+ * by an unfiltered [ytransaction_state_diff_v1]. A peer, which needs to replicate more root
+ * types than it used to, must start over from an empty document.
+ *
+ * A length of `root_names` array must be passed as `root_names_len` parameter.
+ *
+ * A length of generated delta diff binary will be passed within a `len` out parameter.
+ *
+ * Once no longer needed, a returned binary can be disposed using [ybinary_destroy] function.
+ */
+unsigned char *ytransaction_state_diff_filtered_v1(const YTransaction *txn,
+                                                   const unsigned char *sv,
+                                                   int sv_len,
+                                                   const char *const *root_names,
+                                                   int root_names_len,
+                                                   int *len);
+
+/**
+ * Works like [ytransaction_state_diff_v1], but instead of returning an entire delta update at
+ * once, it streams it in chunks into a given `write_fn` callback, together with a caller-provided
+ * `ctx` pointer. This way a snapshot of a large document can be written straight into a file or
+ * a socket without keeping its entire binary representation in memory.
+ *
+ * Returns `0` on success or `-1` if `write_fn` callback returned an error, in which case the
+ * payload passed to it so far is incomplete.
+ */
+int ytransaction_state_diff_v1_stream(const YTransaction *txn,
+                                      const unsigned char *sv,
+                                      int sv_len,
+                                      YWriteCallback write_fn,
+                                      void *ctx);
+
 /**
  * Applies an diff update (generated by [ytransaction_state_diff_v1]) to a local transaction's
  * document.
@@ -667,6 +815,100 @@ unsigned char *ytransaction_state_diff_v1(const YTransaction *txn,
  */
 void ytransaction_apply(YTransaction *txn, const unsigned char *diff, int diff_len);
 
+/**
+ * Returns an entire state of a transaction's document encoded using a native snapshot format.
+ * Native snapshots are not meant to be exchanged with other peers, but they can be loaded much
+ * faster than lib0 updates using [ytransaction_load_native_snapshot].
+ *
+ * A length of generated snapshot binary will be passed within a `len` out parameter.
+ *
+ * Once no longer needed, a returned binary can be disposed using [ybinary_destroy] function.
+ */
+unsigned char *ytransaction_native_snapshot(const YTransaction *txn, int *len);
+
+/**
+ * Restores a state of a transaction's document from a native snapshot (generated by
+ * [ytransaction_native_snapshot]). Snapshot is loaded without integrating its blocks, therefore
+ * a document must not contain any data.
+ *
+ * A length of a `snapshot` binary must be passed within a `len` parameter.
+ */
+void ytransaction_load_native_snapshot(YTransaction *txn, const unsigned char *snapshot, int len);
+
+/**
+ * Returns an entire state of a transaction's document encoded using an indexed snapshot format.
+ * Unlike [ytransaction_native_snapshot], contents of every root type are stored separately, so
+ * that they can be loaded lazily using [ytransaction_load_indexed_snapshot].
+ *
+ * A length of generated snapshot binary will be passed within a `len` out parameter.
+ *
+ * Once no longer needed, a returned binary can be disposed using [ybinary_destroy] function.
+ */
+unsigned char *ytransaction_indexed_snapshot(const YTransaction *txn, int *len);
+
+/**
+ * Restores a state of a transaction's document from an indexed snapshot (generated by
+ * [ytransaction_indexed_snapshot]). Contents of root types are decoded once they are accessed
+ * for the first time. A document must not contain any data.
+ *
+ * A `snapshot` binary is copied, so it can be released right after this call. Its length must
+ * be passed within a `len` parameter.
+ */
+void ytransaction_load_indexed_snapshot(YTransaction *txn, const unsigned char *snapshot, int len);
+
+/**
+ * Opens an update log persisted in a given `dir` directory, creating it if necessary. `dir` must
+ * be a null-terminated UTF-8 encoded path. Returns a null pointer if the log couldn't be opened.
+ *
+ * Returned log should be eventually released using [yupdatelog_close] function.
+ */
+YUpdateLog *yupdatelog_open(const char *dir);
+
+/**
+ * Restores a persisted document state by applying a snapshot and all updates appended after it
+ * within a given transaction. Returns `0` on success or `-1` if log files couldn't be read or
+ * they contain malformed updates.
+ */
+int yupdatelog_load(YUpdateLog *log, YTransaction *txn);
+
+/**
+ * Appends a binary `update` of a given length `len` at the end of an update log. Appended updates
+ * are synchronized with a storage device in batches - use [yupdatelog_flush] to make them durable
+ * right away. Once a log grows over a configured threshold, it's compacted in the background.
+ *
+ * Returns `0` on success or `-1` if an `update` is malformed (in which case nothing is appended)
+ * or writing to a log has failed.
+ */
+int yupdatelog_append(YUpdateLog *log, const unsigned char *update, int len);
+
+/**
+ * Appends all changes made so far within a given transaction at the end of an update log.
+ * It should be called right before committing a transaction.
+ *
+ * Returns `0` on success or `-1` if writing to a log has failed.
+ */
+int yupdatelog_append_txn(YUpdateLog *log, const YTransaction *txn);
+
+/**
+ * Writes all appended updates into a log and synchronizes them with a storage device.
+ * Returns `0` on success or `-1` if writing to a log has failed.
+ */
+int yupdatelog_flush(YUpdateLog *log);
+
+/**
+ * Starts compaction of all updates appended so far into a snapshot on a background thread.
+ * New updates can be appended while compaction is running. Returns `0` on success or `-1` if
+ * a compaction couldn't be started or a previous one has failed.
+ */
+int yupdatelog_compact(YUpdateLog *log);
+
+/**
+ * Flushes all appended updates, waits for a background compaction to complete and releases
+ * an update log. Returns `0` on success or `-1` if any of these steps has failed - log is
+ * released in both cases.
+ */
+int yupdatelog_close(YUpdateLog *log);
+
 /**
  * Returns the length of the `YText` string content in bytes (without the null terminator character)
  */
@@ -707,6 +949,18 @@ void ytext_remove_range(const YText *txt, YTransaction *txn, int index, int leng
  */
 int yarray_len(const YArray *array);
 
+/**
+ * Writes a JSON representation of a current `YArray` and all of its nested elements into a given
+ * `write_fn` callback, together with a caller-provided `ctx` pointer. JSON is produced directly
+ * from the array contents, without materializing it as `YOutput` values first.
+ *
+ * Returns `0` on success or `-1` if `write_fn` callback returned an error.
+ */
+int yarray_to_json(const YArray *array,
+                   const YTransaction *txn,
+                   YWriteCallback write_fn,
+                   void *ctx);
+
 /**
  * Returns a pointer to a `YOutput` value stored at a given `index` of a current `YArray`.
  * If `index` is outside of the bounds of an array, a null pointer will be returned.
@@ -733,6 +987,21 @@ void yarray_insert_range(const YArray *array,
                          const struct YInput *items,
                          int items_len);
 
+/**
+ * Returns a pointer to a contiguous range of floating point numbers, starting at a given `index`
+ * of a current `YArray`, without copying them. Such ranges are created when [yarray_insert_range]
+ * is called with an input consisting only of [Y_JSON_NUM] values. A number of elements readable
+ * from returned pointer is written into `len`. It may be lower than the number of remaining array
+ * elements, since consecutive ranges can be separated by other inserts.
+ *
+ * If `index` is outside of the bounds of an array or an element at that index was not stored
+ * as a part of a packed floating point range, a null pointer will be returned.
+ *
+ * Returned pointer is borrowed from the document and must not be released. It's valid only until
+ * the next modification of a current document.
+ */
+const double *yarray_get_f64_range(const YArray *array, YTransaction *txn, int index, int *len);
+
 /**
  * Removes a `len` of consecutive range of elements from current `array` instance, starting at
  * a given `index`. Range determined by `index` and `len` must fit into boundaries of an array,
@@ -789,6 +1058,15 @@ struct YMapEntry *ymap_iter_next(YMapIter *iter);
  */
 int ymap_len(const YMap *map, const YTransaction *txn);
 
+/**
+ * Writes a JSON representation of a current `YMap` and all of its nested values into a given
+ * `write_fn` callback, together with a caller-provided `ctx` pointer. JSON is produced directly
+ * from the map contents, without materializing it as `YOutput` values first.
+ *
+ * Returns `0` on success or `-1` if `write_fn` callback returned an error.
+ */
+int ymap_to_json(const YMap *map, const YTransaction *txn, YWriteCallback write_fn, void *ctx);
+
 /**
  * Inserts a new entry (specified as `key`-`value` pair) into a current `map`. If entry under such
  * given `key` already existed, its corresponding value will be replaced.
@@ -801,6 +1079,21 @@ int ymap_len(const YMap *map, const YTransaction *txn);
  */
 void ymap_insert(const YMap *map, YTransaction *txn, const char *key, const struct YInput *value);
 
+/**
+ * Parses a `json` text of a given length `len` (in bytes) and inserts it as a new entry under
+ * a given `key` of a current `map`. If entry under such given `key` already existed, its
+ * corresponding value will be replaced.
+ *
+ * JSON objects and arrays are inserted as nested `YMap`s and `YArray`s, while other values are
+ * stored as they are. Whole JSON text is parsed at once and integrated within a given
+ * transaction, with consecutive primitive array elements stored together, so it's much faster
+ * than building an equivalent `YInput` tree.
+ *
+ * A `key` must be a null-terminated UTF-8 encoded string. Returns `0` on success or `-1` if
+ * `json` was not a valid UTF-8 encoded JSON text, in which case a `map` is left unchanged.
+ */
+int ymap_insert_json(const YMap *map, YTransaction *txn, const char *key, const char *json, int len);
+
 /**
  * Removes a `map` entry, given its `key`. Returns `1` if the corresponding entry was successfully
  * removed or `0` if no entry with a provided `key` has been found inside of a `map`.
@@ -841,6 +1134,18 @@ char *yxmlelem_tag(const YXmlElement *xml);
  */
 char *yxmlelem_string(const YXmlElement *xml, const YTransaction *txn);
 
+/**
+ * Works like [yxmlelem_string], but instead of returning an entire string at once, it streams it
+ * in chunks into a given `write_fn` callback, together with a caller-provided `ctx` pointer.
+ * An entire subtree is serialized in a single pass. Written string is not null-terminated.
+ *
+ * Returns `0` on success or `-1` if `write_fn` callback returned an error.
+ */
+int yxmlelem_write(const YXmlElement *xml,
+                   const YTransaction *txn,
+                   YWriteCallback write_fn,
+                   void *ctx);
+
 /**
  * Inserts an XML attribute described using `attr_name` and `attr_value`. If another attribute with
  * the same name already existed, its value will be replaced with a provided one.
@@ -1008,6 +1313,27 @@ YXmlElement *yxmlelem_insert_elem(const YXmlElement *xml,
  */
 YXmlText *yxmlelem_insert_text(const YXmlElement *xml, YTransaction *txn, int index);
 
+/**
+ * Parses an `xml_str` fragment of a given length `len` (in bytes) - a sequence of XML elements
+ * and text nodes - and inserts all of its top-level nodes as children of a current node,
+ * starting at the given `index`. Element attributes are inserted as well, while comments,
+ * processing instructions and document type declarations are skipped.
+ *
+ * An entire fragment is parsed first and then integrated in a single pass, which is much faster
+ * than building the same subtree using [yxmlelem_insert_elem], [yxmlelem_insert_text] and
+ * [yxmlelem_insert_attr] calls.
+ *
+ * An `index` value must be between 0 and (inclusive) length of a current XML element (use
+ * [yxmlelem_child_len] function to determine its length). Returns `0` on success or `-1` if
+ * `xml_str` was not a well-formed UTF-8 encoded XML fragment, in which case current XML element
+ * is left unchanged.
+ */
+int yxmlelem_insert_xml(const YXmlElement *xml,
+                        YTransaction *txn,
+                        int index,
+                        const char *xml_str,
+                        int len);
+
 /**
  * Removes a consecutive range of child elements (of specified length) from the current
  * `YXmlElement`, starting at the given `index`. Specified range must fit into boundaries of current
@@ -1243,6 +1569,18 @@ char *youtput_read_string(const struct YOutput *val);
  */
 const unsigned char *youtput_read_binary(const struct YOutput *val);
 
+/**
+ * Attempts to read the value for a given `YOutput` pointer as a binary payload, writing its
+ * length into `len`. Unlike [youtput_read_binary], returned pointer is borrowed from the document
+ * itself: binary payloads are shared between the document store and `YOutput` cells, so it stays
+ * valid even after `YOutput` has been released using [youtput_destroy], for as long as the
+ * transaction it was read from is alive and the value itself has not been removed.
+ *
+ * Returns a null pointer (and sets `len` to 0) in case when a value stored under current `YOutput`
+ * cell is not a binary type.
+ */
+const unsigned char *youtput_read_binary_view(const struct YOutput *val, int *len);
+
 /**
  * Attempts to read the value for a given `YOutput` pointer as a JSON-like array of `YOutput`
  * values (which length is stored within `len` filed of a cell itself).
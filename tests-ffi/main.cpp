@@ -63,6 +63,192 @@ TEST_CASE("Update exchange basic") {
     ydoc_destroy(d1);
 }
 
+typedef struct Chunks {
+    unsigned char* buf;
+    int len;
+    int calls;
+} Chunks;
+
+int append_chunk(void* ctx, const unsigned char* data, int len) {
+    Chunks* chunks = (Chunks*)ctx;
+    chunks->buf = (unsigned char*)realloc(chunks->buf, chunks->len + len);
+    memcpy(chunks->buf + chunks->len, data, len);
+    chunks->len += len;
+    chunks->calls++;
+    return 0;
+}
+
+int fail_chunk(void* ctx, const unsigned char* data, int len) {
+    return 1;
+}
+
+TEST_CASE("Update streaming") {
+    YDoc* d1 = ydoc_new_with_id(1);
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt1 = ytext(t1, "test");
+
+    // make an update bigger than a single streamed chunk
+    char content[20001];
+    memset(content, 'a', 20000);
+    content[20000] = '\0';
+    ytext_insert(txt1, t1, 0, content);
+
+    int expected_len = 0;
+    unsigned char* expected = ytransaction_state_diff_v1(t1, NULL, 0, &expected_len);
+
+    Chunks chunks = { NULL, 0, 0 };
+    REQUIRE(ytransaction_state_diff_v1_stream(t1, NULL, 0, &append_chunk, &chunks) == 0);
+    REQUIRE(chunks.calls > 1);
+    REQUIRE(chunks.len == expected_len);
+    REQUIRE(!memcmp(chunks.buf, expected, expected_len));
+
+    REQUIRE(ytransaction_state_diff_v1_stream(t1, NULL, 0, &fail_chunk, NULL) == -1);
+
+    // streamed update can be applied on a remote peer
+    YDoc* d2 = ydoc_new_with_id(2);
+    YTransaction* t2 = ytransaction_new(d2);
+    YText* txt2 = ytext(t2, "test");
+    ytransaction_apply(t2, chunks.buf, chunks.len);
+
+    char* str = ytext_string(txt2, t2);
+    REQUIRE(!strcmp(str, content));
+
+    ystring_destroy(str);
+    free(chunks.buf);
+    ybinary_destroy(expected, expected_len);
+
+    ytext_destroy(txt2);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+
+    ytext_destroy(txt1);
+    ytransaction_commit(t1);
+    ydoc_destroy(d1);
+}
+
+TEST_CASE("Update filtered by root types") {
+    YDoc* d1 = ydoc_new_with_id(1);
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt1 = ytext(t1, "text");
+    ytext_insert(txt1, t1, 0, "hello");
+    YText* other = ytext(t1, "other");
+    ytext_insert(other, t1, 0, "skipped");
+    ytext_insert(txt1, t1, 5, " world");
+    ytext_destroy(other);
+
+    const char* roots[] = { "text" };
+    int u_len = 0;
+    unsigned char* u = ytransaction_state_diff_filtered_v1(t1, NULL, 0, roots, 1, &u_len);
+
+    YDoc* d2 = ydoc_new_with_id(2);
+    YTransaction* t2 = ytransaction_new(d2);
+    ytransaction_apply(t2, u, u_len);
+    ybinary_destroy(u, u_len);
+
+    YText* txt2 = ytext(t2, "text");
+    char* str = ytext_string(txt2, t2);
+    REQUIRE(!strcmp(str, "hello world"));
+    ystring_destroy(str);
+
+    other = ytext(t2, "other");
+    REQUIRE(ytext_len(other) == 0);
+    ytext_destroy(other);
+
+    ytext_destroy(txt2);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+
+    ytext_destroy(txt1);
+    ytransaction_commit(t1);
+    ydoc_destroy(d1);
+}
+
+void store_update(void* ctx, const unsigned char* data, int len) {
+    Chunks* update = (Chunks*)ctx;
+    update->buf = (unsigned char*)realloc(update->buf, len);
+    memcpy(update->buf, data, len);
+    update->len = len;
+    update->calls++;
+}
+
+TEST_CASE("Observe committed transactions") {
+    YDoc* d1 = ydoc_new_with_id(1);
+    Chunks update = { NULL, 0, 0 };
+    YAfterTransactionSubscription* sub = ydoc_observe_after_transaction(d1, &update, &store_update);
+
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt1 = ytext(t1, "test");
+    ytext_insert(txt1, t1, 0, "hello");
+    ytext_destroy(txt1);
+    ytransaction_commit(t1);
+    REQUIRE(update.calls == 1);
+
+    YDoc* d2 = ydoc_new_with_id(2);
+    YTransaction* t2 = ytransaction_new(d2);
+    ytransaction_apply(t2, update.buf, update.len);
+    YText* txt2 = ytext(t2, "test");
+    char* str = ytext_string(txt2, t2);
+    REQUIRE(!strcmp(str, "hello"));
+    ystring_destroy(str);
+    ytext_destroy(txt2);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+
+    // unsubscribed callback is no longer called
+    yunobserve_after_transaction(sub);
+    t1 = ytransaction_new(d1);
+    txt1 = ytext(t1, "test");
+    ytext_insert(txt1, t1, 5, " world");
+    ytext_destroy(txt1);
+    ytransaction_commit(t1);
+    REQUIRE(update.calls == 1);
+
+    free(update.buf);
+    ydoc_destroy(d1);
+}
+
+TEST_CASE("Observe remote updates") {
+    YDoc* d1 = ydoc_new_with_id(1);
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt1 = ytext(t1, "test");
+    ytext_insert(txt1, t1, 0, "hello");
+    ytext_destroy(txt1);
+    int u_len = 0;
+    unsigned char* u = ytransaction_state_diff_v1(t1, NULL, 0, &u_len);
+    ytransaction_commit(t1);
+    ydoc_destroy(d1);
+
+    YDoc* d2 = ydoc_new_with_id(2);
+    Chunks update = { NULL, 0, 0 };
+    YUpdateSubscription* sub = ydoc_observe_updates_v1(d2, &update, &store_update);
+    YTransaction* t2 = ytransaction_new(d2);
+    ytransaction_apply(t2, u, u_len);
+    ytransaction_commit(t2);
+    REQUIRE(update.calls == 1);
+
+    // observed update can be forwarded to other peers
+    YDoc* d3 = ydoc_new_with_id(3);
+    YTransaction* t3 = ytransaction_new(d3);
+    ytransaction_apply(t3, update.buf, update.len);
+    YText* txt3 = ytext(t3, "test");
+    char* str = ytext_string(txt3, t3);
+    REQUIRE(!strcmp(str, "hello"));
+    ystring_destroy(str);
+    ytext_destroy(txt3);
+    ytransaction_commit(t3);
+    ydoc_destroy(d3);
+
+    yunobserve_updates_v1(sub);
+    t2 = ytransaction_new(d2);
+    ytransaction_apply(t2, u, u_len);
+    ytransaction_commit(t2);
+    REQUIRE(update.calls == 1);
+
+    ybinary_destroy(u, u_len);
+    free(update.buf);
+    ydoc_destroy(d2);
+}
+
 TEST_CASE("YText basic") {
     YDoc* doc = ydoc_new_with_id(1);
     YTransaction* txn = ytransaction_new(doc);
@@ -141,6 +327,45 @@ TEST_CASE("YArray basic") {
     ydoc_destroy(doc);
 }
 
+TEST_CASE("YArray packed numbers") {
+    YDoc* doc = ydoc_new_with_id(1);
+    YTransaction* txn = ytransaction_new(doc);
+    YArray* arr = yarray(txn, "test");
+
+    const int ARG_LEN = 3;
+
+    YInput* args = (YInput*)malloc(ARG_LEN * sizeof(YInput));
+    args[0] = yinput_float(0.5);
+    args[1] = yinput_float(1.5);
+    args[2] = yinput_float(2.5);
+
+    yarray_insert_range(arr, txn, 0, args, ARG_LEN); //state after: [0.5, 1.5, 2.5]
+
+    args[0] = yinput_string("hello");
+    yarray_insert_range(arr, txn, 1, args, 1); //state after: [0.5, 'hello', 1.5, 2.5]
+
+    free(args);
+
+    int len = 0;
+    const double* nums = yarray_get_f64_range(arr, txn, 2, &len);
+    REQUIRE_EQ(len, 2);
+    REQUIRE_EQ(nums[0], 1.5);
+    REQUIRE_EQ(nums[1], 2.5);
+
+    nums = yarray_get_f64_range(arr, txn, 1, &len);
+    REQUIRE(nums == NULL);
+    REQUIRE_EQ(len, 0);
+
+    // packed numbers are still readable as regular values
+    YOutput* elem = yarray_get(arr, txn, 0);
+    REQUIRE_EQ(*youtput_read_float(elem), 0.5);
+    youtput_destroy(elem);
+
+    yarray_destroy(arr);
+    ytransaction_commit(txn);
+    ydoc_destroy(doc);
+}
+
 TEST_CASE("YMap basic") {
     YDoc* doc = ydoc_new_with_id(1);
     YTransaction* txn = ytransaction_new(doc);
@@ -227,6 +452,101 @@ TEST_CASE("YMap basic") {
     ydoc_destroy(doc);
 }
 
+TEST_CASE("YMap binary view") {
+    YDoc* doc = ydoc_new_with_id(1);
+    YTransaction* txn = ytransaction_new(doc);
+    YMap* map = ymap(txn, "test");
+
+    const unsigned char payload[4] = { 1, 2, 3, 4 };
+    YInput in = yinput_binary(payload, 4);
+    ymap_insert(map, txn, "bin", &in);
+
+    int len = 0;
+    YOutput* o1 = ymap_get(map, txn, "bin");
+    const unsigned char* v1 = youtput_read_binary_view(o1, &len);
+    REQUIRE_EQ(len, 4);
+    REQUIRE(memcmp(v1, payload, 4) == 0);
+
+    // every read shares the same buffer with the document
+    YOutput* o2 = ymap_get(map, txn, "bin");
+    REQUIRE(youtput_read_binary(o2) == v1);
+
+    youtput_destroy(o1);
+    youtput_destroy(o2);
+
+    // view is still valid, since it's owned by the document
+    REQUIRE(memcmp(v1, payload, 4) == 0);
+
+    ymap_destroy(map);
+    ytransaction_commit(txn);
+    ydoc_destroy(doc);
+}
+
+TEST_CASE("JSON export") {
+    YDoc* doc = ydoc_new_with_id(1);
+    YTransaction* txn = ytransaction_new(doc);
+    YMap* map = ymap(txn, "map");
+    YArray* arr = yarray(txn, "array");
+
+    YInput* nested = (YInput*)malloc(2 * sizeof(YInput));
+    nested[0] = yinput_float(0.5);
+    nested[1] = yinput_string("a\"b");
+    YInput value = yinput_yarray(nested, 2);
+    ymap_insert(map, txn, "key", &value);
+    free(nested);
+
+    YInput* args = (YInput*)malloc(2 * sizeof(YInput));
+    args[0] = yinput_bool(1);
+    args[1] = yinput_null();
+    yarray_insert_range(arr, txn, 0, args, 2);
+    free(args);
+
+    Chunks chunks = { NULL, 0, 0 };
+    REQUIRE(ymap_to_json(map, txn, &append_chunk, &chunks) == 0);
+    const char* expected_map = "{\"key\":[0.5,\"a\\\"b\"]}";
+    REQUIRE(chunks.len == (int)strlen(expected_map));
+    REQUIRE(!memcmp(chunks.buf, expected_map, chunks.len));
+    free(chunks.buf);
+
+    chunks = { NULL, 0, 0 };
+    REQUIRE(yarray_to_json(arr, txn, &append_chunk, &chunks) == 0);
+    REQUIRE(chunks.len == 11);
+    REQUIRE(!memcmp(chunks.buf, "[true,null]", 11));
+    free(chunks.buf);
+
+    REQUIRE(yarray_to_json(arr, txn, &fail_chunk, NULL) == -1);
+
+    yarray_destroy(arr);
+    ymap_destroy(map);
+    ytransaction_commit(txn);
+    ydoc_destroy(doc);
+}
+
+TEST_CASE("YMap JSON import") {
+    YDoc* doc = ydoc_new_with_id(1);
+    YTransaction* txn = ytransaction_new(doc);
+    YMap* map = ymap(txn, "map");
+
+    const char* json = "{ \"list\": [1, 2, {\"b\": true}, \"x\"] }";
+    REQUIRE(ymap_insert_json(map, txn, "key", json, strlen(json)) == 0);
+    REQUIRE_EQ(ymap_len(map, txn), 1);
+
+    // invalid JSON doesn't modify the map
+    REQUIRE(ymap_insert_json(map, txn, "other", "[1,", 3) == -1);
+    REQUIRE_EQ(ymap_len(map, txn), 1);
+
+    Chunks chunks = { NULL, 0, 0 };
+    REQUIRE(ymap_to_json(map, txn, &append_chunk, &chunks) == 0);
+    const char* expected = "{\"key\":{\"list\":[1,2,{\"b\":true},\"x\"]}}";
+    REQUIRE(chunks.len == (int)strlen(expected));
+    REQUIRE(!memcmp(chunks.buf, expected, chunks.len));
+    free(chunks.buf);
+
+    ymap_destroy(map);
+    ytransaction_commit(txn);
+    ydoc_destroy(doc);
+}
+
 TEST_CASE("YXmlElement basic") {
     YDoc* doc = ydoc_new_with_id(1);
     YTransaction* txn = ytransaction_new(doc);
@@ -305,6 +625,12 @@ TEST_CASE("YXmlElement basic") {
     REQUIRE(!strcmp(str, "<p>hello</p>"));
     ystring_destroy(str);
 
+    Chunks chunks = { NULL, 0, 0 };
+    REQUIRE(yxmlelem_write(first, txn, &append_chunk, &chunks) == 0);
+    REQUIRE(chunks.len == 12);
+    REQUIRE(!memcmp(chunks.buf, "<p>hello</p>", 12));
+    free(chunks.buf);
+
     YOutput* next = yxmlelem_next_sibling(first, txn);
     youtput_destroy(curr);
     YXmlText* second = youtput_read_yxmltext(next);
@@ -353,4 +679,180 @@ TEST_CASE("YXmlElement basic") {
     yxmlelem_destroy(xml);
     ytransaction_commit(txn);
     ydoc_destroy(doc);
-}
\ No newline at end of file
+}
+
+TEST_CASE("YXmlElement XML import") {
+    YDoc* doc = ydoc_new_with_id(1);
+    YTransaction* txn = ytransaction_new(doc);
+    YXmlElement* xml = yxmlelem(txn, "test");
+
+    const char* fragment = "<p key=\"value\">hello <b>world</b></p><br/>";
+    REQUIRE(yxmlelem_insert_xml(xml, txn, 0, fragment, strlen(fragment)) == 0);
+    REQUIRE_EQ(yxmlelem_child_len(xml, txn), 2);
+
+    // malformed fragment is rejected as a whole
+    REQUIRE(yxmlelem_insert_xml(xml, txn, 1, "<p><b></p>", 10) == -1);
+    REQUIRE_EQ(yxmlelem_child_len(xml, txn), 2);
+
+    char* str = yxmlelem_string(xml, txn);
+    REQUIRE(!strcmp(str, "<UNDEFINED><p \"key\"=\"value\">hello <b>world</b></p><br></br></UNDEFINED>"));
+    ystring_destroy(str);
+
+    yxmlelem_destroy(xml);
+    ytransaction_commit(txn);
+    ydoc_destroy(doc);
+}
+
+TEST_CASE("Update log persistence") {
+    const char* dir = "/tmp/yffi-update-log-test";
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    system(cmd);
+
+    YDoc* d1 = ydoc_new_with_id(1);
+    YUpdateLog* log = yupdatelog_open(dir);
+    REQUIRE(log != NULL);
+    const unsigned char malformed[] = { 1, 2, 3 };
+    REQUIRE(yupdatelog_append(log, malformed, 3) == -1);
+    for (int i = 0; i < 3; i++) {
+        YTransaction* t1 = ytransaction_new(d1);
+        YText* txt = ytext(t1, "test");
+        ytext_insert(txt, t1, ytext_len(txt), "abc");
+        REQUIRE(yupdatelog_append_txn(log, t1) == 0);
+        ytext_destroy(txt);
+        ytransaction_commit(t1);
+        if (i == 1) {
+            REQUIRE(yupdatelog_compact(log) == 0);
+        }
+    }
+    REQUIRE(yupdatelog_close(log) == 0);
+    ydoc_destroy(d1);
+
+    YDoc* d2 = ydoc_new_with_id(2);
+    YTransaction* t2 = ytransaction_new(d2);
+    log = yupdatelog_open(dir);
+    REQUIRE(yupdatelog_load(log, t2) == 0);
+    REQUIRE(yupdatelog_close(log) == 0);
+
+    YText* txt = ytext(t2, "test");
+    char* str = ytext_string(txt, t2);
+    REQUIRE(!strcmp(str, "abcabcabc"));
+    ystring_destroy(str);
+
+    ytext_destroy(txt);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+    system(cmd);
+}
+
+TEST_CASE("Load memory-mapped snapshot") {
+    const char* path = "/tmp/yffi-mmap-snapshot-test.bin";
+
+    YDoc* d1 = ydoc_new_with_id(1);
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt = ytext(t1, "test");
+    ytext_insert(txt, t1, 0, "hello world");
+    ytext_destroy(txt);
+
+    int len = 0;
+    unsigned char* snapshot = ytransaction_state_diff_v1(t1, NULL, 0, &len);
+    FILE* file = fopen(path, "wb");
+    REQUIRE(file != NULL);
+    REQUIRE(fwrite(snapshot, 1, len, file) == (size_t)len);
+    fclose(file);
+
+    // truncated file is reported as a failure instead of crashing
+    const char* truncated_path = "/tmp/yffi-mmap-snapshot-truncated.bin";
+    file = fopen(truncated_path, "wb");
+    REQUIRE(file != NULL);
+    REQUIRE(fwrite(snapshot, 1, len - 3, file) == (size_t)(len - 3));
+    fclose(file);
+    REQUIRE(ydoc_load_mmap(truncated_path) == NULL);
+    remove(truncated_path);
+
+    ybinary_destroy(snapshot, len);
+    ytransaction_commit(t1);
+    ydoc_destroy(d1);
+
+    YDoc* d2 = ydoc_load_mmap(path);
+    REQUIRE(d2 != NULL);
+    YTransaction* t2 = ytransaction_new(d2);
+    txt = ytext(t2, "test");
+    char* str = ytext_string(txt, t2);
+    REQUIRE(!strcmp(str, "hello world"));
+    ystring_destroy(str);
+    ytext_destroy(txt);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+    remove(path);
+
+    REQUIRE(ydoc_load_mmap("/tmp/yffi-mmap-snapshot-missing.bin") == NULL);
+}
+
+TEST_CASE("Native snapshot") {
+    YDoc* d1 = ydoc_new_with_id(1);
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt = ytext(t1, "test");
+    ytext_insert(txt, t1, 0, "hello world");
+    ytext_remove_range(txt, t1, 5, 6);
+    ytext_destroy(txt);
+    ytransaction_commit(t1);
+
+    t1 = ytransaction_new(d1);
+    int len = 0;
+    unsigned char* snapshot = ytransaction_native_snapshot(t1, &len);
+    ytransaction_commit(t1);
+    ydoc_destroy(d1);
+
+    YDoc* d2 = ydoc_new_with_id(2);
+    YTransaction* t2 = ytransaction_new(d2);
+    ytransaction_load_native_snapshot(t2, snapshot, len);
+    ybinary_destroy(snapshot, len);
+
+    txt = ytext(t2, "test");
+    ytext_insert(txt, t2, 5, "!");
+    char* str = ytext_string(txt, t2);
+    REQUIRE(!strcmp(str, "hello!"));
+    ystring_destroy(str);
+    ytext_destroy(txt);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+}
+
+TEST_CASE("Indexed snapshot") {
+    YDoc* d1 = ydoc_new_with_id(1);
+    YTransaction* t1 = ytransaction_new(d1);
+    YText* txt = ytext(t1, "test");
+    ytext_insert(txt, t1, 0, "hello world");
+    ytext_remove_range(txt, t1, 5, 6);
+    ytext_destroy(txt);
+    YMap* map = ymap(t1, "map");
+    YInput value = yinput_string("value");
+    ymap_insert(map, t1, "key", &value);
+    ymap_destroy(map);
+    ytransaction_commit(t1);
+
+    t1 = ytransaction_new(d1);
+    int len = 0;
+    unsigned char* snapshot = ytransaction_indexed_snapshot(t1, &len);
+    ytransaction_commit(t1);
+    ydoc_destroy(d1);
+
+    YDoc* d2 = ydoc_new_with_id(2);
+    YTransaction* t2 = ytransaction_new(d2);
+    ytransaction_load_indexed_snapshot(t2, snapshot, len);
+    ybinary_destroy(snapshot, len);
+
+    txt = ytext(t2, "test");
+    ytext_insert(txt, t2, 5, "!");
+    char* str = ytext_string(txt, t2);
+    REQUIRE(!strcmp(str, "hello!"));
+    ystring_destroy(str);
+    ytext_destroy(txt);
+
+    map = ymap(t2, "map");
+    REQUIRE(ymap_len(map, t2) == 1);
+    ymap_destroy(map);
+    ytransaction_commit(t2);
+    ydoc_destroy(d2);
+}
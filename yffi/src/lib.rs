@@ -2,7 +2,8 @@ use lib0::any::Any;
 use std::collections::HashMap;
 use std::ffi::{CStr, CString};
 use std::mem::{forget, ManuallyDrop, MaybeUninit};
-use std::os::raw::{c_char, c_float, c_int, c_long, c_uchar, c_ulong};
+use std::os::raw::{c_char, c_float, c_int, c_long, c_uchar, c_ulong, c_void};
+use std::rc::Rc;
 use yrs::block::{ItemContent, Prelim};
 use yrs::types::{
     Branch, BranchRef, TypePtr, Value, TYPE_REFS_ARRAY, TYPE_REFS_MAP, TYPE_REFS_XML_ELEMENT,
@@ -10,6 +11,7 @@ use yrs::types::{
 };
 use yrs::updates::decoder::{Decode, DecoderV1};
 use yrs::updates::encoder::{Encode, Encoder, EncoderV1};
+use yrs::PrelimJson;
 use yrs::StateVector;
 use yrs::Update;
 use yrs::{Xml};
@@ -207,6 +209,31 @@ pub type Attributes = yrs::types::xml::Attributes<'static, 'static>;
 /// traverse.
 pub type TreeWalker = yrs::types::xml::TreeWalker<'static, 'static>;
 
+/// Append-only log of document updates persisted in a local directory. Updates appended to it
+/// are periodically compacted into a snapshot in the background. A document can be restored from
+/// a snapshot and all updates appended after it.
+pub type UpdateLog = yrs::persistence::UpdateLog;
+
+/// A subscription for updates produced by committed transactions, created with
+/// [ydoc_observe_after_transaction]. It can be released using [yunobserve_after_transaction].
+pub type AfterTransactionSubscription = yrs::Subscription<yrs::AfterTransactionEvent>;
+
+/// A subscription for updates incoming from remote peers, created with [ydoc_observe_updates_v1].
+/// It can be released using [yunobserve_updates_v1].
+pub type UpdateSubscription = yrs::Subscription<yrs::UpdateEvent>;
+
+/// A callback used by document observers (like [ydoc_observe_updates_v1]). It's called
+/// with a caller-provided `ctx` pointer, a pointer to an update binary and its length. Update
+/// memory is valid only for the duration of a call.
+pub type YUpdateCallback = extern "C" fn(*mut c_void, *const c_uchar, c_int);
+
+/// A callback used by streaming functions (like [ytransaction_state_diff_v1_stream]) to pass
+/// chunks of generated binary data to the caller. It's called with a caller-provided `ctx`
+/// pointer, a pointer to a data chunk and a chunk length. Chunk memory is valid only for the
+/// duration of a call. Callback should return `0` on success - any other value aborts
+/// the streaming function.
+pub type YWriteCallback = extern "C" fn(*mut c_void, *const c_uchar, c_int) -> c_int;
+
 /// A structure representing single key-value entry of a map output (used by either
 /// embedded JSON-like maps or YMaps).
 #[repr(C)]
@@ -376,6 +403,111 @@ pub unsafe extern "C" fn ydoc_id(doc: *mut Doc) -> c_ulong {
     doc.client_id as c_ulong
 }
 
+/// Creates a new [Doc] instance and restores its state from a snapshot stored in a file under
+/// a given `path` (ie. a binary produced by [ytransaction_state_diff_v1] with an empty state
+/// vector). A file is memory-mapped and decoded directly from the mapping instead of being read
+/// into an intermediate buffer first.
+///
+/// A file must not be truncated or modified (by this or any other process) until this function
+/// returns. Otherwise a process may crash with `SIGBUS` or decode inconsistent data.
+///
+/// Returns a null pointer if a file couldn't be read or if it doesn't contain a valid update
+/// (ie. it's truncated or corrupted). Use [ydoc_destroy] in order to release created [Doc]
+/// resources.
+#[no_mangle]
+pub unsafe extern "C" fn ydoc_load_mmap(path: *const c_char) -> *mut Doc {
+    assert!(!path.is_null());
+
+    let path = CStr::from_ptr(path).to_str().unwrap();
+    let file = match yrs::persistence::MappedFile::open(path) {
+        Ok(file) => file,
+        Err(_) => return std::ptr::null_mut(),
+    };
+    // decoder panics on malformed input, which must not unwind across the FFI boundary
+    let update = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| {
+        let mut decoder = DecoderV1::from(file.as_ref());
+        Update::decode(&mut decoder)
+    }));
+    drop(file);
+    match update {
+        Ok(update) => {
+            let doc = Doc::new();
+            {
+                let mut txn = doc.transact();
+                txn.apply_update(update);
+            }
+            Box::into_raw(Box::new(doc))
+        }
+        Err(_) => std::ptr::null_mut(),
+    }
+}
+
+/// Subscribes a given `callback` to be called, together with a caller-provided `ctx` pointer,
+/// every time a transaction, which made changes to a given document, is committed. Callback
+/// receives an update containing only the changes made by that transaction encoded using lib0 v1
+/// encoding, which can be applied on other peers using [ytransaction_apply].
+///
+/// Callback is called while a committed transaction is still active, so it must not use `doc`
+/// itself. Returned subscription must be released using [yunobserve_after_transaction].
+#[no_mangle]
+pub unsafe extern "C" fn ydoc_observe_after_transaction(
+    doc: *mut Doc,
+    ctx: *mut c_void,
+    callback: YUpdateCallback,
+) -> *mut AfterTransactionSubscription {
+    assert!(!doc.is_null());
+
+    let subscription = doc
+        .as_mut()
+        .unwrap()
+        .on_after_transaction(move |e| callback(ctx, e.update.as_ptr(), e.update.len() as c_int));
+    Box::into_raw(Box::new(subscription))
+}
+
+/// Releases a subscription created with [ydoc_observe_after_transaction]. Its callback will no
+/// longer be called.
+#[no_mangle]
+pub unsafe extern "C" fn yunobserve_after_transaction(
+    subscription: *mut AfterTransactionSubscription,
+) {
+    if !subscription.is_null() {
+        drop(Box::from_raw(subscription));
+    }
+}
+
+/// Subscribes a given `callback` to be called, together with a caller-provided `ctx` pointer,
+/// every time an update coming from a remote peer is about to be applied to a given document
+/// (eg. via [ytransaction_apply]). Callback receives an update encoded using lib0 v1 encoding.
+///
+/// Update binary is not the one passed to [ytransaction_apply]: it's re-encoded from a decoded
+/// update into a fresh buffer for every event. That buffer is released once the callback
+/// returns, so it must be copied in order to be kept and must not be released by the callback.
+/// Callback is called while a transaction applying an update is still active, so it must not
+/// use `doc` itself. Returned subscription must be released using [yunobserve_updates_v1].
+#[no_mangle]
+pub unsafe extern "C" fn ydoc_observe_updates_v1(
+    doc: *mut Doc,
+    ctx: *mut c_void,
+    callback: YUpdateCallback,
+) -> *mut UpdateSubscription {
+    assert!(!doc.is_null());
+
+    let subscription = doc.as_mut().unwrap().on_update(move |e| {
+        let update = e.update.encode_v1();
+        callback(ctx, update.as_ptr(), update.len() as c_int)
+    });
+    Box::into_raw(Box::new(subscription))
+}
+
+/// Releases a subscription created with [ydoc_observe_updates_v1]. Its callback will no longer
+/// be called.
+#[no_mangle]
+pub unsafe extern "C" fn yunobserve_updates_v1(subscription: *mut UpdateSubscription) {
+    if !subscription.is_null() {
+        drop(Box::from_raw(subscription));
+    }
+}
+
 /// Starts a new read-write transaction on a given document. All other operations happen in context
 /// of a transaction. Yrs transactions do not follow ACID rules. Once a set of operations is
 /// complete, a transaction can be finished using [ytransaction_commit] function.
@@ -513,6 +645,9 @@ pub unsafe extern "C" fn ytransaction_state_vector_v1(
 /// If passed `sv` pointer is null, the generated diff will be a snapshot containing entire state of
 /// the document.
 ///
+/// Generated diffs are cached by a document until it changes, so that requests from many peers
+/// sharing the same state vector are served without encoding the same update again.
+///
 /// A length of an encoded state vector payload must be passed as `sv_len` parameter.
 ///
 /// A length of generated delta diff binary will be passed within a `len` out parameter.
@@ -536,13 +671,133 @@ pub unsafe extern "C" fn ytransaction_state_diff_v1(
         }
     };
 
+    // encoded buffer is allocated with its exact size, so it's not reallocated when boxed
+    let binary = txn.as_ref().unwrap().encode_diff_v1(&sv).into_boxed_slice();
+    *len = binary.len() as c_int;
+    Box::into_raw(binary) as *mut c_uchar
+}
+
+/// Works like [ytransaction_state_diff_v1], but the generated delta contains only the contents of
+/// root types, which names were passed within `root_names` array of null-terminated UTF-8
+/// strings. It's meant for remote peers, which replicate only a part of a document.
+///
+/// Contents of all other root types are sent as garbage collected blocks. Once such delta is
+/// applied, remote peer's state vector covers them, so they will not be sent to it again, even
+/// by an unfiltered [ytransaction_state_diff_v1]. A peer, which needs to replicate more root
+/// types than it used to, must start over from an empty document.
+///
+/// A length of `root_names` array must be passed as `root_names_len` parameter.
+///
+/// A length of generated delta diff binary will be passed within a `len` out parameter.
+///
+/// Once no longer needed, a returned binary can be disposed using [ybinary_destroy] function.
+#[no_mangle]
+pub unsafe extern "C" fn ytransaction_state_diff_filtered_v1(
+    txn: *const Transaction,
+    sv: *const c_uchar,
+    sv_len: c_int,
+    root_names: *const *const c_char,
+    root_names_len: c_int,
+    len: *mut c_int,
+) -> *mut c_uchar {
+    assert!(!txn.is_null());
+    assert!(!root_names.is_null() || root_names_len == 0);
+
+    let sv = {
+        if sv.is_null() {
+            StateVector::default()
+        } else {
+            let sv_slice = std::slice::from_raw_parts(sv as *const u8, sv_len as usize);
+            StateVector::decode_v1(sv_slice)
+        }
+    };
+    let mut names = Vec::with_capacity(root_names_len as usize);
+    for i in 0..root_names_len as isize {
+        let name = CStr::from_ptr(root_names.offset(i).read());
+        names.push(name.to_str().unwrap());
+    }
+
     let mut encoder = EncoderV1::new();
-    txn.as_ref().unwrap().encode_diff(&sv, &mut encoder);
+    txn.as_ref()
+        .unwrap()
+        .encode_diff_filtered(&sv, &names, &mut encoder);
     let binary = encoder.to_vec().into_boxed_slice();
     *len = binary.len() as c_int;
     Box::into_raw(binary) as *mut c_uchar
 }
 
+/// Works like [ytransaction_state_diff_v1], but instead of returning an entire delta update at
+/// once, it streams it in chunks into a given `write_fn` callback, together with a caller-provided
+/// `ctx` pointer. This way a snapshot of a large document can be written straight into a file or
+/// a socket without keeping its entire binary representation in memory.
+///
+/// Returns `0` on success or `-1` if `write_fn` callback returned an error, in which case the
+/// payload passed to it so far is incomplete.
+#[no_mangle]
+pub unsafe extern "C" fn ytransaction_state_diff_v1_stream(
+    txn: *const Transaction,
+    sv: *const c_uchar,
+    sv_len: c_int,
+    write_fn: YWriteCallback,
+    ctx: *mut c_void,
+) -> c_int {
+    assert!(!txn.is_null());
+
+    let sv = {
+        if sv.is_null() {
+            StateVector::default()
+        } else {
+            let sv_slice = std::slice::from_raw_parts(sv as *const u8, sv_len as usize);
+            StateVector::decode_v1(sv_slice)
+        }
+    };
+
+    let writer = CallbackWriter { write_fn, ctx };
+    match txn.as_ref().unwrap().encode_diff_to(&sv, writer) {
+        Ok(_) => 0,
+        Err(_) => -1,
+    }
+}
+
+/// Runs a given serializer (like JSON or XML one) over a buffered [CallbackWriter], so that
+/// `write_fn` is not called for every single token. Returns `0` on success or `-1` on error.
+fn write_buffered<F>(write_fn: YWriteCallback, ctx: *mut c_void, f: F) -> c_int
+where
+    F: FnOnce(&mut std::io::BufWriter<CallbackWriter>) -> std::io::Result<()>,
+{
+    let mut writer = std::io::BufWriter::new(CallbackWriter { write_fn, ctx });
+    let result = f(&mut writer).and_then(|_| std::io::Write::flush(&mut writer));
+    if result.is_ok() {
+        0
+    } else {
+        -1
+    }
+}
+
+/// Adapter passing data written into it to a [YWriteCallback].
+struct CallbackWriter {
+    write_fn: YWriteCallback,
+    ctx: *mut c_void,
+}
+
+impl std::io::Write for CallbackWriter {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        let len = buf.len().min(c_int::MAX as usize);
+        if (self.write_fn)(self.ctx, buf.as_ptr(), len as c_int) == 0 {
+            Ok(len)
+        } else {
+            Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "write callback returned an error",
+            ))
+        }
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
 /// Applies an diff update (generated by [ytransaction_state_diff_v1]) to a local transaction's
 /// document.
 ///
@@ -562,6 +817,198 @@ pub unsafe extern "C" fn ytransaction_apply(
     txn.as_mut().unwrap().apply_update(update)
 }
 
+/// Returns an entire state of a transaction's document encoded using a native snapshot format.
+/// Native snapshots are not meant to be exchanged with other peers, but they can be loaded much
+/// faster than lib0 updates using [ytransaction_load_native_snapshot].
+///
+/// A length of generated snapshot binary will be passed within a `len` out parameter.
+///
+/// Once no longer needed, a returned binary can be disposed using [ybinary_destroy] function.
+#[no_mangle]
+pub unsafe extern "C" fn ytransaction_native_snapshot(
+    txn: *const Transaction,
+    len: *mut c_int,
+) -> *mut c_uchar {
+    assert!(!txn.is_null());
+
+    let binary = txn
+        .as_ref()
+        .unwrap()
+        .encode_native_snapshot()
+        .into_boxed_slice();
+    *len = binary.len() as c_int;
+    Box::into_raw(binary) as *mut c_uchar
+}
+
+/// Restores a state of a transaction's document from a native snapshot (generated by
+/// [ytransaction_native_snapshot]). Snapshot is loaded without integrating its blocks, therefore
+/// a document must not contain any data.
+///
+/// A length of a `snapshot` binary must be passed within a `len` parameter.
+#[no_mangle]
+pub unsafe extern "C" fn ytransaction_load_native_snapshot(
+    txn: *mut Transaction,
+    snapshot: *const c_uchar,
+    len: c_int,
+) {
+    assert!(!txn.is_null());
+    assert!(!snapshot.is_null());
+
+    let snapshot = std::slice::from_raw_parts(snapshot as *const u8, len as usize);
+    txn.as_mut().unwrap().load_native_snapshot(snapshot)
+}
+
+/// Returns an entire state of a transaction's document encoded using an indexed snapshot format.
+/// Unlike [ytransaction_native_snapshot], contents of every root type are stored separately, so
+/// that they can be loaded lazily using [ytransaction_load_indexed_snapshot].
+///
+/// A length of generated snapshot binary will be passed within a `len` out parameter.
+///
+/// Once no longer needed, a returned binary can be disposed using [ybinary_destroy] function.
+#[no_mangle]
+pub unsafe extern "C" fn ytransaction_indexed_snapshot(
+    txn: *const Transaction,
+    len: *mut c_int,
+) -> *mut c_uchar {
+    assert!(!txn.is_null());
+
+    let binary = txn
+        .as_ref()
+        .unwrap()
+        .encode_indexed_snapshot()
+        .into_boxed_slice();
+    *len = binary.len() as c_int;
+    Box::into_raw(binary) as *mut c_uchar
+}
+
+/// Restores a state of a transaction's document from an indexed snapshot (generated by
+/// [ytransaction_indexed_snapshot]). Contents of root types are decoded once they are accessed
+/// for the first time. A document must not contain any data.
+///
+/// A `snapshot` binary is copied, so it can be released right after this call. Its length must
+/// be passed within a `len` parameter.
+#[no_mangle]
+pub unsafe extern "C" fn ytransaction_load_indexed_snapshot(
+    txn: *mut Transaction,
+    snapshot: *const c_uchar,
+    len: c_int,
+) {
+    assert!(!txn.is_null());
+    assert!(!snapshot.is_null());
+
+    let snapshot = std::slice::from_raw_parts(snapshot as *const u8, len as usize);
+    txn.as_mut()
+        .unwrap()
+        .load_indexed_snapshot(snapshot.to_vec())
+}
+
+/// Opens an update log persisted in a given `dir` directory, creating it if necessary. `dir` must
+/// be a null-terminated UTF-8 encoded path. Returns a null pointer if the log couldn't be opened.
+///
+/// Returned log should be eventually released using [yupdatelog_close] function.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_open(dir: *const c_char) -> *mut UpdateLog {
+    assert!(!dir.is_null());
+
+    let dir = CStr::from_ptr(dir).to_str().unwrap();
+    match UpdateLog::open(dir) {
+        Ok(log) => Box::into_raw(Box::new(log)),
+        Err(_) => std::ptr::null_mut(),
+    }
+}
+
+/// Restores a persisted document state by applying a snapshot and all updates appended after it
+/// within a given transaction. Returns `0` on success or `-1` if log files couldn't be read or
+/// they contain malformed updates.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_load(log: *mut UpdateLog, txn: *mut Transaction) -> c_int {
+    assert!(!log.is_null());
+    assert!(!txn.is_null());
+
+    let log = log.as_mut().unwrap();
+    let txn = txn.as_mut().unwrap();
+    // applying updates may panic, which must not unwind across the FFI boundary
+    match std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| log.load(txn))) {
+        Ok(result) => io_result(result),
+        Err(_) => -1,
+    }
+}
+
+/// Appends a binary `update` of a given length `len` at the end of an update log. Appended updates
+/// are synchronized with a storage device in batches - use [yupdatelog_flush] to make them durable
+/// right away. Once a log grows over a configured threshold, it's compacted in the background.
+///
+/// Returns `0` on success or `-1` if an `update` is malformed (in which case nothing is appended)
+/// or writing to a log has failed.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_append(
+    log: *mut UpdateLog,
+    update: *const c_uchar,
+    len: c_int,
+) -> c_int {
+    assert!(!log.is_null());
+    assert!(!update.is_null());
+
+    let log = log.as_mut().unwrap();
+    let update = std::slice::from_raw_parts(update as *const u8, len as usize);
+    io_result(log.append(update))
+}
+
+/// Appends all changes made so far within a given transaction at the end of an update log.
+/// It should be called right before committing a transaction.
+///
+/// Returns `0` on success or `-1` if writing to a log has failed.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_append_txn(
+    log: *mut UpdateLog,
+    txn: *const Transaction,
+) -> c_int {
+    assert!(!log.is_null());
+    assert!(!txn.is_null());
+
+    let log = log.as_mut().unwrap();
+    let txn = txn.as_ref().unwrap();
+    io_result(log.append_transaction(txn))
+}
+
+/// Writes all appended updates into a log and synchronizes them with a storage device.
+/// Returns `0` on success or `-1` if writing to a log has failed.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_flush(log: *mut UpdateLog) -> c_int {
+    assert!(!log.is_null());
+
+    io_result(log.as_mut().unwrap().flush())
+}
+
+/// Starts compaction of all updates appended so far into a snapshot on a background thread.
+/// New updates can be appended while compaction is running. Returns `0` on success or `-1` if
+/// a compaction couldn't be started or a previous one has failed.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_compact(log: *mut UpdateLog) -> c_int {
+    assert!(!log.is_null());
+
+    io_result(log.as_mut().unwrap().compact())
+}
+
+/// Flushes all appended updates, waits for a background compaction to complete and releases
+/// an update log. Returns `0` on success or `-1` if any of these steps has failed - log is
+/// released in both cases.
+#[no_mangle]
+pub unsafe extern "C" fn yupdatelog_close(log: *mut UpdateLog) -> c_int {
+    if log.is_null() {
+        return 0;
+    }
+    let log = Box::from_raw(log);
+    io_result(log.close())
+}
+
+fn io_result(result: std::io::Result<()>) -> c_int {
+    match result {
+        Ok(_) => 0,
+        Err(_) => -1,
+    }
+}
+
 /// Returns the length of the `YText` string content in bytes (without the null terminator character)
 #[no_mangle]
 pub unsafe extern "C" fn ytext_len(txt: *const Text) -> c_int {
@@ -638,6 +1085,26 @@ pub unsafe extern "C" fn yarray_len(array: *const Array) -> c_int {
     array.len() as c_int
 }
 
+/// Writes a JSON representation of a current `YArray` and all of its nested elements into a given
+/// `write_fn` callback, together with a caller-provided `ctx` pointer. JSON is produced directly
+/// from the array contents, without materializing it as `YOutput` values first.
+///
+/// Returns `0` on success or `-1` if `write_fn` callback returned an error.
+#[no_mangle]
+pub unsafe extern "C" fn yarray_to_json(
+    array: *const Array,
+    txn: *const Transaction,
+    write_fn: YWriteCallback,
+    ctx: *mut c_void,
+) -> c_int {
+    assert!(!array.is_null());
+    assert!(!txn.is_null());
+
+    let array = array.as_ref().unwrap();
+    let txn = txn.as_ref().unwrap();
+    write_buffered(write_fn, ctx, |w| array.write_json(txn, w))
+}
+
 /// Returns a pointer to a `YOutput` value stored at a given `index` of a current `YArray`.
 /// If `index` is outside of the bounds of an array, a null pointer will be returned.
 ///
@@ -707,7 +1174,7 @@ pub unsafe extern "C" fn yarray_insert_range(
 
         if !vec.is_empty() {
             let len = vec.len() as u32;
-            arr.insert_range(txn, j, vec);
+            insert_any_range(arr, txn, j, vec);
             j += len;
         } else {
             let val = ptr.offset(i).read();
@@ -718,6 +1185,61 @@ pub unsafe extern "C" fn yarray_insert_range(
     }
 }
 
+/// Inserts a range of JSON-like `values` into an `array`. Ranges consisting only of numbers of
+/// the same kind are stored in a packed form, which can be later read using
+/// [yarray_get_f64_range].
+fn insert_any_range(arr: &Array, txn: &mut Transaction, index: u32, values: Vec<Any>) {
+    if values.iter().all(|v| matches!(v, Any::Number(_))) {
+        let nums = values
+            .into_iter()
+            .map(|v| if let Any::Number(n) = v { n } else { 0.0 })
+            .collect();
+        arr.insert_f64_range(txn, index, nums);
+    } else if values.iter().all(|v| matches!(v, Any::BigInt(_))) {
+        let nums = values
+            .into_iter()
+            .map(|v| if let Any::BigInt(n) = v { n } else { 0 })
+            .collect();
+        arr.insert_i64_range(txn, index, nums);
+    } else {
+        arr.insert_range(txn, index, values);
+    }
+}
+
+/// Returns a pointer to a contiguous range of floating point numbers, starting at a given `index`
+/// of a current `YArray`, without copying them. Such ranges are created when [yarray_insert_range]
+/// is called with an input consisting only of [Y_JSON_NUM] values. A number of elements readable
+/// from returned pointer is written into `len`. It may be lower than the number of remaining array
+/// elements, since consecutive ranges can be separated by other inserts.
+///
+/// If `index` is outside of the bounds of an array or an element at that index was not stored
+/// as a part of a packed floating point range, a null pointer will be returned.
+///
+/// Returned pointer is borrowed from the document and must not be released. It's valid only until
+/// the next modification of a current document.
+#[no_mangle]
+pub unsafe extern "C" fn yarray_get_f64_range(
+    array: *const Array,
+    txn: *mut Transaction,
+    index: c_int,
+    len: *mut c_int,
+) -> *const f64 {
+    assert!(!array.is_null());
+    assert!(!txn.is_null());
+    assert!(!len.is_null());
+
+    let array = array.as_ref().unwrap();
+    let txn = txn.as_mut().unwrap();
+
+    if let Some(range) = array.get_f64_range(txn, index as u32) {
+        *len = range.len() as c_int;
+        range.as_ptr()
+    } else {
+        *len = 0;
+        std::ptr::null()
+    }
+}
+
 /// Removes a `len` of consecutive range of elements from current `array` instance, starting at
 /// a given `index`. Range determined by `index` and `len` must fit into boundaries of an array,
 /// otherwise it will panic at runtime.
@@ -812,7 +1334,7 @@ pub unsafe extern "C" fn ymap_iter_next(iter: *mut MapIter) -> *mut YMapEntry {
 
     let iter = iter.as_mut().unwrap();
     if let Some((key, value)) = iter.next() {
-        Box::into_raw(Box::new(YMapEntry::new(key.as_str(), value)))
+        Box::into_raw(Box::new(YMapEntry::new(key, value)))
     } else {
         std::ptr::null_mut()
     }
@@ -830,6 +1352,26 @@ pub unsafe extern "C" fn ymap_len(map: *const Map, txn: *const Transaction) -> c
     map.len(txn) as c_int
 }
 
+/// Writes a JSON representation of a current `YMap` and all of its nested values into a given
+/// `write_fn` callback, together with a caller-provided `ctx` pointer. JSON is produced directly
+/// from the map contents, without materializing it as `YOutput` values first.
+///
+/// Returns `0` on success or `-1` if `write_fn` callback returned an error.
+#[no_mangle]
+pub unsafe extern "C" fn ymap_to_json(
+    map: *const Map,
+    txn: *const Transaction,
+    write_fn: YWriteCallback,
+    ctx: *mut c_void,
+) -> c_int {
+    assert!(!map.is_null());
+    assert!(!txn.is_null());
+
+    let map = map.as_ref().unwrap();
+    let txn = txn.as_ref().unwrap();
+    write_buffered(write_fn, ctx, |w| map.write_json(txn, w))
+}
+
 /// Inserts a new entry (specified as `key`-`value` pair) into a current `map`. If entry under such
 /// given `key` already existed, its corresponding value will be replaced.
 ///
@@ -859,6 +1401,46 @@ pub unsafe extern "C" fn ymap_insert(
     map.insert(txn, key, value.read());
 }
 
+/// Parses a `json` text of a given length `len` (in bytes) and inserts it as a new entry under
+/// a given `key` of a current `map`. If entry under such given `key` already existed, its
+/// corresponding value will be replaced.
+///
+/// JSON objects and arrays are inserted as nested `YMap`s and `YArray`s, while other values are
+/// stored as they are. Whole JSON text is parsed at once and integrated within a given
+/// transaction, with consecutive primitive array elements stored together, so it's much faster
+/// than building an equivalent `YInput` tree.
+///
+/// A `key` must be a null-terminated UTF-8 encoded string. Returns `0` on success or `-1` if
+/// `json` was not a valid UTF-8 encoded JSON text, in which case a `map` is left unchanged.
+#[no_mangle]
+pub unsafe extern "C" fn ymap_insert_json(
+    map: *const Map,
+    txn: *mut Transaction,
+    key: *const c_char,
+    json: *const c_char,
+    len: c_int,
+) -> c_int {
+    assert!(!map.is_null());
+    assert!(!txn.is_null());
+    assert!(!key.is_null());
+    assert!(!json.is_null());
+
+    let cstr = CStr::from_ptr(key);
+    let key = cstr.to_str().unwrap().to_string();
+
+    let buf = std::slice::from_raw_parts(json as *const u8, len as usize);
+    let value = match lib0::utf8::from_utf8(buf).map(lib0::json::parse) {
+        Some(Ok(value)) => value,
+        _ => return -1,
+    };
+
+    let map = map.as_ref().unwrap();
+    let txn = txn.as_mut().unwrap();
+
+    map.insert(txn, key, PrelimJson(value));
+    0
+}
+
 /// Removes a `map` entry, given its `key`. Returns `1` if the corresponding entry was successfully
 /// removed or `0` if no entry with a provided `key` has been found inside of a `map`.
 ///
@@ -957,6 +1539,26 @@ pub unsafe extern "C" fn yxmlelem_string(
     CString::new(str).unwrap().into_raw()
 }
 
+/// Works like [yxmlelem_string], but instead of returning an entire string at once, it streams it
+/// in chunks into a given `write_fn` callback, together with a caller-provided `ctx` pointer.
+/// An entire subtree is serialized in a single pass. Written string is not null-terminated.
+///
+/// Returns `0` on success or `-1` if `write_fn` callback returned an error.
+#[no_mangle]
+pub unsafe extern "C" fn yxmlelem_write(
+    xml: *const XmlElement,
+    txn: *const Transaction,
+    write_fn: YWriteCallback,
+    ctx: *mut c_void,
+) -> c_int {
+    assert!(!xml.is_null());
+    assert!(!txn.is_null());
+
+    let xml = xml.as_ref().unwrap();
+    let txn = txn.as_ref().unwrap();
+    write_buffered(write_fn, ctx, |w| xml.write_xml(txn, w))
+}
+
 /// Inserts an XML attribute described using `attr_name` and `attr_value`. If another attribute with
 /// the same name already existed, its value will be replaced with a provided one.
 ///
@@ -1362,6 +1964,45 @@ pub unsafe extern "C" fn yxmlelem_insert_text(
     Box::into_raw(Box::new(child))
 }
 
+/// Parses an `xml_str` fragment of a given length `len` (in bytes) - a sequence of XML elements
+/// and text nodes - and inserts all of its top-level nodes as children of a current node,
+/// starting at the given `index`. Element attributes are inserted as well, while comments,
+/// processing instructions and document type declarations are skipped.
+///
+/// An entire fragment is parsed first and then integrated in a single pass, which is much faster
+/// than building the same subtree using [yxmlelem_insert_elem], [yxmlelem_insert_text] and
+/// [yxmlelem_insert_attr] calls.
+///
+/// An `index` value must be between 0 and (inclusive) length of a current XML element (use
+/// [yxmlelem_child_len] function to determine its length). Returns `0` on success or `-1` if
+/// `xml_str` was not a well-formed UTF-8 encoded XML fragment, in which case current XML element
+/// is left unchanged.
+#[no_mangle]
+pub unsafe extern "C" fn yxmlelem_insert_xml(
+    xml: *const XmlElement,
+    txn: *mut Transaction,
+    index: c_int,
+    xml_str: *const c_char,
+    len: c_int,
+) -> c_int {
+    assert!(!xml.is_null());
+    assert!(!txn.is_null());
+    assert!(!xml_str.is_null());
+
+    let buf = std::slice::from_raw_parts(xml_str as *const u8, len as usize);
+    let str = match lib0::utf8::from_utf8(buf) {
+        Some(str) => str,
+        None => return -1,
+    };
+
+    let xml = xml.as_ref().unwrap();
+    let txn = txn.as_mut().unwrap();
+    match xml.insert_xml(txn, index as u32, str) {
+        Ok(_) => 0,
+        Err(_) => -1,
+    }
+}
+
 /// Removes a consecutive range of child elements (of specified length) from the current
 /// `YXmlElement`, starting at the given `index`. Specified range must fit into boundaries of current
 /// XML node children, otherwise this function will panic at runtime.
@@ -1642,8 +2283,7 @@ impl YInput {
             } else if tag == Y_JSON_BUF {
                 let slice =
                     std::slice::from_raw_parts(self.value.buf as *mut u8, self.len as usize);
-                let buf = Box::from(slice);
-                Any::Buffer(buf)
+                Any::Buffer(Rc::from(slice))
             } else {
                 panic!("Unrecognized YVal value tag.")
             }
@@ -1873,11 +2513,10 @@ impl Drop for YOutput {
             } else if tag == Y_XML_ELEM {
                 drop(Box::from_raw(self.value.y_xmlelem));
             } else if tag == Y_JSON_BUF {
-                drop(Vec::from_raw_parts(
-                    self.value.buf,
-                    self.len as usize,
+                drop(Rc::from_raw(std::ptr::slice_from_raw_parts(
+                    self.value.buf as *const u8,
                     self.len as usize,
-                ));
+                )));
             }
         }
     }
@@ -1938,7 +2577,7 @@ impl From<Any> for YOutput {
                     tag: Y_JSON_BUF,
                     len: v.len() as c_int,
                     value: YOutputContent {
-                        buf: Box::into_raw(v) as *mut _,
+                        buf: Rc::into_raw(v) as *mut _,
                     },
                 },
                 Any::Array(v) => {
@@ -2323,6 +2962,31 @@ pub unsafe extern "C" fn youtput_read_binary(val: *const YOutput) -> *const c_uc
     }
 }
 
+/// Attempts to read the value for a given `YOutput` pointer as a binary payload, writing its
+/// length into `len`. Unlike [youtput_read_binary], returned pointer is borrowed from the document
+/// itself: binary payloads are shared between the document store and `YOutput` cells, so it stays
+/// valid even after `YOutput` has been released using [youtput_destroy], for as long as the
+/// transaction it was read from is alive and the value itself has not been removed.
+///
+/// Returns a null pointer (and sets `len` to 0) in case when a value stored under current `YOutput`
+/// cell is not a binary type.
+#[no_mangle]
+pub unsafe extern "C" fn youtput_read_binary_view(
+    val: *const YOutput,
+    len: *mut c_int,
+) -> *const c_uchar {
+    assert!(!len.is_null());
+
+    let v = val.as_ref().unwrap();
+    if v.tag == Y_JSON_BUF {
+        *len = v.len;
+        v.value.buf
+    } else {
+        *len = 0;
+        std::ptr::null()
+    }
+}
+
 /// Attempts to read the value for a given `YOutput` pointer as a JSON-like array of `YOutput`
 /// values (which length is stored within `len` filed of a cell itself).
 ///
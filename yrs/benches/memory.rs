@@ -0,0 +1,65 @@
+use lib0::any::Any;
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use yrs::*;
+
+/// Global allocator wrapper, which keeps track of a number of currently allocated bytes. Used to
+/// measure a memory footprint of a document. It lives in its own bench target, so that allocation
+/// bookkeeping doesn't skew timings of the other benchmarks.
+struct CountingAlloc;
+
+static ALLOCATED: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATED.fetch_add(layout.size(), Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        ALLOCATED.fetch_sub(layout.size(), Ordering::Relaxed);
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATED.fetch_add(new_size, Ordering::Relaxed);
+        ALLOCATED.fetch_sub(layout.size(), Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAlloc = CountingAlloc;
+
+const ITERATIONS: u32 = 1000000;
+
+/// Builds a document with [ITERATIONS] separate (non-squashable) items and reports a number of
+/// bytes it occupies in memory.
+fn doc_memory_footprint() -> usize {
+    let before = ALLOCATED.load(Ordering::Relaxed);
+    let doc = Doc::new();
+    {
+        let mut tr = doc.transact();
+        let a = tr.get_array("array");
+        let m = tr.get_map("map");
+        for i in 0..(ITERATIONS / 2) {
+            // prepending to an array produces a new item every time
+            a.insert(&mut tr, 0, Any::Number(i as f64));
+            // overriding map entry produces a new item every time
+            m.insert(&mut tr, "key".to_owned(), Any::Number(i as f64));
+        }
+    }
+    let after = ALLOCATED.load(Ordering::Relaxed);
+    drop(doc);
+    after - before
+}
+
+fn main() {
+    let footprint = doc_memory_footprint();
+    println!(
+        "memory footprint of {} items: {} bytes ({} bytes/item)",
+        ITERATIONS,
+        footprint,
+        footprint / ITERATIONS as usize
+    );
+}
@@ -22,7 +22,7 @@ pub fn diff_updates(update: &[u8], state_vector: &[u8]) -> Vec<u8> {
     let cursor = Cursor::new(update);
     let mut decoder = DecoderV1::new(cursor);
     let update = Update::decode(&mut decoder);
-    let mut encoder = EncoderV1::new();
+    let mut encoder = EncoderV1::with_capacity(update.encoded_diff_len(&sv));
     update.encode_diff(&sv, &mut encoder);
     // for delete set, don't decode/encode it - just copy the remaining part from the decoder
     encoder.to_vec()
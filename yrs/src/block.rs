@@ -6,9 +6,11 @@ use crate::updates::decoder::Decoder;
 use crate::updates::encoder::Encoder;
 use crate::*;
 use lib0::any::Any;
+use lib0::encoding::{buf_len, uvar_len};
 use std::collections::HashSet;
 use std::hash::Hash;
 use std::panic;
+use std::rc::Rc;
 
 /// Bit flag used to identify [Block::GC].
 pub const BLOCK_GC_REF_NUMBER: u8 = 0;
@@ -59,6 +61,11 @@ pub const HAS_PARENT_SUB: u8 = 0b00100000;
 ///
 /// [ID] corresponds to a [Lamport timestamp](https://en.wikipedia.org/wiki/Lamport_timestamp) in
 /// terms of its properties and guarantees.
+///
+/// [ID] is packed to a 4-byte alignment, which lets it (and every [BlockPtr], `Option<ID>` and
+/// `Option<BlockPtr>` embedding it) skip the 4 bytes of trailing padding a `u64` would otherwise
+/// enforce. Since it's `Copy`, fields should be read by value rather than by reference.
+#[repr(C, packed(4))]
 #[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
 pub struct ID {
     /// Unique identifier of a client, which inserted corresponding item.
@@ -75,11 +82,16 @@ impl ID {
     pub fn new(client: u64, clock: u32) -> Self {
         ID { client, clock }
     }
+
+    /// Returns a number of bytes required to encode current ID using lib0 v1 encoding.
+    pub(crate) fn encoded_len(&self) -> usize {
+        uvar_len(self.client) + uvar_len(self.clock)
+    }
 }
 
 /// A logical block pointer. It contains a unique block [ID], but also contains a helper metadata
 /// which allows to faster locate block it points to within a block store.
-#[derive(Debug, Clone, Copy, Hash)]
+#[derive(Debug, Clone, Copy)]
 pub struct BlockPtr {
     /// Unique identifier of a corresponding block.
     pub id: ID,
@@ -123,6 +135,13 @@ impl PartialEq for BlockPtr {
     }
 }
 
+impl std::hash::Hash for BlockPtr {
+    fn hash<H: std::hash::Hasher>(&self, state: &mut H) {
+        // must be consistent with equality, which ignores pivot
+        self.id.hash(state)
+    }
+}
+
 /// An enum containing all supported block variants.
 #[derive(Debug, PartialEq, Clone)]
 pub(crate) enum Block {
@@ -227,12 +246,13 @@ impl Block {
 
     pub fn encode_with_offset<E: Encoder>(&self, encoder: &mut E, offset: u32) {
         if let Block::Item(item) = self {
-            let origin = if offset > 0 {
-                Some(ID::new(item.id.client, item.id.clock + offset - 1))
+            let (origin, info) = if offset > 0 {
+                // a sliced block always has its left neighbor as an origin
+                let origin = ID::new(item.id.client, item.id.clock + offset - 1);
+                (Some(origin), item.info() | HAS_ORIGIN)
             } else {
-                item.origin
+                (item.origin, item.info())
             };
-            let info = item.info();
             let cant_copy_parent_info = info & (HAS_ORIGIN | HAS_RIGHT_ORIGIN) == 0;
             encoder.write_info(info);
             if let Some(origin_id) = origin {
@@ -253,10 +273,17 @@ impl Block {
                 }
 
                 if let Some(parent_sub) = item.parent_sub.as_ref() {
-                    encoder.write_string(parent_sub.as_str());
+                    encoder.write_string(parent_sub);
                 }
             }
             item.content.encode_with_offset(encoder, offset);
+        } else {
+            encoder.write_info(if let Block::Skip(_) = self {
+                BLOCK_SKIP_REF_NUMBER
+            } else {
+                BLOCK_GC_REF_NUMBER
+            });
+            encoder.write_len(self.len() - offset);
         }
     }
 
@@ -284,7 +311,7 @@ impl Block {
                     }
 
                     if let Some(parent_sub) = item.parent_sub.as_ref() {
-                        encoder.write_string(parent_sub.as_str());
+                        encoder.write_string(parent_sub);
                     }
                 }
                 item.content.encode(encoder);
@@ -300,6 +327,41 @@ impl Block {
         }
     }
 
+    /// Returns a number of bytes required to encode current block using [Block::encode].
+    pub fn encoded_len(&self) -> usize {
+        self.encoded_len_with_offset(0)
+    }
+
+    /// Returns a number of bytes required to encode current block using
+    /// [Block::encode_with_offset].
+    pub fn encoded_len_with_offset(&self, offset: u32) -> usize {
+        match self {
+            Block::Item(item) => {
+                let mut len = 1; // info flags
+                if offset > 0 {
+                    len += uvar_len(item.id.client) + uvar_len(item.id.clock + offset - 1);
+                } else if let Some(origin) = item.origin.as_ref() {
+                    len += origin.encoded_len();
+                }
+                if let Some(right_origin) = item.right_origin.as_ref() {
+                    len += right_origin.encoded_len();
+                }
+                if offset == 0 && item.info() & (HAS_ORIGIN | HAS_RIGHT_ORIGIN) == 0 {
+                    len += match &item.parent {
+                        TypePtr::Id(ptr) => 1 + ptr.id.encoded_len(),
+                        TypePtr::Named(name) => 1 + buf_len(name.len()),
+                        TypePtr::Unknown => 0,
+                    };
+                    if let Some(parent_sub) = item.parent_sub.as_ref() {
+                        len += buf_len(parent_sub.len());
+                    }
+                }
+                len + item.content.encoded_len_with_offset(offset)
+            }
+            Block::Skip(_) | Block::GC(_) => 1 + uvar_len(self.len() - offset),
+        }
+    }
+
     /// Returns a unique identifier of a current block.
     pub fn id(&self) -> &ID {
         match self {
@@ -452,7 +514,9 @@ pub(crate) struct Item {
 
     /// Used only when current item is used by map-like types. In such case this item works as a
     /// key-value entry of a map, and this field contains a key used by map.
-    pub parent_sub: Option<String>, //TODO: Rc since it's already used in Branch.map component
+    /// It's reference counted, so that items produced by splitting or slicing a map entry share
+    /// the same key allocation with the item they originate from.
+    pub parent_sub: Option<Rc<str>>,
 
     /// Bit flag field which contains information about specifics of this item.
     pub info: u8,
@@ -521,7 +585,7 @@ impl Item {
         right: Option<BlockPtr>,
         right_origin: Option<ID>,
         parent: TypePtr,
-        parent_sub: Option<String>,
+        parent_sub: Option<Rc<str>>,
         content: ItemContent,
     ) -> Self {
         let info = if content.is_countable() {
@@ -632,7 +696,16 @@ impl Item {
                     }
                 }
             }
-            TypePtr::Named(_) => {}
+            TypePtr::Named(name) => {
+                let name = txn.store.interner.intern_rc(name);
+                self.parent = TypePtr::Named(name);
+            }
+        }
+
+        // decoded keys are deduplicated only in a scope of a single update, make them share
+        // allocation with the same keys already used by the document
+        if let Some(parent_sub) = self.parent_sub.as_ref() {
+            self.parent_sub = Some(txn.store.interner.intern_rc(parent_sub));
         }
     }
 
@@ -691,7 +764,7 @@ impl Item {
                 let mut o = if let Some(Block::Item(left)) = left {
                     left.right
                 } else if let Some(sub) = &self.parent_sub {
-                    let mut o = parent_ref.map.get(sub);
+                    let mut o = parent_ref.map.get(sub.as_ref());
                     while let Some(ptr) = o {
                         if let Some(item) = txn.store.blocks.get_item(ptr) {
                             if item.left.is_some() {
@@ -764,7 +837,7 @@ impl Item {
                 }
             } else {
                 let r = if let Some(parent_sub) = &self.parent_sub {
-                    let start = parent_ref.map.get(parent_sub).cloned();
+                    let start = parent_ref.map.get(parent_sub.as_ref()).cloned();
                     let mut r = start.as_ref();
 
                     while let Some(ptr) = r {
@@ -828,10 +901,7 @@ impl Item {
     fn try_reassign_parent_sub(&mut self, block: Option<&Block>) {
         if self.parent_sub.is_none() {
             if let Some(Block::Item(item)) = block {
-                //TODO: make parent_sub Rc<String> and clone from left unconditionally
-                if item.parent_sub.is_some() {
-                    self.parent_sub = item.parent_sub.clone();
-                }
+                self.parent_sub = item.parent_sub.clone();
             }
         }
     }
@@ -960,6 +1030,140 @@ impl Item {
     }
 }
 
+/// A chunk of text used by [ItemContent::String]. It's a view over a reference counted string
+/// buffer, which makes splitting and cloning O(1) operations: both halves of a split block share
+/// the same underlying buffer and only adjust their byte ranges.
+///
+/// Since a view keeps the whole buffer alive, squashing two chunks back together reuses the buffer
+/// whenever possible and allocates a new one only when chunks don't come from the same buffer.
+#[derive(Clone)]
+pub struct SplittableString {
+    buf: Rc<String>,
+    start: u32,
+    end: u32,
+}
+
+impl SplittableString {
+    /// Returns a string slice visible through this view.
+    #[inline]
+    pub fn as_str(&self) -> &str {
+        &self.buf[(self.start as usize)..(self.end as usize)]
+    }
+
+    /// Returns a length of this string in bytes.
+    #[inline]
+    pub fn len(&self) -> usize {
+        (self.end - self.start) as usize
+    }
+
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.start == self.end
+    }
+
+    /// Splits current string at a given byte `offset`, returning the right side of the split.
+    /// Both sides share the same underlying buffer, so no string data is being copied.
+    ///
+    /// Panics if `offset` doesn't lie on the UTF-8 character boundary.
+    pub fn split_off(&mut self, offset: usize) -> SplittableString {
+        assert!(
+            self.as_str().is_char_boundary(offset),
+            "cannot split a string outside of UTF-8 character boundary"
+        );
+        let mid = self.start + offset as u32;
+        let right = SplittableString {
+            buf: self.buf.clone(),
+            start: mid,
+            end: self.end,
+        };
+        self.end = mid;
+        right
+    }
+
+    /// Appends `other` string at the end of a current one. If `other` is a view that directly
+    /// follows current one in the same buffer, only the range is extended. If current view is the
+    /// only owner of its buffer, contents are appended in place. Otherwise a new buffer is allocated.
+    pub fn push(&mut self, other: &SplittableString) {
+        if Rc::ptr_eq(&self.buf, &other.buf) && self.end == other.start {
+            self.end = other.end;
+        } else {
+            self.push_str(other.as_str());
+        }
+    }
+
+    /// Appends a string slice at the end of a current string.
+    pub fn push_str(&mut self, str: &str) {
+        let end = self.end as usize;
+        match Rc::get_mut(&mut self.buf) {
+            Some(buf) if buf.len() == end => buf.push_str(str),
+            _ => {
+                let mut buf = String::with_capacity(self.len() + str.len());
+                buf.push_str(self.as_str());
+                buf.push_str(str);
+                self.buf = Rc::new(buf);
+                self.start = 0;
+            }
+        }
+        self.end = self.buf.len() as u32;
+    }
+}
+
+impl From<String> for SplittableString {
+    fn from(buf: String) -> Self {
+        let end = buf.len() as u32;
+        SplittableString {
+            buf: Rc::new(buf),
+            start: 0,
+            end,
+        }
+    }
+}
+
+impl From<&str> for SplittableString {
+    fn from(str: &str) -> Self {
+        SplittableString::from(str.to_owned())
+    }
+}
+
+impl From<SplittableString> for String {
+    fn from(str: SplittableString) -> Self {
+        if str.start == 0 && str.end as usize == str.buf.len() {
+            Rc::try_unwrap(str.buf).unwrap_or_else(|buf| buf.as_ref().clone())
+        } else {
+            str.as_str().to_owned()
+        }
+    }
+}
+
+impl std::ops::Deref for SplittableString {
+    type Target = str;
+
+    #[inline]
+    fn deref(&self) -> &Self::Target {
+        self.as_str()
+    }
+}
+
+impl PartialEq for SplittableString {
+    fn eq(&self, other: &Self) -> bool {
+        self.as_str() == other.as_str()
+    }
+}
+
+impl Eq for SplittableString {}
+
+impl std::fmt::Debug for SplittableString {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        std::fmt::Debug::fmt(self.as_str(), f)
+    }
+}
+
+impl std::fmt::Display for SplittableString {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.write_str(self.as_str())
+    }
+}
+
 /// An enum describing the type of a user content stored as part of one or more
 /// (if items were squashed) insert operations.
 #[derive(Debug, PartialEq, Clone)]
@@ -967,14 +1171,25 @@ pub enum ItemContent {
     /// Any JSON-like primitive type range.
     Any(Vec<Any>),
 
-    /// A binary data eg. images.
-    Binary(Vec<u8>),
+    /// A binary data eg. images. It's reference counted, so reading it doesn't copy the payload.
+    Binary(Rc<[u8]>),
+
+    /// A packed range of 64-bit floating point numbers. It's semantically equivalent to
+    /// [ItemContent::Any] made of [Any::Number] values, and it's encoded as such, but it keeps
+    /// numbers in a contiguous buffer, which can be read without any conversions.
+    F64Array(Vec<f64>),
+
+    /// A packed range of 64-bit integers. It's semantically equivalent to [ItemContent::Any] made
+    /// of [Any::BigInt] values, and it's encoded as such.
+    I64Array(Vec<i64>),
 
     /// A marker for delete item data, which describes a number of deleted elements.
     /// Deleted elements also don't contribute to an overall length of containing collection type.
     Deleted(u32),
 
-    Doc(String, Any),
+    /// A subdocument reference. Its metadata is boxed, since subdocuments are rare and this
+    /// variant would otherwise dictate the size of every [ItemContent] (and therefore [Item]).
+    Doc(String, Box<Any>),
     JSON(Vec<String>), // String is JSON
     Embed(String),     // String is JSON
 
@@ -983,7 +1198,7 @@ pub enum ItemContent {
     Format(String, String), // key, value: JSON
 
     /// A chunk of text, usually applied by collaborative text insertion.
-    String(String),
+    String(SplittableString),
 
     /// A reference of a branch node. Branch nodes define a complex collection types, such as
     /// arrays, maps or XML elements.
@@ -996,6 +1211,8 @@ impl ItemContent {
     pub fn get_ref_number(&self) -> u8 {
         match self {
             ItemContent::Any(_) => BLOCK_ITEM_ANY_REF_NUMBER,
+            ItemContent::F64Array(_) => BLOCK_ITEM_ANY_REF_NUMBER,
+            ItemContent::I64Array(_) => BLOCK_ITEM_ANY_REF_NUMBER,
             ItemContent::Binary(_) => BLOCK_ITEM_BINARY_REF_NUMBER,
             ItemContent::Deleted(_) => BLOCK_ITEM_DELETED_REF_NUMBER,
             ItemContent::Doc(_, _) => BLOCK_ITEM_DOC_REF_NUMBER,
@@ -1014,6 +1231,8 @@ impl ItemContent {
     pub fn is_countable(&self) -> bool {
         match self {
             ItemContent::Any(_) => true,
+            ItemContent::F64Array(_) => true,
+            ItemContent::I64Array(_) => true,
             ItemContent::Binary(_) => true,
             ItemContent::Doc(_, _) => true,
             ItemContent::JSON(_) => true,
@@ -1044,6 +1263,8 @@ impl ItemContent {
                 str.len() as u32
             }
             ItemContent::Any(v) => v.len() as u32,
+            ItemContent::F64Array(v) => v.len() as u32,
+            ItemContent::I64Array(v) => v.len() as u32,
             ItemContent::JSON(v) => v.len() as u32,
             _ => 1,
         }
@@ -1056,9 +1277,11 @@ impl ItemContent {
     pub fn get_content(&self, txn: &Transaction<'_>) -> Vec<Value> {
         match self {
             ItemContent::Any(v) => v.iter().map(|a| Value::Any(a.clone())).collect(),
-            ItemContent::Binary(v) => vec![Value::Any(Any::Buffer(v.clone().into_boxed_slice()))],
+            ItemContent::F64Array(v) => v.iter().map(|n| Value::Any(Any::Number(*n))).collect(),
+            ItemContent::I64Array(v) => v.iter().map(|n| Value::Any(Any::BigInt(*n))).collect(),
+            ItemContent::Binary(v) => vec![Value::Any(Any::Buffer(v.clone()))],
             ItemContent::Deleted(_) => Vec::default(),
-            ItemContent::Doc(_, v) => vec![Value::Any(v.clone())],
+            ItemContent::Doc(_, v) => vec![Value::Any(v.as_ref().clone())],
             ItemContent::JSON(v) => v
                 .iter()
                 .map(|v| Value::Any(Any::String(v.clone())))
@@ -1080,13 +1303,15 @@ impl ItemContent {
     pub fn get_content_last(&self, txn: &Transaction<'_>) -> Option<Value> {
         match self {
             ItemContent::Any(v) => v.last().map(|a| Value::Any(a.clone())),
-            ItemContent::Binary(v) => Some(Value::Any(Any::Buffer(v.clone().into_boxed_slice()))),
+            ItemContent::F64Array(v) => v.last().map(|n| Value::Any(Any::Number(*n))),
+            ItemContent::I64Array(v) => v.last().map(|n| Value::Any(Any::BigInt(*n))),
+            ItemContent::Binary(v) => Some(Value::Any(Any::Buffer(v.clone()))),
             ItemContent::Deleted(_) => None,
-            ItemContent::Doc(_, v) => Some(Value::Any(v.clone())),
+            ItemContent::Doc(_, v) => Some(Value::Any(v.as_ref().clone())),
             ItemContent::JSON(v) => v.last().map(|v| Value::Any(Any::String(v.clone()))),
             ItemContent::Embed(v) => Some(Value::Any(Any::String(v.clone()))),
             ItemContent::Format(_, _) => None,
-            ItemContent::String(v) => Some(Value::Any(Any::String(v.clone()))),
+            ItemContent::String(v) => Some(Value::Any(Any::String(v.to_string()))),
             ItemContent::Type(c) => Some(c.clone().into_value(txn)),
         }
     }
@@ -1122,6 +1347,18 @@ impl ItemContent {
                     encoder.write_any(&any[i]);
                 }
             }
+            ItemContent::F64Array(nums) => {
+                encoder.write_len(nums.len() as u32 - offset);
+                for n in &nums[(offset as usize)..] {
+                    encoder.write_any(&Any::Number(*n));
+                }
+            }
+            ItemContent::I64Array(nums) => {
+                encoder.write_len(nums.len() as u32 - offset);
+                for n in &nums[(offset as usize)..] {
+                    encoder.write_any(&Any::BigInt(*n));
+                }
+            }
             ItemContent::Doc(key, any) => {
                 encoder.write_string(key.as_str());
                 encoder.write_any(any);
@@ -1160,6 +1397,18 @@ impl ItemContent {
                     encoder.write_any(a);
                 }
             }
+            ItemContent::F64Array(nums) => {
+                encoder.write_len(nums.len() as u32);
+                for n in nums.iter() {
+                    encoder.write_any(&Any::Number(*n));
+                }
+            }
+            ItemContent::I64Array(nums) => {
+                encoder.write_len(nums.len() as u32);
+                for n in nums.iter() {
+                    encoder.write_any(&Any::BigInt(*n));
+                }
+            }
             ItemContent::Doc(key, any) => {
                 encoder.write_string(key.as_str());
                 encoder.write_any(any);
@@ -1167,6 +1416,54 @@ impl ItemContent {
         }
     }
 
+    /// Returns a number of bytes required to encode current content using
+    /// [ItemContent::encode_with_offset].
+    pub fn encoded_len_with_offset(&self, offset: u32) -> usize {
+        let offset = offset as usize;
+        match self {
+            ItemContent::Deleted(len) => uvar_len(*len - offset as u32),
+            ItemContent::Binary(buf) => buf_len(buf.len()),
+            ItemContent::String(s) => buf_len(s.as_str().len() - offset),
+            ItemContent::Embed(s) => buf_len(s.len()),
+            ItemContent::JSON(s) => {
+                let mut len = uvar_len(s.len() - offset);
+                for json in &s[offset..] {
+                    len += buf_len(json.len());
+                }
+                len
+            }
+            ItemContent::Format(k, v) => buf_len(k.len()) + buf_len(v.len()),
+            ItemContent::Type(c) => {
+                let inner = c.borrow();
+                let type_ref = inner.type_ref();
+                if type_ref == types::TYPE_REFS_XML_ELEMENT || type_ref == types::TYPE_REFS_XML_HOOK
+                {
+                    1 + buf_len(inner.name.as_ref().unwrap().len())
+                } else {
+                    1
+                }
+            }
+            ItemContent::Any(any) => {
+                let mut len = uvar_len(any.len() - offset);
+                for a in &any[offset..] {
+                    len += a.encoded_len();
+                }
+                len
+            }
+            ItemContent::F64Array(nums) => {
+                let mut len = uvar_len(nums.len() - offset);
+                for n in &nums[offset..] {
+                    len += Any::Number(*n).encoded_len();
+                }
+                len
+            }
+            ItemContent::I64Array(nums) => {
+                uvar_len(nums.len() - offset) + (nums.len() - offset) * Any::BigInt(0).encoded_len()
+            }
+            ItemContent::Doc(key, any) => buf_len(key.len()) + any.encoded_len(),
+        }
+    }
+
     pub fn decode<D: Decoder>(decoder: &mut D, ref_num: u8, ptr: block::BlockPtr) -> Self {
         match ref_num & 0b1111 {
             BLOCK_ITEM_DELETED_REF_NUMBER => ItemContent::Deleted(decoder.read_len()),
@@ -1179,8 +1476,8 @@ impl ItemContent {
                 }
                 ItemContent::JSON(buf)
             }
-            BLOCK_ITEM_BINARY_REF_NUMBER => ItemContent::Binary(decoder.read_buf().to_owned()),
-            BLOCK_ITEM_STRING_REF_NUMBER => ItemContent::String(decoder.read_string().to_owned()),
+            BLOCK_ITEM_BINARY_REF_NUMBER => ItemContent::Binary(decoder.read_buf().into()),
+            BLOCK_ITEM_STRING_REF_NUMBER => ItemContent::String(decoder.read_string().into()),
             BLOCK_ITEM_EMBED_REF_NUMBER => ItemContent::Embed(decoder.read_string().to_owned()),
             BLOCK_ITEM_FORMAT_REF_NUMBER => ItemContent::Format(
                 decoder.read_string().to_owned(),
@@ -1209,9 +1506,10 @@ impl ItemContent {
                 }
                 ItemContent::Any(values)
             }
-            BLOCK_ITEM_DOC_REF_NUMBER => {
-                ItemContent::Doc(decoder.read_string().to_owned(), decoder.read_any())
-            }
+            BLOCK_ITEM_DOC_REF_NUMBER => ItemContent::Doc(
+                decoder.read_string().to_owned(),
+                Box::new(decoder.read_any()),
+            ),
             info => panic!("ItemContent::decode unrecognized info flag: {}", info),
         }
     }
@@ -1225,10 +1523,16 @@ impl ItemContent {
                 *self = ItemContent::Any(left);
                 Some(ItemContent::Any(right))
             }
+            ItemContent::F64Array(value) => {
+                let right = value.split_off(offset);
+                Some(ItemContent::F64Array(right))
+            }
+            ItemContent::I64Array(value) => {
+                let right = value.split_off(offset);
+                Some(ItemContent::I64Array(right))
+            }
             ItemContent::String(string) => {
-                let (left, right) = string.split_at(offset);
-                let left = left.to_string();
-                let right = right.to_string();
+                let right = string.split_off(offset);
 
                 //TODO: do we need that in Rust?
                 //let split_point = left.chars().last().unwrap();
@@ -1239,8 +1543,6 @@ impl ItemContent {
                 //    left.replace_range((offset-1)..offset, "�");
                 //    right.replace_range(0..1, "�");
                 //}
-                *self = ItemContent::String(left);
-
                 Some(ItemContent::String(right))
             }
             ItemContent::Deleted(len) => {
@@ -1267,6 +1569,14 @@ impl ItemContent {
                 v1.append(&mut v2.clone());
                 true
             }
+            (ItemContent::F64Array(v1), ItemContent::F64Array(v2)) => {
+                v1.extend_from_slice(v2);
+                true
+            }
+            (ItemContent::I64Array(v1), ItemContent::I64Array(v2)) => {
+                v1.extend_from_slice(v2);
+                true
+            }
             (ItemContent::Deleted(v1), ItemContent::Deleted(v2)) => {
                 *v1 = *v1 + *v2;
                 true
@@ -1276,7 +1586,7 @@ impl ItemContent {
                 true
             }
             (ItemContent::String(v1), ItemContent::String(v2)) => {
-                v1.push_str(v2.as_str());
+                v1.push(v2);
                 true
             }
             _ => false,
@@ -1399,6 +1709,8 @@ impl std::fmt::Display for ItemContent {
                 }
                 write!(f, "}}")
             }
+            ItemContent::F64Array(s) => write!(f, "{:?}", s),
+            ItemContent::I64Array(s) => write!(f, "{:?}", s),
             ItemContent::Deleted(s) => write!(f, "deleted({})", s),
             ItemContent::Binary(s) => write!(f, "{:?}", s),
             ItemContent::Type(t) => {
@@ -1484,7 +1796,7 @@ pub struct PrelimText(pub String);
 
 impl Prelim for PrelimText {
     fn into_content(self, _txn: &mut Transaction, _ptr: TypePtr) -> (ItemContent, Option<Self>) {
-        (ItemContent::String(self.0), None)
+        (ItemContent::String(self.0.into()), None)
     }
 
     fn integrate(self, _txn: &mut Transaction, _inner_ref: BranchRef) {}
@@ -1492,7 +1804,8 @@ impl Prelim for PrelimText {
 
 impl std::fmt::Display for ID {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
-        write!(f, "<{}#{}>", self.client, self.clock)
+        let (client, clock) = (self.client, self.clock);
+        write!(f, "<{}#{}>", client, clock)
     }
 }
 
@@ -1514,8 +1827,9 @@ impl std::fmt::Display for Block {
 
 #[cfg(test)]
 mod test {
-    use crate::block::BlockPtr;
+    use crate::block::{Block, BlockPtr, Item, ItemContent, SplittableString};
     use crate::ID;
+    use std::mem::size_of;
 
     #[test]
     fn block_ptr_pivot() {
@@ -1524,4 +1838,36 @@ mod test {
         ptr.fix_pivot(4);
         assert_eq!(ptr.pivot(), 4);
     }
+
+    #[test]
+    fn splittable_string_split_and_squash() {
+        let mut left = SplittableString::from("hello world");
+        let right = left.split_off(5);
+        assert_eq!(left.as_str(), "hello");
+        assert_eq!(right.as_str(), " world");
+
+        // adjacent chunks of the same buffer are merged without copying
+        left.push(&right);
+        assert_eq!(left.as_str(), "hello world");
+
+        let mut a = SplittableString::from("ab");
+        let b = a.split_off(1);
+        a.push(&SplittableString::from("!"));
+        assert_eq!(a.as_str(), "a!");
+        assert_eq!(b.as_str(), "b");
+        assert_eq!(String::from(a), "a!".to_string());
+    }
+
+    #[test]
+    #[cfg(target_pointer_width = "64")]
+    fn block_layout_size() {
+        // guard against accidental regressions of per-block memory footprint
+        assert_eq!(size_of::<ID>(), 12);
+        assert_eq!(size_of::<BlockPtr>(), 16);
+        assert_eq!(size_of::<Option<BlockPtr>>(), 20);
+        assert_eq!(size_of::<Option<ID>>(), 16);
+        assert!(size_of::<ItemContent>() <= 48);
+        assert!(size_of::<Item>() <= 176);
+        assert!(size_of::<Block>() <= 176);
+    }
 }
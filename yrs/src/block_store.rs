@@ -4,11 +4,14 @@ use crate::updates::decoder::{Decode, Decoder};
 use crate::updates::encoder::{Encode, Encoder};
 use crate::utils::client_hasher::ClientHasher;
 use crate::*;
+use lib0::encoding::uvar_len;
 use std::cell::UnsafeCell;
 use std::collections::hash_map::Entry;
 use std::collections::HashMap;
 use std::hash::BuildHasherDefault;
+use std::iter::once;
 use std::ops::Index;
+use std::rc::Rc;
 use std::vec::Vec;
 
 /// State vector is a compact representation of all known blocks inserted and integrated into
@@ -46,7 +49,7 @@ impl StateVector {
     /// can be found in a state vectors don't need to be encoded as part of an update, because they
     /// were already observed by their remote peer, current state vector refers to.
     pub fn contains(&self, id: &ID) -> bool {
-        id.clock <= self.get(&id.client)
+        id.clock <= self.get(&{ id.client })
     }
 
     /// Get the latest clock sequence number value for a given `client_id` as observed from
@@ -112,12 +115,11 @@ impl Decode for StateVector {
     fn decode<D: Decoder>(decoder: &mut D) -> Self {
         let len = decoder.read_uvar::<u32>() as usize;
         let mut sv = HashMap::with_capacity_and_hasher(len, BuildHasherDefault::default());
-        let mut i = 0;
-        while i < len {
-            let client = decoder.read_uvar();
-            let clock = decoder.read_uvar();
-            sv.insert(client, clock);
-            i += 1;
+        // client-clock pairs are decoded all at once
+        let mut values: Vec<u64> = Vec::with_capacity(len * 2);
+        decoder.read_uvar_into(len * 2, &mut values);
+        for pair in values.chunks_exact(2) {
+            sv.insert(pair[0], pair[1] as u32);
         }
         StateVector(sv)
     }
@@ -126,10 +128,18 @@ impl Decode for StateVector {
 impl Encode for StateVector {
     fn encode<E: Encoder>(&self, encoder: &mut E) {
         encoder.write_uvar(self.len());
+        let values = self
+            .iter()
+            .flat_map(|(&client, &clock)| once(client).chain(once(clock as u64)));
+        encoder.write_uvar_iter(self.len() * 2, values);
+    }
+
+    fn encoded_len(&self) -> usize {
+        let mut len = uvar_len(self.len());
         for (&client, &clock) in self.iter() {
-            encoder.write_uvar(client);
-            encoder.write_uvar(clock);
+            len += uvar_len(client) + uvar_len(clock);
         }
+        len
     }
 }
 
@@ -315,12 +325,19 @@ impl ClientBlockList {
     /// squashed into its left neighbor. In such case a squash result will be returned in order to
     /// later on rewire left/right neighbor changes that may have occurred as a result of squashing
     /// and block removal.
-    pub(crate) fn squash_left(&mut self, index: usize) -> Option<SquashResult> {
+    ///
+    /// If `items_only` is set, GC and skip blocks are left untouched. This is used while some root
+    /// types of an indexed snapshot were not loaded yet, since their blocks are represented by such
+    /// placeholders until then and are looked up by their IDs.
+    pub(crate) fn squash_left(&mut self, index: usize, items_only: bool) -> Option<SquashResult> {
         let replacement = {
             let (l, r) = self.list.split_at_mut(index);
             let left = unsafe { &mut *l[index - 1].get() };
             let right = unsafe { &*r[0].get() };
-            if left.is_deleted() == right.is_deleted() && left.same_type(right) {
+            if left.is_deleted() == right.is_deleted()
+                && left.same_type(right)
+                && (!items_only || left.is_item())
+            {
                 if left.try_squash(right) {
                     let new_ptr = BlockPtr::new(left.id().clone(), index as u32 - 1);
                     Some(new_ptr)
@@ -354,7 +371,7 @@ impl ClientBlockList {
 #[derive(Debug)]
 pub(crate) struct SquashResult {
     pub parent: TypePtr,
-    pub parent_sub: Option<String>,
+    pub parent_sub: Option<Rc<str>>,
     /// Pointer to a block that resulted from compaction of two adjacent blocks.
     pub replacement: BlockPtr,
     /// Pointer to a neighbor, that's now on the right side of the `replacement` block.
@@ -459,7 +476,7 @@ impl BlockStore {
     /// Returns immutable reference to a block, given its pointer. Returns `None` if not such
     /// block could be found.
     pub(crate) fn get_block(&self, ptr: &block::BlockPtr) -> Option<&block::Block> {
-        let clients = self.clients.get(&ptr.id.client)?;
+        let clients = self.clients.get(&{ ptr.id.client })?;
         if let Some(block) = clients.try_get(ptr.pivot()) {
             if block.contains(&ptr.id) {
                 return Some(&*block);
@@ -474,7 +491,7 @@ impl BlockStore {
     /// Returns immutable reference to a block, given its pointer. Returns `None` if not such
     /// block could be found.
     pub(crate) fn get_block_mut(&self, ptr: &block::BlockPtr) -> Option<&mut block::Block> {
-        let clients = self.clients.get(&ptr.id.client)?;
+        let clients = self.clients.get(&{ ptr.id.client })?;
         if let Some(block) = clients.try_get_mut(ptr.pivot()) {
             if block.contains(&ptr.id) {
                 return Some(&mut *block);
@@ -533,7 +550,7 @@ impl BlockStore {
     /// If no block for given `ptr` was found, then both returned options will be None.
     pub fn split_block(&mut self, ptr: &BlockPtr) -> (Option<BlockPtr>, Option<BlockPtr>) {
         let mut pivot = ptr.pivot();
-        if let Some(mut blocks) = self.clients.get_mut(&ptr.id.client) {
+        if let Some(mut blocks) = self.clients.get_mut(&{ ptr.id.client }) {
             let block: &mut Block = {
                 let found = blocks.try_get_mut(pivot).and_then(|b| {
                     if ptr.id.clock >= b.id().clock && ptr.id.clock < b.clock_end() {
@@ -569,7 +586,7 @@ impl BlockStore {
                             blocks = if right_ptr.id.client == ptr.id.client {
                                 blocks
                             } else {
-                                self.clients.get_mut(&right_ptr.id.client).unwrap()
+                                self.clients.get_mut(&{ right_ptr.id.client }).unwrap()
                             };
                             let right = blocks.find(&right_ptr).unwrap();
                             if let Some(right_item) = right.as_item_mut() {
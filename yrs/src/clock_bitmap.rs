@@ -0,0 +1,300 @@
+use std::ops::Range;
+
+/// Number of lower bits of a clock value, which are stored within a single container.
+const CONTAINER_BITS: u32 = 16;
+
+/// Number of clock values covered by a single container.
+const CONTAINER_SIZE: usize = 1 << CONTAINER_BITS;
+
+/// Number of 64-bit words used by a bitmap container.
+const BITMAP_WORDS: usize = CONTAINER_SIZE / 64;
+
+/// Maximum number of runs kept by a container. Every run takes 4 bytes, so past that point
+/// a bitmap container (taking 8KiB) becomes more compact.
+const MAX_RUNS: usize = BITMAP_WORDS * 2;
+
+/// A compressed bitmap of clock values, modelled after roaring bitmaps. Clock space is split into
+/// containers of 2^16 values, each of which is stored either as a sorted list of runs (when its
+/// values are clustered together) or as a plain bitmap (when they are densely fragmented).
+///
+/// It's used by [IdRange] to represent clock spaces, which are too fragmented to be efficiently
+/// stored as a list of ranges: it offers logarithmic lookups and fast unions, while taking less
+/// memory.
+///
+/// [IdRange]: crate::id_set::IdRange
+#[derive(Debug, Clone, Default)]
+pub struct ClockBitmap {
+    /// Containers ordered by their keys, which are the upper bits of clock values they contain.
+    containers: Vec<(u16, Container)>,
+}
+
+#[derive(Debug, Clone)]
+enum Container {
+    /// Sorted, disjoint and non-adjacent runs of values, given as inclusive `(first, last)`
+    /// pairs of their lower bits.
+    Runs(Vec<(u16, u16)>),
+    /// A single bit for every value of a container.
+    Bitmap(Box<[u64; BITMAP_WORDS]>),
+}
+
+impl ClockBitmap {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Creates a new bitmap containing all clock values of given `ranges`.
+    pub fn from_ranges<'a, I>(ranges: I) -> Self
+    where
+        I: IntoIterator<Item = &'a Range<u32>>,
+    {
+        let mut bitmap = Self::new();
+        for range in ranges {
+            bitmap.insert(range.clone());
+        }
+        bitmap
+    }
+
+    /// Checks if current bitmap doesn't contain any clock values.
+    pub fn is_empty(&self) -> bool {
+        self.containers.is_empty()
+    }
+
+    /// Checks if a given `clock` value is included in current bitmap.
+    pub fn contains(&self, clock: u32) -> bool {
+        let key = (clock >> CONTAINER_BITS) as u16;
+        match self.containers.binary_search_by_key(&key, |(k, _)| *k) {
+            Ok(i) => self.containers[i].1.contains(clock as u16),
+            Err(_) => false,
+        }
+    }
+
+    /// Inserts all clock values of a given `range` into current bitmap.
+    pub fn insert(&mut self, range: Range<u32>) {
+        if range.start >= range.end {
+            return;
+        }
+        let first_key = range.start >> CONTAINER_BITS;
+        let last_key = (range.end - 1) >> CONTAINER_BITS;
+        for key in first_key..=last_key {
+            let first = if key == first_key {
+                range.start as u16
+            } else {
+                0
+            };
+            let last = if key == last_key {
+                (range.end - 1) as u16
+            } else {
+                u16::MAX
+            };
+            self.container_mut(key as u16).insert(first, last);
+        }
+    }
+
+    /// Merges all clock values of `other` bitmap into current one.
+    pub fn union(&mut self, other: &ClockBitmap) {
+        for (key, container) in other.containers.iter() {
+            self.container_mut(*key).union(container);
+        }
+    }
+
+    /// Returns all clock values of current bitmap as a sorted list of disjoint ranges.
+    pub fn to_ranges(&self) -> Vec<Range<u32>> {
+        let mut ranges = Vec::new();
+        for (key, container) in self.containers.iter() {
+            container.push_ranges((*key as u32) << CONTAINER_BITS, &mut ranges);
+        }
+        ranges
+    }
+
+    fn container_mut(&mut self, key: u16) -> &mut Container {
+        let i = match self.containers.binary_search_by_key(&key, |(k, _)| *k) {
+            Ok(i) => i,
+            Err(i) => {
+                self.containers
+                    .insert(i, (key, Container::Runs(Vec::new())));
+                i
+            }
+        };
+        &mut self.containers[i].1
+    }
+}
+
+impl Container {
+    fn contains(&self, value: u16) -> bool {
+        match self {
+            Container::Runs(runs) => match runs.binary_search_by_key(&value, |(first, _)| *first) {
+                Ok(_) => true,
+                Err(0) => false,
+                Err(i) => runs[i - 1].1 >= value,
+            },
+            Container::Bitmap(words) => words[value as usize >> 6] & (1 << (value & 63)) != 0,
+        }
+    }
+
+    /// Inserts all values from `first` up to `last` (inclusive).
+    fn insert(&mut self, first: u16, last: u16) {
+        match self {
+            Container::Runs(runs) => {
+                let (mut first, mut last) = (first as u32, last as u32);
+                // runs overlapping or adjacent to an inserted one are merged together with it
+                let i = runs.partition_point(|&(_, l)| (l as u32) + 1 < first);
+                let j = runs.partition_point(|&(f, _)| (f as u32) <= last + 1);
+                if i < j {
+                    first = first.min(runs[i].0 as u32);
+                    last = last.max(runs[j - 1].1 as u32);
+                }
+                runs.splice(i..j, std::iter::once((first as u16, last as u16)));
+                self.optimize();
+            }
+            Container::Bitmap(words) => set_bits(words, first, last),
+        }
+    }
+
+    fn union(&mut self, other: &Container) {
+        match (&mut *self, other) {
+            (Container::Bitmap(words), Container::Bitmap(other)) => {
+                for (w, o) in words.iter_mut().zip(other.iter()) {
+                    *w |= *o;
+                }
+            }
+            (Container::Bitmap(words), Container::Runs(runs)) => {
+                for &(first, last) in runs.iter() {
+                    set_bits(words, first, last);
+                }
+            }
+            (Container::Runs(runs), Container::Bitmap(other)) => {
+                let mut words = other.clone();
+                for &(first, last) in runs.iter() {
+                    set_bits(&mut words, first, last);
+                }
+                *self = Container::Bitmap(words);
+            }
+            (Container::Runs(runs), Container::Runs(other)) => {
+                let mut merged: Vec<(u16, u16)> = Vec::with_capacity(runs.len() + other.len());
+                let (mut i, mut j) = (0, 0);
+                while i < runs.len() || j < other.len() {
+                    let next = if j == other.len() || (i < runs.len() && runs[i].0 <= other[j].0) {
+                        i += 1;
+                        runs[i - 1]
+                    } else {
+                        j += 1;
+                        other[j - 1]
+                    };
+                    match merged.last_mut() {
+                        Some(last) if last.1 as u32 + 1 >= next.0 as u32 => {
+                            last.1 = last.1.max(next.1)
+                        }
+                        _ => merged.push(next),
+                    }
+                }
+                *runs = merged;
+                self.optimize();
+            }
+        }
+    }
+
+    /// Converts a runs container into a bitmap one, once it's going to take less memory.
+    fn optimize(&mut self) {
+        if let Container::Runs(runs) = self {
+            if runs.len() > MAX_RUNS {
+                let mut words = Box::new([0u64; BITMAP_WORDS]);
+                for &(first, last) in runs.iter() {
+                    set_bits(&mut words, first, last);
+                }
+                *self = Container::Bitmap(words);
+            }
+        }
+    }
+
+    /// Appends values of current container, offset by a given `base`, to a sorted list of
+    /// `ranges`, merging them with the last range if they are adjacent.
+    fn push_ranges(&self, base: u32, ranges: &mut Vec<Range<u32>>) {
+        match self {
+            Container::Runs(runs) => {
+                for &(first, last) in runs.iter() {
+                    push_range(ranges, base + first as u32..base + last as u32 + 1);
+                }
+            }
+            Container::Bitmap(words) => {
+                let mut i = 0;
+                while i < CONTAINER_SIZE {
+                    // find the next set bit...
+                    let w = i >> 6;
+                    let word = words[w] & (!0u64 << (i & 63));
+                    if word == 0 {
+                        i = (w + 1) << 6;
+                        continue;
+                    }
+                    let start = (w << 6) + word.trailing_zeros() as usize;
+                    // ...and the next unset one after it
+                    let mut end = start;
+                    while end < CONTAINER_SIZE {
+                        let w = end >> 6;
+                        let word = !words[w] & (!0u64 << (end & 63));
+                        if word == 0 {
+                            end = (w + 1) << 6;
+                        } else {
+                            end = (w << 6) + word.trailing_zeros() as usize;
+                            break;
+                        }
+                    }
+                    push_range(ranges, base + start as u32..base + end as u32);
+                    i = end;
+                }
+            }
+        }
+    }
+}
+
+/// Sets all bits from `first` up to `last` (inclusive).
+fn set_bits(words: &mut [u64; BITMAP_WORDS], first: u16, last: u16) {
+    let (first, last) = (first as usize, last as usize);
+    let (fw, lw) = (first >> 6, last >> 6);
+    let first_mask = !0u64 << (first & 63);
+    let last_mask = !0u64 >> (63 - (last & 63));
+    if fw == lw {
+        words[fw] |= first_mask & last_mask;
+    } else {
+        words[fw] |= first_mask;
+        for w in words[fw + 1..lw].iter_mut() {
+            *w = !0;
+        }
+        words[lw] |= last_mask;
+    }
+}
+
+fn push_range(ranges: &mut Vec<Range<u32>>, range: Range<u32>) {
+    match ranges.last_mut() {
+        Some(last) if last.end == range.start => last.end = range.end,
+        _ => ranges.push(range),
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::clock_bitmap::{ClockBitmap, Container};
+
+    #[test]
+    fn clock_bitmap_containers() {
+        // every other clock value, crossing a container boundary
+        let ranges: Vec<_> = (0..33_000u32).map(|i| i * 2..i * 2 + 1).collect();
+        let mut bitmap = ClockBitmap::from_ranges(ranges.iter());
+        assert_eq!(bitmap.containers.len(), 2);
+        assert!(matches!(bitmap.containers[0].1, Container::Bitmap(_)));
+        assert!(matches!(bitmap.containers[1].1, Container::Runs(_)));
+        assert!(bitmap.contains(65_534));
+        assert!(!bitmap.contains(65_535));
+        assert!(bitmap.contains(65_536));
+        assert!(!bitmap.contains(65_999));
+        assert_eq!(bitmap.to_ranges(), ranges);
+
+        // filling the holes merges values into continuous ranges
+        let mut holes = ClockBitmap::new();
+        holes.insert(1..2);
+        holes.insert(65_531..70_000);
+        bitmap.union(&holes);
+        let ranges = bitmap.to_ranges();
+        assert_eq!(&ranges[..2], &[0..3, 4..5]);
+        assert_eq!(ranges.last(), Some(&(65_530..70_000)));
+    }
+}
@@ -0,0 +1,159 @@
+use crate::block_store::StateVector;
+use crate::utils::client_hasher::ClientHasher;
+use std::collections::HashMap;
+use std::hash::BuildHasherDefault;
+
+/// Maximum number of diffs kept in a [DiffCache] at once.
+const CAPACITY: usize = 32;
+
+/// Maximum total size (in bytes) of all diffs kept in a [DiffCache] at once.
+const MAX_BYTES: usize = 8 * 1024 * 1024;
+
+/// Diffs bigger than this size (in bytes) are never cached, so that a single large document
+/// doesn't keep evicting all other entries.
+const MAX_DIFF_BYTES: usize = MAX_BYTES / 8;
+
+/// A cache of document diffs encoded using lib0 v1 encoding, keyed by a hash of a remote state
+/// vector they were computed for. It's meant for servers and relays, which often receive
+/// sync requests from many peers being in the same state.
+///
+/// Cached diffs are valid only as long as a document doesn't change. Since blocks are never
+/// removed from a block store, any new block increases a sum of all clocks of a store, while
+/// deletions of already existing blocks are tracked by a separate delete version counter.
+/// Once any of these two change, an entire cache is cleared.
+///
+/// Cache is bounded both by a number of entries and their total size. Once any of these limits
+/// would be exceeded, all entries are dropped.
+pub(crate) struct DiffCache {
+    /// A sum of all clocks of a block store, cached diffs were computed for.
+    clock: u64,
+    /// A delete version of a store, cached diffs were computed for.
+    delete_version: u64,
+    /// Total size of all cached diffs.
+    size: usize,
+    entries: HashMap<u64, (StateVector, Box<[u8]>), BuildHasherDefault<ClientHasher>>,
+}
+
+impl DiffCache {
+    pub fn new() -> Self {
+        DiffCache {
+            clock: 0,
+            delete_version: 0,
+            size: 0,
+            entries: HashMap::default(),
+        }
+    }
+
+    /// Returns a copy of a diff cached for a given `remote_sv`, as long as it's still valid
+    /// for a store at a given `clock` and `delete_version`.
+    pub fn get(
+        &mut self,
+        clock: u64,
+        delete_version: u64,
+        remote_sv: &StateVector,
+    ) -> Option<Vec<u8>> {
+        if self.clock != clock || self.delete_version != delete_version {
+            self.clear();
+            self.clock = clock;
+            self.delete_version = delete_version;
+            return None;
+        }
+        match self.entries.get(&Self::hash(remote_sv)) {
+            Some((sv, diff)) if sv == remote_sv => Some(diff.to_vec()),
+            _ => None,
+        }
+    }
+
+    /// Caches a `diff` computed for a given `remote_sv`. It must be called right after
+    /// [DiffCache::get], while a store is still in the same state.
+    pub fn insert(&mut self, remote_sv: &StateVector, diff: &[u8]) {
+        if diff.len() > MAX_DIFF_BYTES {
+            return;
+        }
+        if self.entries.len() >= CAPACITY || self.size + diff.len() > MAX_BYTES {
+            self.clear();
+        }
+        let hash = Self::hash(remote_sv);
+        if let Some((_, old)) = self.entries.insert(hash, (remote_sv.clone(), diff.into())) {
+            self.size -= old.len();
+        }
+        self.size += diff.len();
+    }
+
+    fn clear(&mut self) {
+        self.entries.clear();
+        self.size = 0;
+    }
+
+    /// Returns a hash of a given state vector, which doesn't depend on an order of its entries.
+    fn hash(sv: &StateVector) -> u64 {
+        let mut hash = 0u64;
+        for (&client, &clock) in sv.iter() {
+            // a single round of a splitmix64 finalizer, so that entries don't cancel each other
+            let mut h = client ^ (clock as u64).rotate_left(32);
+            h = (h ^ (h >> 30)).wrapping_mul(0xbf58476d1ce4e5b9);
+            h = (h ^ (h >> 27)).wrapping_mul(0x94d049bb133111eb);
+            hash = hash.wrapping_add(h ^ (h >> 31));
+        }
+        hash
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::MAX_DIFF_BYTES;
+    use crate::Doc;
+    use crate::StateVector;
+
+    #[test]
+    fn diff_cache_invalidation() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let txt = txn.get_text("text");
+        txt.insert(&mut txn, 0, "hello world");
+
+        let sv = StateVector::default();
+        let diff = txn.encode_diff_v1(&sv);
+        assert_eq!(txn.store.diff_cache.borrow().entries.len(), 1);
+        assert_eq!(txn.encode_diff_v1(&sv), diff);
+        assert_eq!(txn.store.diff_cache.borrow().entries.len(), 1);
+
+        // deletion doesn't change the clock, but it must invalidate cached diffs
+        txt.remove_range(&mut txn, 0, 6);
+        let diff = txn.encode_diff_v1(&sv);
+        let remote = Doc::new();
+        let mut remote_txn = remote.transact();
+        remote.apply_update_v1(&mut remote_txn, &diff);
+        assert_eq!(remote_txn.get_text("text").to_string(&remote_txn), "world");
+
+        // so does an insertion
+        txt.insert(&mut txn, 5, "!");
+        let diff = txn.encode_diff_v1(&remote_txn.state_vector());
+        remote.apply_update_v1(&mut remote_txn, &diff);
+        assert_eq!(remote_txn.get_text("text").to_string(&remote_txn), "world!");
+    }
+
+    #[test]
+    fn diff_cache_size_limit() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let txt = txn.get_text("text");
+        txt.insert(&mut txn, 0, &"a".repeat(MAX_DIFF_BYTES));
+
+        // diffs exceeding a size limit are not cached
+        let sv = StateVector::default();
+        let diff = txn.encode_diff_v1(&sv);
+        assert!(diff.len() > MAX_DIFF_BYTES);
+        assert_eq!(txn.store.diff_cache.borrow().entries.len(), 0);
+        assert_eq!(txn.encode_diff_v1(&sv), diff);
+
+        // smaller diffs are still cached
+        txt.insert(&mut txn, MAX_DIFF_BYTES as u32, "!");
+        let mut sv = StateVector::default();
+        sv.set_max(1, MAX_DIFF_BYTES as u32);
+        let diff = txn.encode_diff_v1(&sv);
+        let cache = txn.store.diff_cache.borrow();
+        assert_eq!(cache.entries.len(), 1);
+        assert_eq!(cache.size, diff.len());
+    }
+}
@@ -1,10 +1,10 @@
 use crate::block_store::StateVector;
-use crate::event::{Subscription, UpdateEvent};
+use crate::event::{AfterTransactionEvent, Subscription, UpdateEvent};
 use crate::store::Store;
 use crate::transaction::Transaction;
 use crate::update::Update;
 use crate::updates::decoder::{Decode, DecoderV1};
-use crate::updates::encoder::{Encode, Encoder, EncoderV1};
+use crate::updates::encoder::Encode;
 use rand::Rng;
 use std::cell::RefCell;
 
@@ -68,6 +68,28 @@ impl Doc {
         txn.store.encode_v1()
     }
 
+    /// Encode entire state of a current block store using ver. 1 encoding, writing it directly
+    /// into a given `writer` (ie. a file or a socket) as it goes, instead of building the whole
+    /// update in memory first. See: [Self::encode_state_as_update_v1].
+    pub fn encode_state_as_update_v1_to<W: std::io::Write>(
+        &self,
+        txn: &Transaction<'_>,
+        writer: W,
+    ) -> std::io::Result<W> {
+        self.encode_delta_as_update_v1_to(txn, &StateVector::default(), writer)
+    }
+
+    /// Encodes a difference between current block store and a remote one based on its state
+    /// vector, writing it directly into a given `writer`. See: [Self::encode_delta_as_update_v1].
+    pub fn encode_delta_as_update_v1_to<W: std::io::Write>(
+        &self,
+        txn: &Transaction<'_>,
+        remote_sv: &StateVector,
+        writer: W,
+    ) -> std::io::Result<W> {
+        txn.store.encode_diff_to(remote_sv, writer)
+    }
+
     /// Encode state vector of a current block store using ver. 1 encoding.
     pub fn encode_state_vector_v1(&self, txn: &Transaction<'_>) -> Vec<u8> {
         txn.store.blocks.get_state_vector().encode_v1()
@@ -76,9 +98,7 @@ impl Doc {
     /// Encodes a difference between current block store and a remote one based on its state vector.
     /// Such update contains only blocks not observed by a remote peer together with a delete set.
     pub fn encode_delta_as_update_v1(&self, txn: &Transaction, remote_sv: &StateVector) -> Vec<u8> {
-        let mut encoder = EncoderV1::new();
-        txn.store.encode_diff(remote_sv, &mut encoder);
-        encoder.to_vec()
+        txn.store.encode_diff_v1(remote_sv)
     }
 
     /// Creates a transaction used for all kind of block store operations.
@@ -110,6 +130,18 @@ impl Doc {
         let mut store = self.store.borrow_mut();
         store.update_events.subscribe(f)
     }
+
+    /// Subscribe callback function called once a transaction, which made any changes to
+    /// a document, has been committed. Callback receives an update containing only the changes
+    /// made by that transaction. Returns a subscription, which will unsubscribe function when
+    /// dropped.
+    pub fn on_after_transaction<F>(&mut self, f: F) -> Subscription<AfterTransactionEvent>
+    where
+        F: Fn(&AfterTransactionEvent) -> () + 'static,
+    {
+        let mut store = self.store.borrow_mut();
+        store.after_transaction_events.subscribe(f)
+    }
 }
 
 impl Default for Doc {
@@ -120,11 +152,16 @@ impl Default for Doc {
 
 #[cfg(test)]
 mod test {
+    use crate::types::map::PrelimMap;
     use crate::update::Update;
     use crate::updates::decoder::Decode;
     use crate::updates::encoder::{Encode, Encoder, EncoderV1};
     use crate::{Doc, StateVector};
-    use std::cell::Cell;
+    use lib0::any::Any;
+    use rand::prelude::StdRng;
+    use rand::{Rng, SeedableRng};
+    use std::cell::{Cell, RefCell};
+    use std::collections::HashMap;
     use std::rc::Rc;
 
     #[test]
@@ -207,6 +244,31 @@ mod test {
         assert_eq!(txt.to_string(&t2), "hello world".to_string());
     }
 
+    #[test]
+    fn apply_many_deletes_within_single_block() {
+        let d1 = Doc::with_client_id(1);
+        let d2 = Doc::with_client_id(2);
+        {
+            let mut t1 = d1.transact();
+            t1.get_text("text").insert(&mut t1, 0, "abcdefghij");
+            let mut t2 = d2.transact();
+            d2.apply_update_v1(&mut t2, &d1.encode_state_as_update_v1(&t1));
+        }
+
+        // at B the whole text is still a single block, which must be split at each deleted range
+        let mut t1 = d1.transact();
+        let txt = t1.get_text("text");
+        txt.remove_range(&mut t1, 8, 1);
+        txt.remove_range(&mut t1, 4, 2);
+        txt.remove_range(&mut t1, 1, 1);
+        assert_eq!(txt.to_string(&t1), "acdghj");
+
+        let mut t2 = d2.transact();
+        let sv = d2.get_state_vector(&t2);
+        d2.apply_update_v1(&mut t2, &d1.encode_delta_as_update_v1(&t1, &sv));
+        assert_eq!(t2.get_text("text").to_string(&t2), "acdghj");
+    }
+
     #[test]
     fn on_update() {
         let counter = Rc::new(Cell::new(0));
@@ -234,4 +296,282 @@ mod test {
         doc2.apply_update_v1(&mut txn2, u.as_slice());
         assert_eq!(counter.get(), 3); // since subscription has been dropped, update was not propagated
     }
+
+    #[test]
+    fn on_after_transaction() {
+        let updates = Rc::new(RefCell::new(Vec::new()));
+        let mut d1 = Doc::with_client_id(1);
+        let u = updates.clone();
+        let sub = d1.on_after_transaction(move |e| u.borrow_mut().push(e.update.clone()));
+
+        {
+            let mut txn = d1.transact();
+            txn.get_text("text").insert(&mut txn, 0, "hello");
+        }
+        {
+            // appended block is squashed with a block inserted by a previous transaction
+            let mut txn = d1.transact();
+            let txt = txn.get_text("text");
+            txt.insert(&mut txn, 5, " world");
+            txt.remove_range(&mut txn, 0, 1);
+            txn.commit();
+            txt.insert(&mut txn, 0, "H");
+        }
+        {
+            // transactions without changes don't produce updates
+            let mut txn = d1.transact();
+            txn.get_text("text");
+        }
+        assert_eq!(updates.borrow().len(), 3);
+
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        for update in updates.borrow().iter() {
+            d2.apply_update_v1(&mut t2, update);
+            assert!(t2.store.pending.is_none());
+        }
+        assert_eq!(t2.get_text("text").to_string(&t2), "Hello world");
+
+        drop(sub);
+        {
+            let mut txn = d1.transact();
+            txn.get_text("text").insert(&mut txn, 0, "!");
+        }
+        assert_eq!(updates.borrow().len(), 3);
+    }
+
+    #[test]
+    fn encode_update_after_commit() {
+        let d1 = Doc::with_client_id(1);
+        let d2 = Doc::with_client_id(2);
+        {
+            let mut txn = d1.transact();
+            txn.get_text("text").insert(&mut txn, 0, "hello");
+            let mut t2 = d2.transact();
+            d2.apply_update_v1(&mut t2, &txn.encode_update_v1());
+        }
+        let mut txn = d1.transact();
+        let txt = txn.get_text("text");
+        txt.insert(&mut txn, 5, " world");
+        txn.commit();
+        txt.insert(&mut txn, 0, "H");
+        txt.remove_range(&mut txn, 1, 1);
+
+        // update contains changes made both before and after an intermediate commit
+        let update = txn.encode_update_v1();
+        let mut t2 = d2.transact();
+        d2.apply_update_v1(&mut t2, &update);
+        assert!(t2.store.pending.is_none());
+        assert_eq!(t2.get_text("text").to_string(&t2), "Hello world");
+    }
+
+    #[test]
+    fn on_after_transaction_random_edits() {
+        let updates = Rc::new(RefCell::new(Vec::new()));
+        let mut d1 = Doc::with_client_id(1);
+        let u = updates.clone();
+        let _sub = d1.on_after_transaction(move |e| u.borrow_mut().push(e.update.clone()));
+        let d2 = Doc::with_client_id(2);
+
+        let mut rng = StdRng::seed_from_u64(47);
+        for _ in 0..200 {
+            {
+                let mut txn = d1.transact();
+                let txt = txn.get_text("text");
+                for _ in 0..rng.gen_range(1, 5) {
+                    let len = txt.len();
+                    match rng.gen_range(0, 4) {
+                        0 if len > 0 => {
+                            // delete several chunks of text from right to left
+                            let mut end = len;
+                            while end > 0 && rng.gen_bool(0.75) {
+                                let index = rng.gen_range(0, end);
+                                let count = rng.gen_range(1, (end - index).min(3) + 1);
+                                txt.remove_range(&mut txn, index, count);
+                                end = index;
+                            }
+                        }
+                        1 if len > 0 => {
+                            let index = rng.gen_range(0, len);
+                            let count = rng.gen_range(1, (len - index).min(5) + 1);
+                            txt.remove_range(&mut txn, index, count);
+                        }
+                        2 => txn.commit(),
+                        _ => {
+                            let index = rng.gen_range(0, len + 1);
+                            txt.insert(&mut txn, index, "abc");
+                        }
+                    }
+                }
+            }
+            let mut t2 = d2.transact();
+            for update in updates.borrow_mut().drain(..) {
+                d2.apply_update_v1(&mut t2, &update);
+                assert!(t2.store.pending.is_none());
+            }
+            let mut t1 = d1.transact();
+            assert_eq!(
+                t2.get_text("text").to_string(&t2),
+                t1.get_text("text").to_string(&t1)
+            );
+        }
+    }
+
+    #[test]
+    fn encode_state_as_update_to_writer() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let txt = txn.get_text("text");
+        // make sure that the update is larger than the writer's buffer
+        for i in 0..2000 {
+            txt.insert(&mut txn, i, "a");
+        }
+        txn.get_map("map")
+            .insert(&mut txn, "buf".to_owned(), vec![7u8; 20_000]);
+
+        let expected = doc.encode_state_as_update_v1(&txn);
+        let actual = doc.encode_state_as_update_v1_to(&txn, Vec::new()).unwrap();
+        assert_eq!(actual, expected);
+
+        let remote = Doc::new();
+        let remote_txn = remote.transact();
+        let sv = remote.get_state_vector(&remote_txn);
+        let mut actual = Vec::new();
+        doc.encode_delta_as_update_v1_to(&txn, &sv, &mut actual)
+            .unwrap();
+        assert_eq!(actual, doc.encode_delta_as_update_v1(&txn, &sv));
+
+        // encoded data is passed to a writer in chunks, as it's produced
+        struct Chunks(Vec<Vec<u8>>);
+        impl std::io::Write for Chunks {
+            fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+                self.0.push(buf.to_vec());
+                Ok(buf.len())
+            }
+            fn flush(&mut self) -> std::io::Result<()> {
+                Ok(())
+            }
+        }
+        let chunks = doc
+            .encode_state_as_update_v1_to(&txn, Chunks(Vec::new()))
+            .unwrap()
+            .0;
+        assert!(chunks.len() > 1);
+        assert_eq!(chunks.concat(), expected);
+    }
+
+    #[test]
+    fn encode_diff_filtered() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let txt = t1.get_text("text");
+        let map = t1.get_map("map");
+        txt.insert(&mut t1, 0, "hello");
+        let mut nested = HashMap::new();
+        nested.insert("key".to_owned(), Any::Bool(true));
+        map.insert(&mut t1, "nested".to_owned(), PrelimMap::from(nested));
+        txt.insert(&mut t1, 5, " world");
+        map.insert(&mut t1, "string".to_owned(), "value");
+        txt.remove_range(&mut t1, 0, 6);
+        map.remove(&mut t1, "string");
+
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        let mut encoder = EncoderV1::new();
+        t1.encode_diff_filtered(&t2.state_vector(), &["map"], &mut encoder);
+        t2.apply_update(Update::decode_v1(encoder.to_vec().as_slice()));
+
+        assert_eq!(t2.get_text("text").to_string(&t2), "");
+        assert_eq!(
+            t2.get_map("map").to_json(&t2),
+            t1.get_map("map").to_json(&t1)
+        );
+        assert!(t2.store.pending.is_none());
+        assert_eq!(t2.state_vector(), t1.state_vector());
+
+        // subsequent updates are based on a state vector of a partial replica
+        txt.insert(&mut t1, 0, "new ");
+        map.insert(&mut t1, "string".to_owned(), "new");
+        let mut encoder = EncoderV1::new();
+        t1.encode_diff_filtered(&t2.state_vector(), &["map"], &mut encoder);
+        t2.apply_update(Update::decode_v1(encoder.to_vec().as_slice()));
+        assert_eq!(t2.get_text("text").to_string(&t2), "");
+        assert_eq!(
+            t2.get_map("map").to_json(&t2),
+            t1.get_map("map").to_json(&t1)
+        );
+
+        // filtered out contents are covered by a replica's state vector, so they are never sent
+        let update = t1.encode_diff_v1(&t2.state_vector());
+        t2.apply_update(Update::decode_v1(&update));
+        assert_eq!(t2.get_text("text").to_string(&t2), "");
+    }
+
+    #[test]
+    fn encoded_len_is_exact() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let txt = txn.get_text("text");
+        txt.insert(&mut txn, 0, "hello zażółć gęślą jaźń");
+        txt.remove_range(&mut txn, 2, 3);
+
+        let map = txn.get_map("map");
+        map.insert(&mut txn, "string".to_owned(), "value");
+        map.insert(&mut txn, "int".to_owned(), 1_000_000);
+        map.insert(&mut txn, "float".to_owned(), 0.5);
+        map.insert(&mut txn, "double".to_owned(), 0.1);
+        map.insert(&mut txn, "bigint".to_owned(), Any::BigInt(-1));
+        map.insert(&mut txn, "buf".to_owned(), vec![1u8, 2, 3]);
+        let mut nested = HashMap::new();
+        nested.insert(
+            "key".to_owned(),
+            Any::Array(vec![Any::Null, Any::Bool(true)]),
+        );
+        map.insert(&mut txn, "nested".to_owned(), PrelimMap::from(nested));
+        map.insert(&mut txn, "int".to_owned(), -300);
+
+        let array = txn.get_array("array");
+        array.insert_range(&mut txn, 0, vec![1, 2, 3]);
+        array.insert_f64_range(&mut txn, 3, vec![0.25, 1.0e100, -7.0]);
+        array.remove_range(&mut txn, 1, 2);
+
+        let xml = txn.get_xml_element("xml");
+        let p = xml.push_elem_back(&mut txn, "p");
+        p.insert_attribute(&mut txn, "class", "paragraph");
+
+        let remote = Doc::with_client_id(2);
+        let mut remote_txn = remote.transact();
+        remote_txn
+            .get_text("text")
+            .insert(&mut remote_txn, 0, "remote");
+        let remote_update = remote.encode_state_as_update_v1(&remote_txn);
+        doc.apply_update_v1(&mut txn, &remote_update);
+
+        let state = doc.encode_state_as_update_v1(&txn);
+        assert_eq!(txn.store.encoded_len(), state.len());
+        assert_eq!(state.capacity(), state.len());
+
+        let remote_sv = remote.get_state_vector(&remote_txn);
+        let diff = doc.encode_delta_as_update_v1(&txn, &remote_sv);
+        assert_eq!(txn.store.encoded_diff_len(&remote_sv), diff.len());
+
+        let sv = doc.get_state_vector(&txn);
+        assert_eq!(sv.encoded_len(), sv.encode_v1().len());
+
+        let update = Update::decode_v1(&state);
+        assert_eq!(update.encoded_len(), update.encode_v1().len());
+        assert_eq!(
+            update.delete_set.encoded_len(),
+            update.delete_set.encode_v1().len()
+        );
+
+        // types which don't override encoded_len get it by counting encoded bytes
+        struct Counted<'a>(&'a Update);
+        impl<'a> Encode for Counted<'a> {
+            fn encode<E: Encoder>(&self, encoder: &mut E) {
+                self.0.encode(encoder)
+            }
+        }
+        assert_eq!(Counted(&update).encoded_len(), state.len());
+    }
 }
@@ -1,14 +1,16 @@
 use crate::update::Update;
+use crate::Transaction;
 use rand::RngCore;
 use std::cell::RefCell;
 use std::collections::HashMap;
+use std::marker::PhantomData;
 use std::rc::{Rc, Weak};
 
 pub(crate) struct EventHandler<T>(Rc<RefCell<Subscriptions<T>>>);
 
 type Subscriptions<T> = HashMap<u32, Box<dyn Fn(&T) -> ()>>;
 
-impl<T> EventHandler<T> {
+impl<T: 'static> EventHandler<T> {
     pub fn new() -> Self {
         EventHandler(Rc::new(RefCell::new(Subscriptions::new())))
     }
@@ -21,7 +23,7 @@ impl<T> EventHandler<T> {
         let id = rng.next_u32();
         self.0.borrow_mut().insert(id, Box::new(f));
         let subscriptions = Rc::downgrade(&self.0);
-        Subscription { id, subscriptions }
+        Subscription::new(id, subscriptions)
     }
 
     pub fn publish(&self, arg: &T) {
@@ -40,21 +42,83 @@ impl<T> EventHandler<T> {
     }
 }
 
+/// An observer of changes made to a shared collection. Unlike [EventHandler], its callbacks
+/// are also given a transaction, in scope of which observed changes have been made.
+pub(crate) struct Observer<E>(Rc<RefCell<Callbacks<E>>>);
+
+type Callbacks<E> = HashMap<u32, Box<dyn Fn(&Transaction, &E) -> ()>>;
+
+impl<E: 'static> Observer<E> {
+    pub fn new() -> Self {
+        Observer(Rc::new(RefCell::new(Callbacks::new())))
+    }
+
+    pub fn subscribe<F>(&mut self, f: F) -> Subscription<E>
+    where
+        F: Fn(&Transaction, &E) -> () + 'static,
+    {
+        let mut rng = rand::thread_rng();
+        let id = rng.next_u32();
+        self.0.borrow_mut().insert(id, Box::new(f));
+        let subscriptions = Rc::downgrade(&self.0);
+        Subscription::new(id, subscriptions)
+    }
+
+    pub fn publish(&self, txn: &Transaction, event: &E) {
+        let callbacks = self.0.borrow();
+        for f in callbacks.values() {
+            f(txn, event);
+        }
+    }
+
+    pub fn has_subscribers(&self) -> bool {
+        !self.0.borrow().is_empty()
+    }
+}
+
+impl<E> Clone for Observer<E> {
+    fn clone(&self) -> Self {
+        Observer(self.0.clone())
+    }
+}
+
 /// A subscription handle to a custom user-defined callback for an event handler. When dropped,
 /// it will unsubscribe corresponding callback.
 pub struct Subscription<T> {
     id: u32,
-    subscriptions: Weak<RefCell<Subscriptions<T>>>,
+    subscriptions: Weak<dyn Unsubscribe>,
+    _marker: PhantomData<T>,
+}
+
+impl<T> Subscription<T> {
+    fn new(id: u32, subscriptions: Weak<dyn Unsubscribe>) -> Self {
+        Subscription {
+            id,
+            subscriptions,
+            _marker: PhantomData,
+        }
+    }
 }
 
 impl<T> Drop for Subscription<T> {
     fn drop(&mut self) {
         if let Some(cell) = self.subscriptions.upgrade() {
-            cell.borrow_mut().remove(&self.id);
+            cell.unsubscribe(self.id);
         }
     }
 }
 
+/// A collection of callbacks, which can be removed using their subscription identifiers.
+trait Unsubscribe {
+    fn unsubscribe(&self, id: u32);
+}
+
+impl<F: ?Sized> Unsubscribe for RefCell<HashMap<u32, Box<F>>> {
+    fn unsubscribe(&self, id: u32) {
+        self.borrow_mut().remove(&id);
+    }
+}
+
 /// An update event passed to a callback registered in the event handler. Contains data about the
 /// state of an update.
 pub struct UpdateEvent {
@@ -69,6 +133,23 @@ impl UpdateEvent {
     }
 }
 
+/// An event passed to a callback registered via [Doc::on_after_transaction] once a transaction,
+/// which changed a document, has been committed.
+///
+/// [Doc::on_after_transaction]: crate::Doc::on_after_transaction
+pub struct AfterTransactionEvent {
+    /// An update containing all blocks inserted and deleted within a committed transaction,
+    /// encoded using lib0 v1 encoding. It's computed incrementally from the transaction changes,
+    /// so it can be broadcast to other peers without diffing entire document state.
+    pub update: Vec<u8>,
+}
+
+impl AfterTransactionEvent {
+    pub(crate) fn new(update: Vec<u8>) -> Self {
+        AfterTransactionEvent { update }
+    }
+}
+
 #[cfg(test)]
 mod test {
     use crate::event::EventHandler;
@@ -1,9 +1,11 @@
 use crate::block::{Block, ID};
 use crate::block_store::BlockStore;
+use crate::clock_bitmap::ClockBitmap;
 use crate::store::Store;
 use crate::updates::decoder::{Decode, Decoder};
 use crate::updates::encoder::{Encode, Encoder};
 use crate::utils::client_hasher::ClientHasher;
+use lib0::encoding::uvar_len;
 use std::collections::hash_map::Entry;
 use std::collections::HashMap;
 use std::hash::BuildHasherDefault;
@@ -17,6 +19,10 @@ impl Encode for Range<u32> {
         encoder.write_ds_clock(self.start);
         encoder.write_ds_len(self.end - self.start);
     }
+
+    fn encoded_len(&self) -> usize {
+        uvar_len(self.start) + uvar_len(self.end - self.start)
+    }
 }
 
 impl Decode for Range<u32> {
@@ -27,15 +33,23 @@ impl Decode for Range<u32> {
     }
 }
 
+/// Minimal number of squashed ranges, starting from which a fragmented [IdRange] is converted
+/// into a [ClockBitmap].
+const BITMAP_THRESHOLD: usize = 64;
+
 /// [IdRange] describes a single space of an [ID] clock values, belonging to the same client.
 /// It can contain from a single continuous space, or multiple ones having "holes" between them.
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone)]
 pub enum IdRange {
     /// A single continuous range of clocks.
     Continuous(Range<u32>),
     /// A multiple ranges containing clock values, separated from each other by other clock ranges
     /// not included in this [IdRange].
     Fragmented(Vec<Range<u32>>),
+    /// A heavily fragmented clock space, stored as a compressed bitmap. Fragmented ranges are
+    /// converted into it when squashed, once there are too many of them to be efficiently
+    /// searched or merged. It's converted back into ranges only for iteration and encoding.
+    Bitmap(ClockBitmap),
 }
 
 impl IdRange {
@@ -48,6 +62,7 @@ impl IdRange {
         match self {
             IdRange::Continuous(r) => r.start == r.end,
             IdRange::Fragmented(rs) => rs.is_empty(),
+            IdRange::Bitmap(bitmap) => bitmap.is_empty(),
         }
     }
 
@@ -57,21 +72,24 @@ impl IdRange {
     pub fn invert(&self) -> IdRange {
         match self {
             IdRange::Continuous(range) => IdRange::Continuous(0..range.start),
-            IdRange::Fragmented(ranges) => {
-                let mut inv = Vec::new();
-                let mut start = 0;
-                for range in ranges.iter() {
-                    if range.start > start {
-                        inv.push(start..range.start);
-                    }
-                    start = range.end;
-                }
-                match inv.len() {
-                    0 => IdRange::Continuous(0..0),
-                    1 => IdRange::Continuous(inv[0].clone()),
-                    _ => IdRange::Fragmented(inv),
-                }
+            IdRange::Fragmented(ranges) => Self::invert_ranges(ranges),
+            IdRange::Bitmap(bitmap) => Self::invert_ranges(&bitmap.to_ranges()),
+        }
+    }
+
+    fn invert_ranges(ranges: &[Range<u32>]) -> IdRange {
+        let mut inv = Vec::new();
+        let mut start = 0;
+        for range in ranges.iter() {
+            if range.start > start {
+                inv.push(start..range.start);
             }
+            start = range.end;
+        }
+        match inv.len() {
+            0 => IdRange::Continuous(0..0),
+            1 => IdRange::Continuous(inv[0].clone()),
+            _ => IdRange::Fragmented(inv),
         }
     }
 
@@ -80,23 +98,40 @@ impl IdRange {
         match self {
             IdRange::Continuous(range) => range.contains(&clock),
             IdRange::Fragmented(ranges) => ranges.iter().any(|r| r.contains(&clock)),
+            IdRange::Bitmap(bitmap) => bitmap.contains(clock),
         }
     }
 
     /// Iterate over ranges described by current [IdRange].
     pub fn iter(&self) -> IdRangeIter<'_> {
-        let (range, inner) = match self {
-            IdRange::Continuous(range) => (Some(range), None),
-            IdRange::Fragmented(ranges) => (None, Some(ranges.iter())),
-        };
-        IdRangeIter { range, inner }
+        match self {
+            IdRange::Continuous(range) => IdRangeIter {
+                range: Some(range),
+                inner: None,
+                owned: None,
+            },
+            IdRange::Fragmented(ranges) => IdRangeIter {
+                range: None,
+                inner: Some(ranges.iter()),
+                owned: None,
+            },
+            IdRange::Bitmap(bitmap) => IdRangeIter {
+                range: None,
+                inner: None,
+                owned: Some(bitmap.to_ranges().into_iter()),
+            },
+        }
     }
 
+    /// Adds a `range` to current [IdRange]. Ranges can be pushed in any order (ie. when deleting
+    /// text from right to left), so unless they overlap, a result may require squashing.
     fn push(&mut self, range: Range<u32>) {
         match self {
             IdRange::Continuous(r) => {
-                if r.end >= range.start {
-                    r.end = range.end; // two ranges overlap, we can eagerly merge them
+                if r.start <= range.end && range.start <= r.end {
+                    // two ranges overlap, we can eagerly merge them
+                    r.start = r.start.min(range.start);
+                    r.end = r.end.max(range.end);
                 } else {
                     *self = IdRange::Fragmented(vec![r.clone(), range])
                 }
@@ -104,6 +139,43 @@ impl IdRange {
             IdRange::Fragmented(ranges) => {
                 ranges.push(range);
             }
+            IdRange::Bitmap(bitmap) => bitmap.insert(range),
+        }
+    }
+
+    /// Merges `other` range into current one. Result may require squashing.
+    fn merge(&mut self, other: IdRange) {
+        match (&mut *self, other) {
+            (IdRange::Continuous(r1), IdRange::Continuous(r2)) => {
+                if r1.start <= r2.end && r2.start <= r1.end {
+                    r1.start = r1.start.min(r2.start);
+                    r1.end = r1.end.max(r2.end);
+                } else {
+                    *self = IdRange::Fragmented(vec![r1.clone(), r2]);
+                }
+            }
+            (IdRange::Fragmented(rs), IdRange::Continuous(r)) => {
+                rs.push(r);
+            }
+            (IdRange::Continuous(r), IdRange::Fragmented(mut rs)) => {
+                rs.push(r.clone());
+                *self = IdRange::Fragmented(rs);
+            }
+            (IdRange::Fragmented(rs1), IdRange::Fragmented(mut rs2)) => {
+                rs1.append(&mut rs2);
+            }
+            (IdRange::Bitmap(b1), IdRange::Bitmap(b2)) => b1.union(&b2),
+            (IdRange::Bitmap(bitmap), other) => {
+                for range in other.iter() {
+                    bitmap.insert(range);
+                }
+            }
+            (_, IdRange::Bitmap(mut bitmap)) => {
+                for range in self.iter() {
+                    bitmap.insert(range);
+                }
+                *self = IdRange::Bitmap(bitmap);
+            }
         }
     }
 
@@ -123,7 +195,7 @@ impl IdRange {
                         let next = head.offset(i).as_ref().unwrap();
                         if next.start <= current.end {
                             // merge next to current eg. curr=[0,5) & next=[3,6) => curr=[0,6)
-                            current.end = next.end;
+                            current.end = current.end.max(next.end);
                         } else {
                             // current and next are disjoined eg. [0,5) & [6,9)
 
@@ -142,7 +214,10 @@ impl IdRange {
                 }
 
                 if new_len == 1 {
-                    *self = IdRange::Continuous(ranges.pop().unwrap())
+                    *self = IdRange::Continuous(ranges.swap_remove(0))
+                } else if new_len as usize >= BITMAP_THRESHOLD {
+                    ranges.truncate(new_len as usize);
+                    *self = IdRange::Bitmap(ClockBitmap::from_ranges(ranges.iter()));
                 } else if ranges.len() != new_len as usize {
                     ranges.truncate(new_len as usize);
                 }
@@ -160,14 +235,48 @@ impl Encode for IdRange {
             }
             IdRange::Fragmented(ranges) => {
                 encoder.write_len(ranges.len() as u32);
+                encoder.write_ds_ranges(ranges);
+            }
+            IdRange::Bitmap(bitmap) => {
+                let ranges = bitmap.to_ranges();
+                encoder.write_len(ranges.len() as u32);
+                encoder.write_ds_ranges(&ranges);
+            }
+        }
+    }
+
+    fn encoded_len(&self) -> usize {
+        match self {
+            IdRange::Continuous(range) => 1 + range.encoded_len(),
+            IdRange::Fragmented(ranges) => {
+                let mut len = uvar_len(ranges.len());
+                for range in ranges.iter() {
+                    len += range.encoded_len();
+                }
+                len
+            }
+            IdRange::Bitmap(bitmap) => {
+                let ranges = bitmap.to_ranges();
+                let mut len = uvar_len(ranges.len());
                 for range in ranges.iter() {
-                    range.encode(encoder);
+                    len += range.encoded_len();
                 }
+                len
             }
         }
     }
 }
 
+impl Eq for IdRange {}
+
+impl PartialEq for IdRange {
+    /// Two ranges are equal, when they describe the same sequence of clock ranges, no matter what
+    /// their internal representation is.
+    fn eq(&self, other: &Self) -> bool {
+        self.iter().eq(other.iter())
+    }
+}
+
 impl Decode for IdRange {
     fn decode<D: Decoder>(decoder: &mut D) -> Self {
         match decoder.read_len() {
@@ -177,11 +286,7 @@ impl Decode for IdRange {
             }
             len => {
                 let mut ranges = Vec::with_capacity(len as usize);
-                let mut i = 0;
-                while i < len {
-                    ranges.push(Range::decode(decoder));
-                    i += 1;
-                }
+                decoder.read_ds_ranges(len, &mut ranges);
                 IdRange::Fragmented(ranges)
             }
         }
@@ -191,16 +296,20 @@ impl Decode for IdRange {
 pub struct IdRangeIter<'a> {
     inner: Option<std::slice::Iter<'a, Range<u32>>>,
     range: Option<&'a Range<u32>>,
+    /// Ranges decompressed from [IdRange::Bitmap].
+    owned: Option<std::vec::IntoIter<Range<u32>>>,
 }
 
 impl<'a> Iterator for IdRangeIter<'a> {
-    type Item = &'a Range<u32>;
+    type Item = Range<u32>;
 
     fn next(&mut self) -> Option<Self::Item> {
         if let Some(inner) = &mut self.inner {
-            inner.next()
+            inner.next().cloned()
+        } else if let Some(owned) = &mut self.owned {
+            owned.next()
         } else {
-            self.range.take()
+            self.range.take().cloned()
         }
     }
 }
@@ -209,9 +318,11 @@ impl<'a> Iterator for IdRangeIter<'a> {
 impl<'a> DoubleEndedIterator for IdRangeIter<'a> {
     fn next_back(&mut self) -> Option<Self::Item> {
         if let Some(inner) = &mut self.inner {
-            inner.next_back()
+            inner.next_back().cloned()
+        } else if let Some(owned) = &mut self.owned {
+            owned.next_back()
         } else {
-            self.range.take()
+            self.range.take().cloned()
         }
     }
 }
@@ -242,7 +353,7 @@ impl IdSet {
 
     /// Check if current [IdSet] contains given `id`.
     pub fn contains(&self, id: &ID) -> bool {
-        if let Some(ranges) = self.0.get(&id.client) {
+        if let Some(ranges) = self.0.get(&{ id.client }) {
             ranges.contains(id.clock)
         } else {
             false
@@ -285,31 +396,7 @@ impl IdSet {
             .0
             .into_iter()
             .for_each(|(client, range)| match self.0.entry(client) {
-                Entry::Occupied(mut e) => {
-                    let r = e.get_mut();
-                    match (r, range) {
-                        (IdRange::Continuous(r1), IdRange::Continuous(r2)) => {
-                            if r1.end >= r2.start && r1.start <= r2.start {
-                                r1.end = r2.end;
-                            } else {
-                                let new = IdRange::Fragmented(vec![r1.clone(), r2.clone()]);
-                                e.replace_entry(new);
-                            }
-                        }
-                        (IdRange::Fragmented(rs), IdRange::Continuous(r)) => {
-                            rs.push(r);
-                        }
-                        (IdRange::Continuous(r), IdRange::Fragmented(rs)) => {
-                            let mut v = rs;
-                            v.push(r.clone());
-                            let new = IdRange::Fragmented(v);
-                            e.replace_entry(new);
-                        }
-                        (IdRange::Fragmented(rs1), IdRange::Fragmented(mut rs2)) => {
-                            rs1.append(&mut rs2);
-                        }
-                    }
-                }
+                Entry::Occupied(mut e) => e.get_mut().merge(range),
                 Entry::Vacant(e) => {
                     e.insert(range);
                 }
@@ -327,6 +414,14 @@ impl Encode for IdSet {
             block.encode(encoder);
         }
     }
+
+    fn encoded_len(&self) -> usize {
+        let mut len = uvar_len(self.0.len());
+        for (&client_id, block) in self.0.iter() {
+            len += uvar_len(client_id) + block.encoded_len();
+        }
+        len
+    }
 }
 
 impl Decode for IdSet {
@@ -360,22 +455,7 @@ impl<'a> From<&'a BlockStore> for DeleteSet {
     /// Creates a [DeleteSet] by reading all deleted blocks and including their clock ranges into
     /// the delete set itself.
     fn from(store: &'a BlockStore) -> Self {
-        let mut set = DeleteSet(IdSet::new());
-        for (&client, blocks) in store.iter() {
-            let mut deletes = IdRange::with_capacity(blocks.len());
-            for block in blocks.iter() {
-                if block.is_deleted() {
-                    let start = block.id().clock;
-                    let end = start + block.len();
-                    deletes.push(start..end);
-                }
-            }
-
-            if !deletes.is_empty() {
-                set.0.insert_range(client, deletes);
-            }
-        }
-        set
+        Self::from_blocks_filtered(store, |_| true)
     }
 }
 
@@ -412,6 +492,13 @@ impl std::fmt::Display for IdRange {
                 }
                 write!(f, " ]")
             }
+            IdRange::Bitmap(bitmap) => {
+                write!(f, "[")?;
+                for r in bitmap.to_ranges() {
+                    write!(f, " [{}..{})", r.start, r.end)?;
+                }
+                write!(f, " ]")
+            }
         }
     }
 }
@@ -422,6 +509,30 @@ impl DeleteSet {
         DeleteSet(IdSet::new())
     }
 
+    /// Creates a [DeleteSet] just like [DeleteSet::from] a [BlockStore] does, but includes only
+    /// these of deleted blocks, for which a given `filter` returns true.
+    pub(crate) fn from_blocks_filtered<F>(store: &BlockStore, filter: F) -> Self
+    where
+        F: Fn(&Block) -> bool,
+    {
+        let mut set = DeleteSet(IdSet::new());
+        for (&client, blocks) in store.iter() {
+            let mut deletes = IdRange::with_capacity(blocks.len());
+            for block in blocks.iter() {
+                if block.is_deleted() && filter(block) {
+                    let start = block.id().clock;
+                    let end = start + block.len();
+                    deletes.push(start..end);
+                }
+            }
+
+            if !deletes.is_empty() {
+                set.0.insert_range(client, deletes);
+            }
+        }
+        set
+    }
+
     /// Inserts an information about delete block (identified by `id` and having a specified length)
     /// inside of a current delete set.
     pub fn insert(&mut self, id: ID, len: u32) {
@@ -458,6 +569,7 @@ impl DeleteSet {
 
     pub(crate) fn try_squash_with(&mut self, store: &mut Store) {
         // try to merge deleted / gc'd items
+        let items_only = store.lazy.borrow().is_some();
         for (client, range) in self.iter() {
             if let Some(mut blocks) = store.blocks.get_mut(client) {
                 for r in range.iter().rev() {
@@ -466,7 +578,7 @@ impl DeleteSet {
                         .min(1 + blocks.find_pivot(r.end - 1).unwrap_or_default());
                     let mut block = &blocks[si];
                     while si > 0 && block.id().clock >= r.start {
-                        if let Some(compaction) = blocks.squash_left(si) {
+                        if let Some(compaction) = blocks.squash_left(si, items_only) {
                             if let Some(right) = compaction.new_right {
                                 right.fix_pivot((right.pivot().max(1) - 1) as u32);
                                 if let Block::Item(item) =
@@ -496,14 +608,18 @@ impl Encode for DeleteSet {
     fn encode<E: Encoder>(&self, encoder: &mut E) {
         self.0.encode(encoder)
     }
+
+    fn encoded_len(&self) -> usize {
+        self.0.encoded_len()
+    }
 }
 
 #[cfg(test)]
 mod test {
-    use crate::id_set::{IdRange, IdSet};
+    use crate::id_set::{IdRange, IdSet, BITMAP_THRESHOLD};
     use crate::updates::decoder::{Decode, DecoderV1};
     use crate::updates::encoder::{Encode, Encoder, EncoderV1};
-    use crate::ID;
+    use crate::{Doc, ID};
     use std::fmt::Debug;
 
     #[test]
@@ -561,6 +677,20 @@ mod test {
 
         range.push(7..9);
         assert_eq!(range, IdRange::Fragmented(vec![0..6, 7..9]));
+
+        // ranges pushed from right to left
+        let mut range = IdRange::Continuous(11..12);
+        range.push(10..11);
+        assert_eq!(range, IdRange::Continuous(10..12));
+
+        range.push(2..3);
+        range.push(0..1);
+        range.squash();
+        assert_eq!(range, IdRange::Fragmented(vec![0..1, 2..3, 10..12]));
+
+        range.push(1..11);
+        range.squash();
+        assert_eq!(range, IdRange::Continuous(0..12));
     }
 
     #[test]
@@ -569,6 +699,74 @@ mod test {
         roundtrip(&IdRange::Fragmented(vec![1..4, 5..8]));
     }
 
+    #[test]
+    fn id_range_bitmap() {
+        let len = BITMAP_THRESHOLD as u32 * 4;
+        let ranges: Vec<_> = (0..len).rev().map(|i| i * 3..i * 3 + 2).collect();
+        let mut r = IdRange::Fragmented(ranges.clone());
+        r.squash();
+        assert!(matches!(r, IdRange::Bitmap(_)));
+        assert!(r.contains(0));
+        assert!(r.contains(1));
+        assert!(!r.contains(2));
+        assert!(!r.contains(len * 3));
+        assert_eq!(r.iter().count(), len as usize);
+        assert_eq!(r.iter().next(), Some(0..2));
+        assert_eq!(r.iter().next_back(), Some(len * 3 - 3..len * 3 - 1));
+        roundtrip(&r);
+
+        // merging with bitmaps fills the holes
+        let mut set = IdSet::new();
+        set.insert_range(1, r);
+        let mut other = IdSet::new();
+        other.insert(ID::new(1, 2), 1);
+        other.insert(ID::new(1, len * 3), 10);
+        set.merge(other);
+        assert!(set.contains(&ID::new(1, 2)));
+        assert!(!set.contains(&ID::new(1, 5)));
+        assert!(set.contains(&ID::new(1, len * 3 + 9)));
+        assert_eq!(set.0[&1].iter().next_back(), Some(len * 3..len * 3 + 10));
+    }
+
+    #[test]
+    fn fragmented_delete_set_sync() {
+        let d1 = Doc::with_client_id(1);
+        let content = "abcdefghij".repeat(BITMAP_THRESHOLD);
+        let txt = {
+            let mut t1 = d1.transact();
+            let txt = t1.get_text("text");
+            txt.insert(&mut t1, 0, &content);
+            txt
+        };
+        let d2 = Doc::with_client_id(2);
+        {
+            let t1 = d1.transact();
+            let mut t2 = d2.transact();
+            d2.apply_update_v1(&mut t2, &d1.encode_state_as_update_v1(&t1));
+        }
+
+        // remove every other character
+        let update = {
+            let mut t1 = d1.transact();
+            for i in 0..(content.len() as u32 / 2) {
+                txt.remove_range(&mut t1, i + 1, 1);
+            }
+            t1.delete_set.squash();
+            assert!(matches!(
+                t1.delete_set.0 .0.get(&1),
+                Some(IdRange::Bitmap(_))
+            ));
+            t1.encode_update_v1()
+        };
+
+        let expected: String = content.chars().step_by(2).collect();
+        let t1 = d1.transact();
+        assert_eq!(txt.to_string(&t1), expected);
+        let mut t2 = d2.transact();
+        d2.apply_update_v1(&mut t2, &update);
+        assert_eq!(t2.get_text("text").to_string(&t2), expected);
+    }
+
     #[test]
     fn id_set_encode_decode() {
         let mut set = IdSet::new();
@@ -1,5 +1,4 @@
 #![feature(new_uninit)]
-#![feature(map_entry_replace)]
 //! Yrs "wires" is a high performance CRDT implementation based on the idea of **Shared
 //! Types**. It is a compatible port of the [Yjs](https://github.com/yjs/yjs) CRDT.
 //!
@@ -26,9 +25,13 @@
 mod alt;
 pub mod block;
 mod block_store;
+mod clock_bitmap;
+mod diff_cache;
 mod doc;
 mod event;
 mod id_set;
+pub mod persistence;
+mod snapshot;
 mod store;
 mod transaction;
 pub mod types;
@@ -46,6 +49,7 @@ pub use crate::alt::{diff_updates, encode_state_vector_from_update, merge_update
 pub use crate::block::ID;
 pub use crate::block_store::StateVector;
 pub use crate::doc::Doc;
+pub use crate::event::{AfterTransactionEvent, Subscription, UpdateEvent};
 pub use crate::id_set::DeleteSet;
 pub use crate::transaction::Transaction;
 pub use crate::types::array::Array;
@@ -56,4 +60,5 @@ pub use crate::types::text::Text;
 pub use crate::types::xml::Xml;
 pub use crate::types::xml::XmlElement;
 pub use crate::types::xml::XmlText;
+pub use crate::types::PrelimJson;
 pub use crate::update::Update;
@@ -0,0 +1,762 @@
+//! Local persistence of documents in form of an append-only log of updates.
+//!
+//! Instead of rewriting an entire document state on every save, [UpdateLog] appends updates
+//! produced by individual transactions (see [Transaction::encode_update_v1]) at the end of a log.
+//! Once a log grows over a configured threshold, it's compacted in the background: all logged
+//! updates are merged together with the latest snapshot into a new snapshot using
+//! [crate::merge_updates]. A document is restored by applying a snapshot and then all of the
+//! updates appended after it.
+//!
+//! All files are kept inside of a single directory:
+//!
+//! - `snapshot` contains a single update with a merged state of all compacted log segments.
+//! - `log-<N>` segments contain a sequence of records, each one made of a length-prefixed update
+//!   followed by a CRC-32 checksum of that update. New updates are always appended to
+//!   the segment with the highest number.
+//!
+//! A record, which is incomplete or doesn't match its checksum, is treated as a torn write left
+//! by a crash: it's ignored together with everything that follows it in a segment.
+
+use crate::update::Update;
+use crate::updates::decoder::{Decode, DecoderV1};
+use crate::updates::encoder::Encode;
+use crate::Transaction;
+use lib0::encoding::Write;
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, BufWriter, Write as IoWrite};
+use std::path::{Path, PathBuf};
+use std::thread::JoinHandle;
+
+const SNAPSHOT_FILE: &str = "snapshot";
+const SEGMENT_PREFIX: &str = "log-";
+
+/// Configuration of an [UpdateLog].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Options {
+    /// Number of appended updates, after which log is synchronized with the underlying storage
+    /// device. Updates appended since the last synchronization are lost in case of a system crash.
+    /// `1` makes every [UpdateLog::append] durable on its own.
+    pub sync_every: usize,
+    /// Size (in bytes) of a current log segment, over which a background compaction is started.
+    pub compaction_threshold: u64,
+}
+
+impl Default for Options {
+    fn default() -> Self {
+        Options {
+            sync_every: 64,
+            compaction_threshold: 4 * 1024 * 1024,
+        }
+    }
+}
+
+/// Append-only log of document updates stored in a local directory. See [module documentation]
+/// for details.
+///
+/// Log files are memory-mapped while they are read, so a log directory must not be modified by
+/// anything else than a single [UpdateLog] at the time.
+///
+/// [module documentation]: crate::persistence
+pub struct UpdateLog {
+    dir: PathBuf,
+    options: Options,
+    /// Number of a segment, to which updates are currently appended.
+    segment: u64,
+    writer: BufWriter<File>,
+    /// Size of a current segment in bytes.
+    segment_len: u64,
+    /// Number of updates appended since the last sync.
+    unsynced: usize,
+    compaction: Option<JoinHandle<io::Result<()>>>,
+}
+
+impl UpdateLog {
+    /// Opens an update log stored in a given directory using default [Options]. Directory is
+    /// created if it didn't exist.
+    pub fn open<P: AsRef<Path>>(dir: P) -> io::Result<Self> {
+        Self::open_with(dir, Options::default())
+    }
+
+    /// Opens an update log stored in a given directory. Directory is created if it didn't exist.
+    ///
+    /// If a process crashed in the middle of writing an update, an active log segment ends with
+    /// an incomplete or corrupted record. Such segment is truncated to its last valid record, so
+    /// that new updates are not appended after a torn one.
+    pub fn open_with<P: AsRef<Path>>(dir: P, options: Options) -> io::Result<Self> {
+        let dir = dir.as_ref().to_path_buf();
+        fs::create_dir_all(&dir)?;
+        let segment = segments(&dir)?.last().cloned().unwrap_or(0);
+        let file = OpenOptions::new()
+            .create(true)
+            .read(true)
+            .append(true)
+            .open(segment_path(&dir, segment))?;
+        sync_dir(&dir)?;
+        let mut segment_len = file.metadata()?.len();
+        if segment_len > 0 {
+            // mapping is released before a segment is truncated
+            let mapped = unsafe { MappedFile::open(segment_path(&dir, segment))? };
+            let complete = complete_len(&mapped) as u64;
+            drop(mapped);
+            if complete < segment_len {
+                file.set_len(complete)?;
+                file.sync_all()?;
+                segment_len = complete;
+            }
+        }
+        Ok(UpdateLog {
+            dir,
+            options,
+            segment,
+            writer: BufWriter::new(file),
+            segment_len,
+            unsynced: 0,
+            compaction: None,
+        })
+    }
+
+    /// Restores a persisted document state by applying a snapshot followed by all updates logged
+    /// after it within a given transaction. If a process crashed in the middle of writing an
+    /// update, that torn update is skipped.
+    ///
+    /// Returns an [io::ErrorKind::InvalidData] error if a snapshot or any of the logged updates
+    /// couldn't be decoded. Updates preceding it are applied in that case.
+    pub fn load(&mut self, txn: &mut Transaction) -> io::Result<()> {
+        self.flush()?;
+        self.wait_for_compaction()?;
+        let (files, segments) = map_files(&self.dir, u64::MAX)?;
+        let has_snapshot = files.len() > segments.len();
+        for update in updates(&files, has_snapshot) {
+            txn.apply_update(decode_update(update)?);
+        }
+        Ok(())
+    }
+
+    /// Appends a binary `update` (ie. produced by [Transaction::encode_update_v1]) at the end of
+    /// a log. Log is synchronized with the underlying storage device every
+    /// [Options::sync_every] updates. If a current log segment grows over
+    /// [Options::compaction_threshold], a background compaction is started.
+    ///
+    /// An `update` is decoded first, so that a log never contains updates, which couldn't be
+    /// loaded later on. If it's malformed, an [io::ErrorKind::InvalidData] error is returned and
+    /// nothing is appended.
+    pub fn append(&mut self, update: &[u8]) -> io::Result<()> {
+        decode_update(update)?;
+        self.append_record(update)
+    }
+
+    /// Appends all changes made so far within a given transaction.
+    pub fn append_transaction(&mut self, txn: &Transaction) -> io::Result<()> {
+        self.append_record(&txn.encode_update_v1())
+    }
+
+    fn append_record(&mut self, update: &[u8]) -> io::Result<()> {
+        let mut record = Vec::with_capacity(lib0::encoding::buf_len(update.len()) + 4);
+        write_record(&mut record, update);
+        self.writer.write_all(&record)?;
+        self.segment_len += record.len() as u64;
+        self.unsynced += 1;
+        if self.unsynced >= self.options.sync_every {
+            self.flush()?;
+        }
+        if self.segment_len > self.options.compaction_threshold && !self.is_compacting() {
+            self.compact()?;
+        }
+        Ok(())
+    }
+
+    /// Writes all buffered updates into a current log segment and synchronizes it with the
+    /// underlying storage device.
+    pub fn flush(&mut self) -> io::Result<()> {
+        self.writer.flush()?;
+        if self.unsynced > 0 {
+            self.writer.get_ref().sync_data()?;
+            self.unsynced = 0;
+        }
+        Ok(())
+    }
+
+    /// Seals a current log segment and starts merging all sealed segments into a new snapshot on
+    /// a background thread. New updates are appended to a fresh segment in the meantime.
+    ///
+    /// If a previous compaction is still running, this method waits for it to complete first.
+    /// Errors of a previous compaction are reported here.
+    pub fn compact(&mut self) -> io::Result<()> {
+        self.wait_for_compaction()?;
+        self.flush()?;
+
+        let segment = self.segment + 1;
+        let file = OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(segment_path(&self.dir, segment))?;
+        sync_dir(&self.dir)?;
+        self.writer = BufWriter::new(file);
+        self.segment = segment;
+        self.segment_len = 0;
+
+        let dir = self.dir.clone();
+        let handle = std::thread::Builder::new()
+            .name("yrs-compaction".to_owned())
+            .spawn(move || compact(&dir, segment))?;
+        self.compaction = Some(handle);
+        Ok(())
+    }
+
+    /// Returns `true` if a background compaction is currently in progress.
+    pub fn is_compacting(&self) -> bool {
+        match &self.compaction {
+            Some(handle) => !handle.is_finished(),
+            None => false,
+        }
+    }
+
+    /// Blocks until a background compaction (if any) is completed and returns its result.
+    pub fn wait_for_compaction(&mut self) -> io::Result<()> {
+        match self.compaction.take() {
+            None => Ok(()),
+            Some(handle) => match handle.join() {
+                Ok(result) => result,
+                Err(_) => Err(io::Error::new(
+                    io::ErrorKind::Other,
+                    "update log compaction has panicked",
+                )),
+            },
+        }
+    }
+
+    /// Flushes all appended updates and waits for a background compaction to complete.
+    pub fn close(mut self) -> io::Result<()> {
+        self.flush()?;
+        self.wait_for_compaction()
+    }
+}
+
+/// Restores a document state from a binary update stored in a file under a given `path`, ie.
+/// a snapshot produced by [crate::Doc::encode_state_as_update_v1_to]. File is memory-mapped and
+/// decoded directly from the mapping, so that it doesn't have to be copied into a heap buffer
+/// first.
+///
+/// Returns an [io::ErrorKind::InvalidData] error if a file doesn't contain a valid update.
+///
+/// # Safety
+///
+/// A file must not be truncated or modified until this function returns. See [MappedFile::open].
+pub unsafe fn load_snapshot<P: AsRef<Path>>(txn: &mut Transaction, path: P) -> io::Result<()> {
+    let file = MappedFile::open(path)?;
+    let update = decode_update(&file)?;
+    drop(file);
+    txn.apply_update(update);
+    Ok(())
+}
+
+/// Decodes an update stored in a file. Since decoder panics on malformed input, such panic is
+/// caught and reported as an [io::ErrorKind::InvalidData] error instead.
+fn decode_update(buf: &[u8]) -> io::Result<Update> {
+    let result = std::panic::catch_unwind(|| {
+        let mut decoder = DecoderV1::from(buf);
+        Update::decode(&mut decoder)
+    });
+    result.map_err(|_| io::Error::new(io::ErrorKind::InvalidData, "malformed update"))
+}
+
+/// Read-only view of an entire file contents. On 64-bit Unix platforms a file is memory-mapped,
+/// so that its pages are loaded lazily by the OS and can be reclaimed from the page cache. On
+/// other platforms file contents are read into a heap buffer.
+pub struct MappedFile {
+    #[cfg(all(unix, target_pointer_width = "64"))]
+    ptr: *mut u8,
+    #[cfg(all(unix, target_pointer_width = "64"))]
+    len: usize,
+    #[cfg(not(all(unix, target_pointer_width = "64")))]
+    buf: Vec<u8>,
+}
+
+#[cfg(all(unix, target_pointer_width = "64"))]
+mod mmap {
+    use std::os::raw::{c_int, c_void};
+
+    pub const PROT_READ: c_int = 1;
+    pub const MAP_PRIVATE: c_int = 2;
+
+    extern "C" {
+        pub fn mmap(
+            addr: *mut c_void,
+            len: usize,
+            prot: c_int,
+            flags: c_int,
+            fd: c_int,
+            offset: i64,
+        ) -> *mut c_void;
+        pub fn munmap(addr: *mut c_void, len: usize) -> c_int;
+    }
+}
+
+impl MappedFile {
+    /// Opens a file under a given `path` and maps its entire contents into memory.
+    ///
+    /// # Safety
+    ///
+    /// A file must not be truncated or modified (by this or any other process) for as long as
+    /// a returned [MappedFile] is alive. Otherwise accessing its contents may either crash
+    /// a process with `SIGBUS` or observe bytes changing behind a shared reference, which is
+    /// undefined behavior.
+    #[cfg(all(unix, target_pointer_width = "64"))]
+    pub unsafe fn open<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        use std::os::unix::io::AsRawFd;
+
+        let file = File::open(path)?;
+        let len = file.metadata()?.len() as usize;
+        if len == 0 {
+            // empty mappings are not allowed
+            return Ok(MappedFile {
+                ptr: std::ptr::NonNull::dangling().as_ptr(),
+                len,
+            });
+        }
+        let ptr = mmap::mmap(
+            std::ptr::null_mut(),
+            len,
+            mmap::PROT_READ,
+            mmap::MAP_PRIVATE,
+            file.as_raw_fd(),
+            0,
+        );
+        // mapping stays valid after file descriptor is closed
+        if ptr as isize == -1 {
+            Err(io::Error::last_os_error())
+        } else {
+            Ok(MappedFile {
+                ptr: ptr as *mut u8,
+                len,
+            })
+        }
+    }
+
+    /// Reads an entire contents of a file under a given `path`.
+    ///
+    /// # Safety
+    ///
+    /// This function is always safe to call on this platform. It's marked as `unsafe` only to
+    /// match its memory-mapped counterpart.
+    #[cfg(not(all(unix, target_pointer_width = "64")))]
+    pub unsafe fn open<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        Ok(MappedFile {
+            buf: fs::read(path)?,
+        })
+    }
+}
+
+impl AsRef<[u8]> for MappedFile {
+    #[cfg(all(unix, target_pointer_width = "64"))]
+    fn as_ref(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+    }
+
+    #[cfg(not(all(unix, target_pointer_width = "64")))]
+    fn as_ref(&self) -> &[u8] {
+        &self.buf
+    }
+}
+
+impl std::ops::Deref for MappedFile {
+    type Target = [u8];
+
+    fn deref(&self) -> &Self::Target {
+        self.as_ref()
+    }
+}
+
+#[cfg(all(unix, target_pointer_width = "64"))]
+impl Drop for MappedFile {
+    fn drop(&mut self) {
+        if self.len != 0 {
+            unsafe { mmap::munmap(self.ptr as *mut _, self.len) };
+        }
+    }
+}
+
+fn segment_path(dir: &Path, segment: u64) -> PathBuf {
+    dir.join(format!("{}{}", SEGMENT_PREFIX, segment))
+}
+
+/// Returns numbers of all log segments found in a given directory in ascending order.
+fn segments(dir: &Path) -> io::Result<Vec<u64>> {
+    let mut result = Vec::new();
+    for entry in fs::read_dir(dir)? {
+        let name = entry?.file_name();
+        let segment = name
+            .to_str()
+            .and_then(|name| name.strip_prefix(SEGMENT_PREFIX))
+            .and_then(|n| n.parse().ok());
+        if let Some(segment) = segment {
+            result.push(segment);
+        }
+    }
+    result.sort_unstable();
+    Ok(result)
+}
+
+/// Maps a snapshot and all log segments with numbers lower than `until` into memory. Returns
+/// a list of mapped files (starting with a snapshot, if it exists) and numbers of mapped segments.
+///
+/// Mapped files are never modified in place: a snapshot is replaced by renaming a new file over
+/// it, sealed segments are only removed, while an active segment (which is being appended to) is
+/// mapped only by [UpdateLog::load], which has an exclusive access to a log.
+fn map_files(dir: &Path, until: u64) -> io::Result<(Vec<MappedFile>, Vec<u64>)> {
+    let mut files = Vec::new();
+    match unsafe { MappedFile::open(dir.join(SNAPSHOT_FILE)) } {
+        Ok(snapshot) => files.push(snapshot),
+        Err(e) if e.kind() == io::ErrorKind::NotFound => {}
+        Err(e) => return Err(e),
+    }
+    let segments: Vec<u64> = segments(dir)?
+        .into_iter()
+        .filter(|&segment| segment < until)
+        .collect();
+    for &segment in segments.iter() {
+        files.push(unsafe { MappedFile::open(segment_path(dir, segment))? });
+    }
+    Ok((files, segments))
+}
+
+/// Returns all updates stored in files returned by [map_files]: a snapshot (if present) is
+/// a single update, while segments are split into their records.
+fn updates(files: &[MappedFile], has_snapshot: bool) -> Vec<&[u8]> {
+    let mut updates = Vec::new();
+    for (i, file) in files.iter().enumerate() {
+        if i == 0 && has_snapshot {
+            updates.push(file.as_ref());
+        } else {
+            read_records(file, &mut updates);
+        }
+    }
+    updates
+}
+
+/// Splits a log segment into records. Torn record (left by a crash in the middle of a write)
+/// and everything following it is ignored.
+fn read_records<'a>(buf: &'a [u8], records: &mut Vec<&'a [u8]>) {
+    let mut pos = 0;
+    while let Some((record, next)) = next_record(buf, pos) {
+        records.push(record);
+        pos = next;
+    }
+}
+
+/// Returns a length of a log segment prefix, which contains only valid records.
+fn complete_len(buf: &[u8]) -> usize {
+    let mut pos = 0;
+    while let Some((_, next)) = next_record(buf, pos) {
+        pos = next;
+    }
+    pos
+}
+
+/// Writes an `update` into a `buf` as a log segment record.
+fn write_record(buf: &mut Vec<u8>, update: &[u8]) {
+    buf.write_buf(update);
+    buf.write_u32(crc32(update));
+}
+
+/// Reads a record starting at a given position of a log segment. Returns an update stored in it
+/// together with a position right after a record, or `None` if there's no valid record at that
+/// position: it's incomplete, doesn't match its checksum or is empty (ie. it's a part of
+/// a zero-filled file tail).
+fn next_record(buf: &[u8], mut pos: usize) -> Option<(&[u8], usize)> {
+    let mut len: usize = 0;
+    let mut shift = 0;
+    loop {
+        match buf.get(pos) {
+            Some(&b) if shift < usize::BITS => {
+                len |= ((b & 0b0111_1111) as usize) << shift;
+                shift += 7;
+                pos += 1;
+                if b < 0b1000_0000 {
+                    break;
+                }
+            }
+            _ => return None,
+        }
+    }
+    if len == 0 {
+        return None;
+    }
+    let end = pos.checked_add(len)?;
+    let update = buf.get(pos..end)?;
+    let checksum = buf.get(end..end.checked_add(4)?)?;
+    if u32::from_le_bytes([checksum[0], checksum[1], checksum[2], checksum[3]]) == crc32(update) {
+        Some((update, end + 4))
+    } else {
+        None
+    }
+}
+
+/// Lookup table of a CRC-32 (IEEE 802.3) checksum, computed at compile time.
+const CRC32_TABLE: [u32; 256] = {
+    let mut table = [0u32; 256];
+    let mut i = 0;
+    while i < 256 {
+        let mut crc = i as u32;
+        let mut bit = 0;
+        while bit < 8 {
+            crc = if crc & 1 != 0 {
+                (crc >> 1) ^ 0xEDB8_8320
+            } else {
+                crc >> 1
+            };
+            bit += 1;
+        }
+        table[i] = crc;
+        i += 1;
+    }
+    table
+};
+
+/// Computes a CRC-32 (IEEE 802.3) checksum of a given buffer.
+fn crc32(buf: &[u8]) -> u32 {
+    let mut crc = !0u32;
+    for &b in buf {
+        crc = CRC32_TABLE[((crc ^ b as u32) & 0xFF) as usize] ^ (crc >> 8);
+    }
+    !crc
+}
+
+/// Synchronizes a directory with the underlying storage device, so that files created or renamed
+/// within it survive a system crash. Directories cannot be synchronized this way on Windows,
+/// where it's a no-op.
+#[cfg(unix)]
+fn sync_dir(dir: &Path) -> io::Result<()> {
+    File::open(dir)?.sync_all()
+}
+
+#[cfg(not(unix))]
+fn sync_dir(_dir: &Path) -> io::Result<()> {
+    Ok(())
+}
+
+/// Merges a snapshot and all segments sealed before a given `active` segment into a new
+/// snapshot, then removes merged segments.
+fn compact(dir: &Path, active: u64) -> io::Result<()> {
+    let (files, segments) = map_files(dir, active)?;
+    if segments.is_empty() {
+        return Ok(());
+    }
+    let has_snapshot = files.len() > segments.len();
+    let mut decoded = Vec::new();
+    for update in updates(&files, has_snapshot) {
+        decoded.push(decode_update(update)?);
+    }
+    drop(files);
+    let snapshot = Update::merge_updates(decoded).encode_v1();
+
+    // replace a snapshot atomically, so that a crash never leaves a partially written one
+    let tmp = dir.join(format!("{}.tmp", SNAPSHOT_FILE));
+    {
+        let mut file = File::create(&tmp)?;
+        file.write_all(&snapshot)?;
+        file.sync_all()?;
+    }
+    fs::rename(&tmp, dir.join(SNAPSHOT_FILE))?;
+    sync_dir(dir)?;
+
+    // if a process crashes before segments are removed, their updates are applied again
+    // on load, which is harmless
+    for segment in segments {
+        fs::remove_file(segment_path(dir, segment))?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod test {
+    use crate::persistence::{
+        load_snapshot, read_records, write_record, MappedFile, Options, UpdateLog,
+    };
+    use crate::Doc;
+    use lib0::encoding::Write;
+    use std::io::ErrorKind;
+
+    fn temp_dir(name: &str) -> std::path::PathBuf {
+        let dir = std::env::temp_dir().join(format!("yrs-{}-{}", name, std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        dir
+    }
+
+    #[test]
+    fn update_log_load() {
+        let dir = temp_dir("update-log-load");
+        let options = Options {
+            sync_every: 2,
+            compaction_threshold: 64,
+        };
+        let doc = Doc::with_client_id(1);
+        {
+            let mut log = UpdateLog::open_with(&dir, options).unwrap();
+            for i in 0..20 {
+                let mut txn = doc.transact();
+                let text = txn.get_text("text");
+                text.push(&mut txn, &format!("hello {} ", i));
+                log.append_transaction(&txn).unwrap();
+            }
+            log.compact().unwrap();
+            let mut txn = doc.transact();
+            txn.get_text("text").push(&mut txn, "tail");
+            log.append_transaction(&txn).unwrap();
+            log.close().unwrap();
+        }
+        assert!(dir.join("snapshot").exists());
+
+        let expected = {
+            let mut txn = doc.transact();
+            txn.get_text("text").to_string(&txn)
+        };
+        let restored = Doc::with_client_id(2);
+        let mut txn = restored.transact();
+        let mut log = UpdateLog::open(&dir).unwrap();
+        log.load(&mut txn).unwrap();
+        assert_eq!(txn.get_text("text").to_string(&txn), expected);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn load_mapped_snapshot() {
+        let dir = temp_dir("load-mapped-snapshot");
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("doc.bin");
+
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        txn.get_text("text").push(&mut txn, "hello world");
+        let file = std::fs::File::create(&path).unwrap();
+        doc.encode_state_as_update_v1_to(&txn, file).unwrap();
+
+        let restored = Doc::with_client_id(2);
+        let mut t2 = restored.transact();
+        unsafe { load_snapshot(&mut t2, &path).unwrap() };
+        assert_eq!(t2.get_text("text").to_string(&t2), "hello world");
+
+        std::fs::write(&path, b"").unwrap();
+        assert!(unsafe { MappedFile::open(&path) }.unwrap().is_empty());
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn update_log_truncates_torn_record() {
+        let dir = temp_dir("update-log-torn");
+        let doc = Doc::with_client_id(1);
+        {
+            let mut log = UpdateLog::open(&dir).unwrap();
+            let mut txn = doc.transact();
+            txn.get_text("text").push(&mut txn, "hello");
+            log.append_transaction(&txn).unwrap();
+            log.close().unwrap();
+        }
+        // simulate a crash in the middle of writing a record
+        let segment = dir.join("log-0");
+        let mut torn = Vec::new();
+        torn.write_buf(&[4; 200]);
+        torn.truncate(100);
+        let mut file = std::fs::OpenOptions::new()
+            .append(true)
+            .open(&segment)
+            .unwrap();
+        std::io::Write::write_all(&mut file, &torn).unwrap();
+        drop(file);
+        {
+            let mut log = UpdateLog::open(&dir).unwrap();
+            let mut txn = doc.transact();
+            txn.get_text("text").push(&mut txn, " world");
+            log.append_transaction(&txn).unwrap();
+            log.close().unwrap();
+        }
+
+        let restored = Doc::with_client_id(2);
+        let mut txn = restored.transact();
+        let mut log = UpdateLog::open(&dir).unwrap();
+        log.load(&mut txn).unwrap();
+        assert_eq!(txn.get_text("text").to_string(&txn), "hello world");
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn update_log_skips_torn_record() {
+        let mut buf = Vec::new();
+        write_record(&mut buf, &[1, 2, 3]);
+        write_record(&mut buf, &[4; 200]);
+        buf.truncate(buf.len() - 1);
+        let mut records = Vec::new();
+        read_records(&buf, &mut records);
+        assert_eq!(records, vec![&[1u8, 2, 3][..]]);
+
+        // record with a complete length prefix followed by garbage
+        let mut buf = Vec::new();
+        write_record(&mut buf, &[1, 2, 3]);
+        buf.write_buf(&[5; 10]);
+        buf.write_u32(0);
+        let mut records = Vec::new();
+        read_records(&buf, &mut records);
+        assert_eq!(records, vec![&[1u8, 2, 3][..]]);
+    }
+
+    #[test]
+    fn update_log_zero_filled_tail() {
+        let dir = temp_dir("update-log-zeros");
+        let doc = Doc::with_client_id(1);
+        {
+            let mut log = UpdateLog::open(&dir).unwrap();
+            let mut txn = doc.transact();
+            txn.get_text("text").push(&mut txn, "hello");
+            log.append_transaction(&txn).unwrap();
+            log.close().unwrap();
+        }
+        // file system may leave a zero-filled tail after a crash
+        let segment = dir.join("log-0");
+        let len = std::fs::metadata(&segment).unwrap().len();
+        let mut file = std::fs::OpenOptions::new()
+            .append(true)
+            .open(&segment)
+            .unwrap();
+        std::io::Write::write_all(&mut file, &[0; 64]).unwrap();
+        drop(file);
+
+        let restored = Doc::with_client_id(2);
+        let mut txn = restored.transact();
+        let mut log = UpdateLog::open(&dir).unwrap();
+        log.load(&mut txn).unwrap();
+        assert_eq!(txn.get_text("text").to_string(&txn), "hello");
+        drop(log);
+        assert_eq!(std::fs::metadata(&segment).unwrap().len(), len);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn update_log_malformed_update() {
+        let dir = temp_dir("update-log-malformed");
+        {
+            let mut log = UpdateLog::open(&dir).unwrap();
+            let e = log.append(&[1, 2, 3]).unwrap_err();
+            assert_eq!(e.kind(), ErrorKind::InvalidData);
+            log.close().unwrap();
+        }
+        assert_eq!(std::fs::metadata(dir.join("log-0")).unwrap().len(), 0);
+
+        // record which matches its checksum, but doesn't contain a valid update
+        let mut buf = Vec::new();
+        write_record(&mut buf, &[1, 2, 3]);
+        std::fs::write(dir.join("log-0"), &buf).unwrap();
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let mut log = UpdateLog::open(&dir).unwrap();
+        let e = log.load(&mut txn).unwrap_err();
+        assert_eq!(e.kind(), ErrorKind::InvalidData);
+        let e = log.compact().and_then(|_| log.wait_for_compaction());
+        assert_eq!(e.unwrap_err().kind(), ErrorKind::InvalidData);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+}
@@ -0,0 +1,1068 @@
+//! Native snapshot format of a document [Store].
+//!
+//! lib0 updates are meant to be exchanged between untrusted peers, therefore applying them
+//! requires running a full block integration with conflict resolution. Native snapshots are
+//! meant for restoring a document state persisted by the same process: they describe a block
+//! store exactly as it was laid out in memory - including resolved left/right neighbors, their
+//! positions within client block lists and the state of every branch node - so that it can be
+//! rebuilt in a single linear pass without integrating any blocks.
+//!
+//! Snapshot is organized in columns: block kinds, neighbor pointers, origins, parents, contents
+//! and branch states are stored in separate sections, each of them being a contiguous sequence
+//! of lib0 encoded values. Client IDs and strings used as map keys or root type names are
+//! written only once and then referred to by their index. Delete set is not stored explicitly,
+//! since it's fully described by the deleted flags of stored blocks.
+//!
+//! Indexed snapshots split these columns into separate groups - one per root type (together
+//! with all of the types nested in it) - and a layout section, which describes the length and
+//! the group of every block. This way a document can be opened by loading only the layout,
+//! while the blocks of each root type are decoded once it's accessed for the first time. Until
+//! then, they are represented in block store by placeholders of the same length.
+
+use crate::block::{
+    Block, BlockPtr, Item, ItemContent, Skip, BLOCK_GC_REF_NUMBER, BLOCK_SKIP_REF_NUMBER, GC, ID,
+};
+use crate::block_store::{BlockStore, ClientBlockList, StateVector};
+use crate::id_set::DeleteSet;
+use crate::store::Store;
+use crate::types::{Branch, TypePtr};
+use crate::update::{PendingUpdate, Update};
+use crate::updates::decoder::{Decode, DecoderV1};
+use crate::updates::encoder::{Encode, Encoder, EncoderV1};
+use crate::utils::client_hasher::ClientHasher;
+use crate::utils::interner::StringInterner;
+use lib0::decoding::{Cursor, Read};
+use lib0::encoding::Write;
+use std::collections::HashMap;
+use std::hash::BuildHasherDefault;
+use std::ops::Range;
+use std::rc::Rc;
+
+/// Magic bytes at the beginning of every native snapshot.
+const MAGIC: &[u8; 4] = b"YRSS";
+
+/// Magic bytes at the beginning of every indexed snapshot.
+const INDEXED_MAGIC: &[u8; 4] = b"YRSI";
+
+/// Version of a native snapshot format. Snapshots are not guaranteed to be readable by other
+/// versions.
+const VERSION: u8 = 1;
+
+const SHAPE_LEFT: u8 = 0b0000_0001;
+const SHAPE_RIGHT: u8 = 0b0000_0010;
+const SHAPE_ORIGIN: u8 = 0b0000_0100;
+const SHAPE_RIGHT_ORIGIN: u8 = 0b0000_1000;
+const SHAPE_PARENT_SUB: u8 = 0b0001_0000;
+const SHAPE_PARENT_ID: u8 = 0b0010_0000;
+const SHAPE_PARENT_NAMED: u8 = 0b0100_0000;
+
+const HAS_PENDING: u8 = 0b01;
+const HAS_PENDING_DS: u8 = 0b10;
+
+/// Group of blocks, which are loaded eagerly from an indexed snapshot, eg. garbage collected
+/// blocks, which don't belong to any root type.
+const EAGER_GROUP: usize = 0;
+
+/// Encodes a given `store` using a native snapshot format.
+pub(crate) fn encode(store: &Store) -> Vec<u8> {
+    materialize(store, None);
+    let mut encoder = SnapshotEncoder::new(store, 1);
+    encoder.groups[0].roots.write_uvar(store.types.len());
+    for (name, branch) in store.types.iter() {
+        let inner = branch.borrow();
+        encoder.write_root(Column::Roots, 0, name, &inner);
+        encoder.write_branch(Column::Roots, 0, &inner);
+    }
+    for i in 0..encoder.block_clients {
+        let blocks = store.blocks.get(&encoder.client_ids[i]).unwrap();
+        for j in 0..blocks.integrated_len() {
+            encoder.write_block(0, &blocks[j]);
+        }
+    }
+    encoder.finish(MAGIC, |encoder, out| {
+        let group = encoder.groups.pop().unwrap();
+        group.write_to(out);
+    })
+}
+
+/// Encodes a given `store` using an indexed snapshot format, which can be loaded lazily using
+/// [load_indexed].
+pub(crate) fn encode_indexed(store: &Store) -> Vec<u8> {
+    materialize(store, None);
+    let mut root_groups: HashMap<&str, usize> = HashMap::with_capacity(store.types.len());
+    for (i, name) in store.types.keys().enumerate() {
+        root_groups.insert(name, i + 1);
+    }
+    let mut encoder = SnapshotEncoder::new(store, store.types.len() + 1);
+    let owners = encoder.owners(&root_groups);
+
+    encoder.groups[EAGER_GROUP]
+        .roots
+        .write_uvar(store.types.len());
+    for (name, branch) in store.types.iter() {
+        let group = root_groups[name.as_ref()];
+        let inner = branch.borrow();
+        encoder.write_root(Column::Roots, EAGER_GROUP, name, &inner);
+        encoder.write_branch(Column::Roots, group, &inner);
+    }
+    // root descriptors are needed up front, before any group is loaded
+    let roots = std::mem::replace(&mut encoder.groups[EAGER_GROUP].roots, EncoderV1::new());
+
+    let mut layout = EncoderV1::new();
+    for i in 0..encoder.block_clients {
+        let blocks = store.blocks.get(&encoder.client_ids[i]).unwrap();
+        for j in 0..blocks.integrated_len() {
+            let block = &blocks[j];
+            let group = owners[i][j] as usize;
+            layout.write_uvar(group);
+            if group != EAGER_GROUP {
+                layout.write_uvar(block.len());
+                layout.write_u8(block.is_deleted() as u8);
+            }
+            encoder.write_block(group, block);
+        }
+    }
+
+    encoder.finish(INDEXED_MAGIC, |encoder, out| {
+        out.write_buf(roots.to_vec());
+        out.write_buf(layout.to_vec());
+        out.write_uvar(encoder.groups.len());
+        for group in encoder.groups.drain(..) {
+            let mut buf = EncoderV1::new();
+            group.write_to(&mut buf);
+            out.write_buf(buf.to_vec());
+        }
+    })
+}
+
+/// Restores a state of a given `store` from a native snapshot produced by [encode]. Store must
+/// not contain any blocks. Root types, which were already defined in a `store`, are reused.
+///
+/// Since snapshots are expected to come from a trusted source, this function panics when
+/// a snapshot is malformed.
+pub(crate) fn load(store: &mut Store, snapshot: &[u8]) {
+    let mut header = open(store, snapshot, MAGIC);
+    let tables = Tables::read(&mut header, &mut store.interner);
+    let mut decoder = SnapshotDecoder {
+        clients: &tables.clients,
+        keys: &tables.keys,
+        columns: Columns::read(&mut header),
+    };
+
+    let roots_len: usize = decoder.columns.roots.read_uvar();
+    for _ in 0..roots_len {
+        let (name, node_name, type_ref) = decoder.read_root(Column::Roots);
+        let branch = store.init_type_ref(name, node_name, type_ref);
+        let mut inner = branch.borrow_mut();
+        decoder.read_branch(Column::Roots, &mut inner);
+    }
+
+    let mut blocks = HashMap::with_capacity_and_hasher(tables.lists.len(), Default::default());
+    for (i, &(len, mut clock)) in tables.lists.iter().enumerate() {
+        let client = tables.clients[i];
+        let mut list = ClientBlockList::with_capacity(len);
+        for pivot in 0..len {
+            let block = decoder.read_block(ID::new(client, clock), pivot as u32);
+            clock += block.len();
+            list.push(block);
+        }
+        blocks.insert(client, list);
+    }
+    store.blocks = BlockStore::from(blocks);
+    read_pending(store, &snapshot[header.next..]);
+}
+
+/// Restores a state of a given `store` from an indexed snapshot produced by [encode_indexed].
+/// Only blocks, which don't belong to any root type are decoded right away. Blocks of every root
+/// type are decoded once it's accessed for the first time (see: [materialize]).
+///
+/// Store must not contain any blocks. Root types, which were already defined in a `store`, are
+/// reused.
+pub(crate) fn load_indexed(store: &mut Store, snapshot: Vec<u8>) {
+    let mut header = open(store, &snapshot, INDEXED_MAGIC);
+    let tables = Tables::read(&mut header, &mut store.interner);
+    let mut descriptors = read_section(&mut header);
+    let mut layout = read_section(&mut header);
+    let groups_len: usize = header.read_uvar();
+    let mut groups = Vec::with_capacity(groups_len);
+    for _ in 0..groups_len {
+        let len: usize = header.read_uvar();
+        groups.push(header.next..header.next + len);
+        header.next += len;
+    }
+
+    let mut decoder = SnapshotDecoder {
+        clients: &tables.clients,
+        keys: &tables.keys,
+        columns: Columns::read(&mut Cursor::new(&snapshot[groups[EAGER_GROUP].clone()])),
+    };
+    let roots_len: usize = descriptors.read_uvar();
+    let mut root_names = Vec::with_capacity(roots_len);
+    for _ in 0..roots_len {
+        let (name, node_name, type_ref) = decoder.read_root_from(&mut descriptors);
+        store.init_type_ref(name.clone(), node_name, type_ref);
+        root_names.push(name);
+    }
+    let mut lazy_blocks: Vec<Vec<(u32, u32)>> = vec![Vec::new(); roots_len];
+
+    let mut blocks = HashMap::with_capacity_and_hasher(tables.lists.len(), Default::default());
+    for (i, &(len, mut clock)) in tables.lists.iter().enumerate() {
+        let client = tables.clients[i];
+        let mut list = ClientBlockList::with_capacity(len);
+        for pivot in 0..len {
+            let id = ID::new(client, clock);
+            let group: usize = layout.read_uvar();
+            let block = if group == EAGER_GROUP {
+                decoder.read_block(id, pivot as u32)
+            } else {
+                lazy_blocks[group - 1].push((i as u32, clock));
+                let len: u32 = layout.read_uvar();
+                if layout.read_u8() != 0 {
+                    // deleted blocks are already treated by the store as garbage collected
+                    Block::GC(GC::new(id, len))
+                } else {
+                    Block::Skip(Skip::new(id, len))
+                }
+            };
+            clock += block.len();
+            list.push(block);
+        }
+        blocks.insert(client, list);
+    }
+    store.blocks = BlockStore::from(blocks);
+    read_pending(store, &snapshot[header.next..]);
+
+    let roots = root_names
+        .into_iter()
+        .zip(lazy_blocks.into_iter())
+        .enumerate()
+        .map(|(i, (name, blocks))| {
+            let group = groups[i + 1].clone();
+            (name, LazyRoot { group, blocks })
+        })
+        .collect();
+    let Tables { clients, keys, .. } = tables;
+    *store.lazy.borrow_mut() = Some(LazySnapshot {
+        data: snapshot.into_boxed_slice(),
+        clients,
+        keys,
+        roots,
+    });
+}
+
+/// Decodes blocks of a root type `name` loaded from an indexed snapshot, if it has not been
+/// decoded yet. If `name` is not provided, all remaining root types are decoded.
+pub(crate) fn materialize(store: &Store, name: Option<&str>) {
+    let mut lazy = store.lazy.borrow_mut();
+    if let Some(snapshot) = lazy.as_mut() {
+        match name {
+            Some(name) => {
+                if let Some(root) = snapshot.roots.remove(name) {
+                    snapshot.materialize(store, name, root);
+                }
+            }
+            None => {
+                for (name, root) in std::mem::take(&mut snapshot.roots) {
+                    snapshot.materialize(store, &name, root);
+                }
+            }
+        }
+        if snapshot.roots.is_empty() {
+            *lazy = None;
+        }
+    }
+}
+
+/// State of a document loaded from an indexed snapshot, which root types have not been all
+/// accessed yet.
+pub(crate) struct LazySnapshot {
+    data: Box<[u8]>,
+    clients: Vec<u64>,
+    keys: Vec<Rc<str>>,
+    roots: HashMap<Rc<str>, LazyRoot>,
+}
+
+/// A root type, which blocks have not been decoded yet.
+struct LazyRoot {
+    /// A range of snapshot bytes containing columns of this root's blocks.
+    group: Range<usize>,
+    /// Client indexes and clocks of placeholders to be replaced by decoded blocks. Placeholders
+    /// are located by their IDs, since positions of blocks within client block lists change
+    /// once other (already decoded) root types are edited.
+    blocks: Vec<(u32, u32)>,
+}
+
+impl LazySnapshot {
+    fn materialize(&self, store: &Store, name: &str, root: LazyRoot) {
+        let mut decoder = SnapshotDecoder {
+            clients: &self.clients,
+            keys: &self.keys,
+            columns: Columns::read(&mut Cursor::new(&self.data[root.group])),
+        };
+        if let Some(branch) = store.types.get(name) {
+            decoder.read_branch(Column::Roots, &mut branch.borrow_mut());
+        }
+        for (client, clock) in root.blocks {
+            let blocks = store.blocks.get(&self.clients[client as usize]).unwrap();
+            let pivot = blocks.find_pivot(clock).unwrap();
+            let placeholder = blocks.get_mut(pivot);
+            debug_assert_eq!(placeholder.id().clock, clock);
+            let block = decoder.read_block(*placeholder.id(), pivot as u32);
+            *placeholder = block;
+        }
+    }
+}
+
+/// Checks snapshot header and returns a cursor positioned right after it.
+fn open<'a>(store: &Store, snapshot: &'a [u8], magic: &[u8; 4]) -> Cursor<'a> {
+    assert!(
+        store.blocks.is_empty()
+            && store.pending.is_none()
+            && store.pending_ds.is_none()
+            && store.lazy.borrow().is_none(),
+        "native snapshot can only be loaded into an empty document"
+    );
+    assert!(
+        snapshot.starts_with(magic),
+        "cannot load native snapshot: invalid header"
+    );
+    let mut header = Cursor::new(snapshot);
+    header.next = magic.len();
+    let version = header.read_u8();
+    assert_eq!(
+        version, VERSION,
+        "cannot load native snapshot: unsupported version"
+    );
+    header
+}
+
+fn read_pending(store: &mut Store, tail: &[u8]) {
+    let mut decoder = DecoderV1::from(tail);
+    let flags = decoder.read_u8();
+    if flags & HAS_PENDING != 0 {
+        let update = Update::decode(&mut decoder);
+        let missing = StateVector::decode(&mut decoder);
+        store.pending = Some(PendingUpdate { update, missing });
+    }
+    if flags & HAS_PENDING_DS != 0 {
+        store.pending_ds = Some(DeleteSet::decode(&mut decoder));
+    }
+}
+
+/// Reads a length-prefixed section and returns a decoder over it.
+fn read_section<'a>(cursor: &mut Cursor<'a>) -> DecoderV1<'a> {
+    let len: usize = cursor.read_uvar();
+    let buf = cursor.buf;
+    let section = &buf[cursor.next..cursor.next + len];
+    cursor.next += len;
+    DecoderV1::from(section)
+}
+
+/// Client and string tables shared by all columns of a snapshot.
+struct Tables {
+    clients: Vec<u64>,
+    /// Length and starting clock of block lists of the first clients in `clients` table.
+    lists: Vec<(usize, u32)>,
+    keys: Vec<Rc<str>>,
+}
+
+impl Tables {
+    fn read(cursor: &mut Cursor, interner: &mut StringInterner) -> Self {
+        let clients_len: usize = cursor.read_uvar();
+        let block_clients: usize = cursor.read_uvar();
+        let mut clients = Vec::with_capacity(clients_len);
+        let mut lists = Vec::with_capacity(block_clients);
+        for i in 0..clients_len {
+            clients.push(cursor.read_uvar());
+            if i < block_clients {
+                let len: usize = cursor.read_uvar();
+                let clock: u32 = cursor.read_uvar();
+                lists.push((len, clock));
+            }
+        }
+        let keys_len: usize = cursor.read_uvar();
+        let mut keys = Vec::with_capacity(keys_len);
+        for _ in 0..keys_len {
+            keys.push(interner.intern(cursor.read_string()));
+        }
+        Tables {
+            clients,
+            lists,
+            keys,
+        }
+    }
+}
+
+#[derive(Clone, Copy)]
+enum Column {
+    Roots,
+    Links,
+    Origins,
+    Parents,
+    Branches,
+}
+
+/// A group of columns describing a subset of blocks.
+struct Columns<T> {
+    roots: T,
+    kinds: T,
+    lens: T,
+    shapes: T,
+    links: T,
+    origins: T,
+    parents: T,
+    contents: T,
+    branches: T,
+}
+
+impl<T> Columns<T> {
+    fn column(&mut self, column: Column) -> &mut T {
+        match column {
+            Column::Roots => &mut self.roots,
+            Column::Links => &mut self.links,
+            Column::Origins => &mut self.origins,
+            Column::Parents => &mut self.parents,
+            Column::Branches => &mut self.branches,
+        }
+    }
+}
+
+impl Columns<EncoderV1> {
+    fn new() -> Self {
+        Columns {
+            roots: EncoderV1::new(),
+            kinds: EncoderV1::new(),
+            lens: EncoderV1::new(),
+            shapes: EncoderV1::new(),
+            links: EncoderV1::new(),
+            origins: EncoderV1::new(),
+            parents: EncoderV1::new(),
+            contents: EncoderV1::new(),
+            branches: EncoderV1::new(),
+        }
+    }
+
+    fn write_to(self, out: &mut EncoderV1) {
+        let columns = [
+            self.roots,
+            self.kinds,
+            self.lens,
+            self.shapes,
+            self.links,
+            self.origins,
+            self.parents,
+            self.contents,
+            self.branches,
+        ];
+        for column in columns {
+            out.write_buf(column.to_vec());
+        }
+    }
+}
+
+impl<'a> Columns<DecoderV1<'a>> {
+    fn read(cursor: &mut Cursor<'a>) -> Self {
+        Columns {
+            roots: read_section(cursor),
+            kinds: read_section(cursor),
+            lens: read_section(cursor),
+            shapes: read_section(cursor),
+            links: read_section(cursor),
+            origins: read_section(cursor),
+            parents: read_section(cursor),
+            contents: read_section(cursor),
+            branches: read_section(cursor),
+        }
+    }
+}
+
+struct SnapshotEncoder<'a> {
+    store: &'a Store,
+    client_ids: Vec<u64>,
+    /// Number of clients at the beginning of `client_ids`, which own blocks.
+    block_clients: usize,
+    clients: HashMap<u64, u32, BuildHasherDefault<ClientHasher>>,
+    key_list: Vec<Rc<str>>,
+    keys: HashMap<Rc<str>, u32>,
+    groups: Vec<Columns<EncoderV1>>,
+}
+
+impl<'a> SnapshotEncoder<'a> {
+    fn new(store: &'a Store, groups: usize) -> Self {
+        let mut client_ids: Vec<u64> = store.blocks.iter().map(|(&client, _)| client).collect();
+        client_ids.sort();
+        let clients = client_ids
+            .iter()
+            .enumerate()
+            .map(|(i, &client)| (client, i as u32))
+            .collect();
+        SnapshotEncoder {
+            store,
+            block_clients: client_ids.len(),
+            client_ids,
+            clients,
+            key_list: Vec::new(),
+            keys: HashMap::new(),
+            groups: (0..groups).map(|_| Columns::new()).collect(),
+        }
+    }
+
+    /// Returns an index of a given `client` in a snapshot client table.
+    fn client(&mut self, client: u64) -> u32 {
+        let client_ids = &mut self.client_ids;
+        *self.clients.entry(client).or_insert_with(|| {
+            client_ids.push(client);
+            client_ids.len() as u32 - 1
+        })
+    }
+
+    /// Returns an index of a given `key` in a snapshot string table.
+    fn key(&mut self, key: &Rc<str>) -> u32 {
+        let key_list = &mut self.key_list;
+        *self.keys.entry(key.clone()).or_insert_with(|| {
+            key_list.push(key.clone());
+            key_list.len() as u32 - 1
+        })
+    }
+
+    /// Returns a position of a block pointed by `ptr` within its client block list. Pointers
+    /// kept by a live store are not always precise, while a snapshot must store exact ones.
+    fn pivot(&self, ptr: &BlockPtr) -> u32 {
+        if let Some(blocks) = self.store.blocks.get(&{ ptr.id.client }) {
+            match blocks.try_get(ptr.pivot()) {
+                Some(block) if block.contains(&ptr.id) => return ptr.pivot() as u32,
+                _ => {
+                    if let Some(pivot) = blocks.find_pivot(ptr.id.clock) {
+                        return pivot as u32;
+                    }
+                }
+            }
+        }
+        ptr.pivot() as u32
+    }
+
+    /// Assigns every block to a group of a root type it belongs to, following the chain of its
+    /// parents. Blocks that don't belong to any root type are assigned to [EAGER_GROUP].
+    fn owners(&self, root_groups: &HashMap<&str, usize>) -> Vec<Vec<u32>> {
+        const UNKNOWN: u32 = u32::MAX;
+        let store = self.store;
+        let mut owners: Vec<Vec<u32>> = self.client_ids[..self.block_clients]
+            .iter()
+            .map(|client| vec![UNKNOWN; store.blocks.get(client).unwrap().integrated_len()])
+            .collect();
+        let mut chain = Vec::new();
+        for i in 0..self.block_clients {
+            for j in 0..owners[i].len() {
+                let (mut client, mut pivot) = (i, j);
+                let group = loop {
+                    if owners[client][pivot] != UNKNOWN {
+                        break owners[client][pivot];
+                    }
+                    chain.push((client, pivot));
+                    let blocks = store.blocks.get(&self.client_ids[client]).unwrap();
+                    let parent = match &blocks[pivot] {
+                        Block::Item(item) => &item.parent,
+                        _ => break EAGER_GROUP as u32,
+                    };
+                    match parent {
+                        TypePtr::Named(name) => {
+                            break root_groups.get(name.as_ref()).cloned().unwrap_or(0) as u32
+                        }
+                        TypePtr::Id(ptr) => match self.clients.get(&{ ptr.id.client }) {
+                            Some(&c) if (c as usize) < self.block_clients => {
+                                client = c as usize;
+                                pivot = self.pivot(ptr) as usize;
+                            }
+                            _ => break EAGER_GROUP as u32,
+                        },
+                        TypePtr::Unknown => break EAGER_GROUP as u32,
+                    }
+                };
+                for (client, pivot) in chain.drain(..) {
+                    owners[client][pivot] = group;
+                }
+            }
+        }
+        owners
+    }
+
+    fn write_id(&mut self, column: Column, group: usize, id: &ID) {
+        let client = self.client(id.client);
+        let encoder = self.groups[group].column(column);
+        encoder.write_uvar(client);
+        encoder.write_uvar(id.clock);
+    }
+
+    fn write_ptr(&mut self, column: Column, group: usize, ptr: &BlockPtr) {
+        let pivot = self.pivot(ptr);
+        self.write_id(column, group, &ptr.id);
+        self.groups[group].column(column).write_uvar(pivot);
+    }
+
+    fn write_key(&mut self, column: Column, group: usize, key: &Rc<str>) {
+        let key = self.key(key);
+        self.groups[group].column(column).write_uvar(key);
+    }
+
+    /// Writes a name and type of a root type.
+    fn write_root(&mut self, column: Column, group: usize, name: &Rc<str>, branch: &Branch) {
+        self.write_key(column, group, name);
+        let encoder = self.groups[group].column(column);
+        encoder.write_u8(branch.type_ref());
+        match branch.name.as_ref() {
+            Some(node_name) => {
+                encoder.write_u8(1);
+                encoder.write_string(node_name);
+            }
+            None => encoder.write_u8(0),
+        }
+    }
+
+    fn write_branch(&mut self, column: Column, group: usize, branch: &Branch) {
+        self.groups[group].column(column).write_uvar(branch.len);
+        match branch.start.as_ref() {
+            Some(start) => {
+                self.groups[group].column(column).write_u8(1);
+                self.write_ptr(column, group, start);
+            }
+            None => self.groups[group].column(column).write_u8(0),
+        }
+        self.groups[group]
+            .column(column)
+            .write_uvar(branch.map.len());
+        for (key, ptr) in branch.map.iter() {
+            self.write_key(column, group, key);
+            self.write_ptr(column, group, ptr);
+        }
+    }
+
+    fn write_block(&mut self, group: usize, block: &Block) {
+        match block {
+            Block::GC(gc) => {
+                let columns = &mut self.groups[group];
+                columns.kinds.write_u8(BLOCK_GC_REF_NUMBER << 4);
+                columns.lens.write_uvar(gc.len);
+            }
+            Block::Skip(skip) => {
+                let columns = &mut self.groups[group];
+                columns.kinds.write_u8(BLOCK_SKIP_REF_NUMBER << 4);
+                columns.lens.write_uvar(skip.len);
+            }
+            Block::Item(item) => {
+                let ref_number = item.content.get_ref_number();
+                self.groups[group]
+                    .kinds
+                    .write_u8(ref_number << 4 | (item.info & 0b1111));
+                let mut shape = 0;
+                if let Some(left) = item.left.as_ref() {
+                    shape |= SHAPE_LEFT;
+                    self.write_ptr(Column::Links, group, left);
+                }
+                if let Some(right) = item.right.as_ref() {
+                    shape |= SHAPE_RIGHT;
+                    self.write_ptr(Column::Links, group, right);
+                }
+                if let Some(origin) = item.origin.as_ref() {
+                    shape |= SHAPE_ORIGIN;
+                    self.write_id(Column::Origins, group, origin);
+                }
+                if let Some(right_origin) = item.right_origin.as_ref() {
+                    shape |= SHAPE_RIGHT_ORIGIN;
+                    self.write_id(Column::Origins, group, right_origin);
+                }
+                match &item.parent {
+                    TypePtr::Id(ptr) => {
+                        shape |= SHAPE_PARENT_ID;
+                        self.write_ptr(Column::Parents, group, ptr);
+                    }
+                    TypePtr::Named(name) => {
+                        shape |= SHAPE_PARENT_NAMED;
+                        self.write_key(Column::Parents, group, name);
+                    }
+                    TypePtr::Unknown => panic!("Couldn't get item's parent"),
+                }
+                if let Some(parent_sub) = item.parent_sub.as_ref() {
+                    shape |= SHAPE_PARENT_SUB;
+                    self.write_key(Column::Parents, group, parent_sub);
+                }
+                let columns = &mut self.groups[group];
+                columns.shapes.write_u8(shape);
+                item.content.encode(&mut columns.contents);
+                if let ItemContent::Type(branch) = &item.content {
+                    self.write_branch(Column::Branches, group, &branch.borrow());
+                }
+            }
+        }
+    }
+
+    /// Writes snapshot header and tables, followed by the sections written by `write_body`
+    /// and pending updates.
+    fn finish<F>(mut self, magic: &[u8; 4], write_body: F) -> Vec<u8>
+    where
+        F: FnOnce(&mut Self, &mut EncoderV1),
+    {
+        let store = self.store;
+        let mut out = EncoderV1::new();
+        out.write(magic);
+        out.write_u8(VERSION);
+
+        out.write_uvar(self.client_ids.len());
+        out.write_uvar(self.block_clients);
+        for (i, &client) in self.client_ids.iter().enumerate() {
+            out.write_uvar(client);
+            if i < self.block_clients {
+                let blocks = store.blocks.get(&client).unwrap();
+                out.write_uvar(blocks.integrated_len());
+                out.write_uvar(blocks.first().id().clock);
+            }
+        }
+        out.write_uvar(self.key_list.len());
+        for key in self.key_list.iter() {
+            out.write_string(key);
+        }
+
+        write_body(&mut self, &mut out);
+
+        let mut flags = 0;
+        if store.pending.is_some() {
+            flags |= HAS_PENDING;
+        }
+        if store.pending_ds.is_some() {
+            flags |= HAS_PENDING_DS;
+        }
+        out.write_u8(flags);
+        if let Some(pending) = store.pending.as_ref() {
+            pending.update.encode(&mut out);
+            pending.missing.encode(&mut out);
+        }
+        if let Some(pending_ds) = store.pending_ds.as_ref() {
+            pending_ds.encode(&mut out);
+        }
+        out.to_vec()
+    }
+}
+
+struct SnapshotDecoder<'a> {
+    clients: &'a [u64],
+    keys: &'a [Rc<str>],
+    columns: Columns<DecoderV1<'a>>,
+}
+
+impl<'a> SnapshotDecoder<'a> {
+    fn read_id(&mut self, column: Column) -> ID {
+        let decoder = self.columns.column(column);
+        let client: usize = decoder.read_uvar();
+        let clock: u32 = decoder.read_uvar();
+        ID::new(self.clients[client], clock)
+    }
+
+    fn read_ptr(&mut self, column: Column) -> BlockPtr {
+        let id = self.read_id(column);
+        BlockPtr::new(id, self.columns.column(column).read_uvar())
+    }
+
+    fn read_key(&mut self, column: Column) -> Rc<str> {
+        let key: usize = self.columns.column(column).read_uvar();
+        self.keys[key].clone()
+    }
+
+    /// Reads a name, node name and type ref of a root type.
+    fn read_root(&mut self, column: Column) -> (Rc<str>, Option<String>, u8) {
+        let keys = self.keys;
+        Self::read_root_with(keys, self.columns.column(column))
+    }
+
+    fn read_root_from(&self, decoder: &mut DecoderV1) -> (Rc<str>, Option<String>, u8) {
+        Self::read_root_with(self.keys, decoder)
+    }
+
+    fn read_root_with(keys: &[Rc<str>], decoder: &mut DecoderV1) -> (Rc<str>, Option<String>, u8) {
+        let name = keys[decoder.read_uvar::<usize>()].clone();
+        let type_ref = decoder.read_u8();
+        let node_name = if decoder.read_u8() != 0 {
+            Some(decoder.read_string().to_owned())
+        } else {
+            None
+        };
+        (name, node_name, type_ref)
+    }
+
+    fn read_branch(&mut self, column: Column, branch: &mut Branch) {
+        assert!(
+            branch.start.is_none() && branch.map.is_empty(),
+            "native snapshot can only be loaded into an empty document"
+        );
+        branch.len = self.columns.column(column).read_uvar();
+        if self.columns.column(column).read_u8() != 0 {
+            branch.start = Some(self.read_ptr(column));
+        }
+        let map_len: usize = self.columns.column(column).read_uvar();
+        branch.map.reserve(map_len);
+        for _ in 0..map_len {
+            let key = self.read_key(column);
+            let ptr = self.read_ptr(column);
+            branch.map.insert(key, ptr);
+        }
+    }
+
+    fn read_block(&mut self, id: ID, pivot: u32) -> Block {
+        let kind = self.columns.kinds.read_u8();
+        let ref_number = kind >> 4;
+        match ref_number {
+            BLOCK_GC_REF_NUMBER => Block::GC(GC::new(id, self.columns.lens.read_uvar())),
+            BLOCK_SKIP_REF_NUMBER => Block::Skip(Skip::new(id, self.columns.lens.read_uvar())),
+            _ => {
+                let shape = self.columns.shapes.read_u8();
+                let left = if shape & SHAPE_LEFT != 0 {
+                    Some(self.read_ptr(Column::Links))
+                } else {
+                    None
+                };
+                let right = if shape & SHAPE_RIGHT != 0 {
+                    Some(self.read_ptr(Column::Links))
+                } else {
+                    None
+                };
+                let origin = if shape & SHAPE_ORIGIN != 0 {
+                    Some(self.read_id(Column::Origins))
+                } else {
+                    None
+                };
+                let right_origin = if shape & SHAPE_RIGHT_ORIGIN != 0 {
+                    Some(self.read_id(Column::Origins))
+                } else {
+                    None
+                };
+                let parent = if shape & SHAPE_PARENT_ID != 0 {
+                    TypePtr::Id(self.read_ptr(Column::Parents))
+                } else if shape & SHAPE_PARENT_NAMED != 0 {
+                    TypePtr::Named(self.read_key(Column::Parents))
+                } else {
+                    panic!("cannot load native snapshot: item {:?} has no parent", id)
+                };
+                let parent_sub = if shape & SHAPE_PARENT_SUB != 0 {
+                    Some(self.read_key(Column::Parents))
+                } else {
+                    None
+                };
+                let ptr = BlockPtr::new(id, pivot);
+                let content = ItemContent::decode(&mut self.columns.contents, ref_number, ptr);
+                if let ItemContent::Type(branch) = &content {
+                    let mut inner = branch.borrow_mut();
+                    inner.item = Some(ptr);
+                    self.read_branch(Column::Branches, &mut inner);
+                }
+                let mut item = Item::new(
+                    id,
+                    left,
+                    origin,
+                    right,
+                    right_origin,
+                    parent,
+                    parent_sub,
+                    content,
+                );
+                item.info = kind & 0b1111;
+                Block::Item(item)
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::block_store::StateVector;
+    use crate::updates::decoder::Decode;
+    use crate::{Doc, PrelimMap, Update};
+    use lib0::any::Any;
+    use std::collections::HashMap;
+
+    #[test]
+    fn native_snapshot_roundtrip() {
+        let d1 = Doc::with_client_id(1);
+        {
+            let mut t1 = d1.transact();
+            let txt = t1.get_text("text");
+            txt.insert(&mut t1, 0, "hello zażółć gęślą jaźń");
+            txt.remove_range(&mut t1, 2, 3);
+
+            let map = t1.get_map("map");
+            map.insert(&mut t1, "string".to_owned(), "value");
+            map.insert(&mut t1, "buf".to_owned(), vec![1u8, 2, 3]);
+            let mut nested = HashMap::new();
+            nested.insert("key".to_owned(), Any::Bool(true));
+            map.insert(&mut t1, "nested".to_owned(), PrelimMap::from(nested));
+            map.insert(&mut t1, "string".to_owned(), -300);
+
+            let array = t1.get_array("array");
+            array.insert_range(&mut t1, 0, vec![1, 2, 3, 4]);
+            array.remove_range(&mut t1, 1, 2);
+
+            let xml = t1.get_xml_element("xml");
+            let p = xml.push_elem_back(&mut t1, "p");
+            p.insert_attribute(&mut t1, "class", "paragraph");
+
+            let remote = Doc::with_client_id(2);
+            let mut remote_txn = remote.transact();
+            remote_txn
+                .get_text("text")
+                .insert(&mut remote_txn, 0, "remote ");
+            let update = remote.encode_state_as_update_v1(&remote_txn);
+            d1.apply_update_v1(&mut t1, &update);
+        }
+        let mut t1 = d1.transact();
+        let snapshot = t1.encode_native_snapshot();
+
+        let d2 = Doc::with_client_id(3);
+        let mut t2 = d2.transact();
+        let txt = t2.get_text("text"); // root types defined up front are reused
+        t2.load_native_snapshot(&snapshot);
+        assert_eq!(t2.store.blocks, t1.store.blocks);
+        assert_eq!(txt.to_string(&t2), "heremote  zażółć gęślą jaźń");
+        assert_eq!(
+            t2.get_map("map").to_json(&t2),
+            t1.get_map("map").to_json(&t1)
+        );
+        assert_eq!(
+            t2.get_array("array").to_json(&t2),
+            t1.get_array("array").to_json(&t1)
+        );
+        assert_eq!(
+            t2.get_xml_element("xml").to_string(&t2),
+            t1.get_xml_element("xml").to_string(&t1)
+        );
+
+        // loaded document can be edited and synchronized just like the original one
+        txt.insert(&mut t2, 2, "llo");
+        t2.get_map("map")
+            .insert(&mut t2, "string".to_owned(), "new");
+        let update = d2.encode_delta_as_update_v1(&t2, &t1.state_vector());
+        t1.apply_update(Update::decode_v1(&update));
+        assert_eq!(
+            t1.get_text("text").to_string(&t1),
+            "helloremote  zażółć gęślą jaźń"
+        );
+        assert_eq!(
+            t1.get_map("map").to_json(&t1),
+            t2.get_map("map").to_json(&t2)
+        );
+    }
+
+    #[test]
+    fn indexed_snapshot_lazy_roots() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let txt = t1.get_text("text");
+        txt.insert(&mut t1, 0, "hello world");
+        txt.remove_range(&mut t1, 5, 6);
+        let map = t1.get_map("map");
+        let mut nested = HashMap::new();
+        nested.insert("key".to_owned(), Any::Bool(true));
+        map.insert(&mut t1, "nested".to_owned(), PrelimMap::from(nested));
+        map.insert(&mut t1, "string".to_owned(), "value");
+        let array = t1.get_array("array");
+        array.insert_range(&mut t1, 0, vec![1, 2, 3]);
+        t1.commit();
+        let snapshot = t1.encode_indexed_snapshot();
+
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        t2.load_indexed_snapshot(snapshot);
+        assert_eq!(t2.state_vector(), t1.state_vector());
+        assert_eq!(t2.get_text("text").to_string(&t2), "hello");
+        {
+            // only accessed root types have been materialized
+            let lazy = t2.store.lazy.borrow();
+            let roots = &lazy.as_ref().unwrap().roots;
+            assert!(!roots.contains_key("text"));
+            assert!(roots.contains_key("map") && roots.contains_key("array"));
+        }
+        assert_eq!(
+            t2.get_map("map").to_json(&t2),
+            t1.get_map("map").to_json(&t1)
+        );
+
+        // encoding loads remaining root types
+        let update = t2.encode_diff_v1(&StateVector::default());
+        assert!(t2.store.lazy.borrow().is_none());
+        assert_eq!(t2.store.blocks, t1.store.blocks);
+
+        let d3 = Doc::with_client_id(3);
+        let mut t3 = d3.transact();
+        t3.apply_update(Update::decode_v1(&update));
+        assert_eq!(
+            t3.get_array("array").to_json(&t3),
+            t1.get_array("array").to_json(&t1)
+        );
+
+        // loaded document can be edited and synchronized just like the original one
+        let d4 = Doc::with_client_id(4);
+        let mut t4 = d4.transact();
+        t4.load_indexed_snapshot(t1.encode_indexed_snapshot());
+        let txt = t4.get_text("text");
+        txt.insert(&mut t4, 5, " there");
+        t4.commit();
+        let update = t4.encode_diff_v1(&t1.state_vector());
+        t1.apply_update(Update::decode_v1(&update));
+        assert_eq!(t1.get_text("text").to_string(&t1), "hello there");
+    }
+
+    #[test]
+    fn indexed_snapshot_edit_before_materialize() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        t1.get_text("a").insert(&mut t1, 0, "abcdef");
+        t1.get_text("b").insert(&mut t1, 0, "xyz");
+        let c = t1.get_text("c");
+        c.insert(&mut t1, 0, "uvw");
+        c.remove_range(&mut t1, 1, 1);
+        t1.commit();
+
+        // editing one root type splits blocks, which shifts positions of placeholders of others
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        t2.load_indexed_snapshot(t1.encode_indexed_snapshot());
+        let a = t2.get_text("a");
+        a.insert(&mut t2, 2, "Q");
+        a.remove_range(&mut t2, 4, 1);
+        t2.commit();
+        assert_eq!(t2.get_text("b").to_string(&t2), "xyz");
+        assert_eq!(t2.get_text("a").to_string(&t2), "abQcef");
+        assert_eq!(t2.get_text("c").to_string(&t2), "uw");
+
+        let update = t2.encode_diff_v1(&t1.state_vector());
+        t1.apply_update(Update::decode_v1(&update));
+        assert_eq!(t1.get_text("a").to_string(&t1), "abQcef");
+        assert_eq!(t1.get_text("b").to_string(&t1), "xyz");
+    }
+
+    #[test]
+    fn indexed_snapshot_keeps_placeholders_on_squash() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let mut nested = HashMap::new();
+        nested.insert("key".to_owned(), Any::Bool(true));
+        let a = t1.get_array("a");
+        a.insert(&mut t1, 0, PrelimMap::from(nested));
+        let b = t1.get_text("b");
+        b.insert(&mut t1, 0, "xyz");
+        b.remove_range(&mut t1, 0, 1);
+        t1.commit();
+
+        // deleting a nested map garbage collects its entries, which are followed by a placeholder
+        // of a deleted block of another root type: they must not be squashed together
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        t2.load_indexed_snapshot(t1.encode_indexed_snapshot());
+        t2.get_array("a").remove_range(&mut t2, 0, 1);
+        t2.commit();
+        assert_eq!(t2.get_text("b").to_string(&t2), "yz");
+
+        let update = t2.encode_diff_v1(&StateVector::default());
+        let d3 = Doc::with_client_id(3);
+        let mut t3 = d3.transact();
+        t3.apply_update(Update::decode_v1(&update));
+        assert_eq!(t3.get_text("b").to_string(&t3), "yz");
+        assert_eq!(t3.get_array("a").len(), 0);
+    }
+}
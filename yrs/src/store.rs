@@ -1,15 +1,24 @@
-use crate::block::ItemContent;
+use crate::block::{Block, Item, ItemContent, BLOCK_GC_REF_NUMBER};
 use crate::block_store::{BlockStore, SquashResult, StateVector};
-use crate::event::{EventHandler, UpdateEvent};
+use crate::diff_cache::DiffCache;
+use crate::event::{AfterTransactionEvent, EventHandler, UpdateEvent};
 use crate::id_set::DeleteSet;
+use crate::snapshot;
+use crate::snapshot::LazySnapshot;
 use crate::types;
 use crate::types::{BranchRef, TypePtr, TypeRefs, TYPE_REFS_UNDEFINED};
 use crate::update::PendingUpdate;
-use crate::updates::encoder::{Encode, Encoder};
+use crate::updates::encoder::{Encode, Encoder, EncoderV1};
+use crate::utils::interner::StringInterner;
+use lib0::encoding::{uvar_len, Write};
+use std::cell::RefCell;
 use std::collections::hash_map::Entry;
 use std::collections::HashMap;
 use std::rc::Rc;
 
+/// Number of encoded bytes gathered by [Store::encode_diff_to] before writing them out.
+pub const STREAM_CHUNK_SIZE: usize = 8 * 1024;
+
 /// Store is a core element of a document. It contains all of the information, like block store
 /// map of root types, pending updates waiting to be applied once a missing update information
 /// arrives and all subscribed callbacks.
@@ -20,7 +29,11 @@ pub(crate) struct Store {
     /// Root types (a.k.a. top-level types). These types are defined by users at the document level,
     /// they have their own unique names and represent core shared types that expose operations
     /// which can be called concurrently by remote peers in a conflict-free manner.
-    pub types: HashMap<Rc<String>, BranchRef>,
+    pub types: HashMap<Rc<str>, BranchRef>,
+
+    /// A per-document string interner. It's used to share a single allocation of strings used
+    /// repeatedly across many blocks, like map keys, XML attribute names and root type names.
+    pub(crate) interner: StringInterner,
 
     /// A block store of a current document. It represent all blocks (inserted or tombstoned
     /// operations) integrated - and therefore visible - into a current document.
@@ -39,6 +52,22 @@ pub(crate) struct Store {
     /// A subscription handler. It contains all callbacks with registered by user functions that
     /// are supposed to be called, once a new update arrives.
     pub(crate) update_events: EventHandler<UpdateEvent>,
+
+    /// A subscription handler for callbacks called with an update produced by every committed
+    /// transaction.
+    pub(crate) after_transaction_events: EventHandler<AfterTransactionEvent>,
+
+    /// An indexed snapshot, this store has been loaded from. It contains blocks of root types,
+    /// which have not been accessed yet and therefore are still represented in `blocks` by
+    /// placeholders.
+    pub(crate) lazy: RefCell<Option<LazySnapshot>>,
+
+    /// A number of deletions of already integrated blocks performed so far. Together with a sum
+    /// of block store clocks, it's used to determine if a document state has changed.
+    pub(crate) delete_version: u64,
+
+    /// Recently encoded diffs, served again to peers with the same state vector.
+    pub(crate) diff_cache: RefCell<DiffCache>,
 }
 
 impl Store {
@@ -47,10 +76,15 @@ impl Store {
         Store {
             client_id,
             types: Default::default(),
+            interner: StringInterner::new(),
             blocks: BlockStore::new(),
             pending: None,
             pending_ds: None,
             update_events: EventHandler::new(),
+            after_transaction_events: EventHandler::new(),
+            lazy: RefCell::new(None),
+            delete_version: 0,
+            diff_cache: RefCell::new(DiffCache::new()),
         }
     }
 
@@ -113,13 +147,14 @@ impl Store {
         node_name: Option<String>,
         type_ref: TypeRefs,
     ) -> BranchRef {
-        let rc = Rc::new(name.to_owned());
-        self.init_type_ref(rc.clone(), node_name, type_ref)
+        snapshot::materialize(self, Some(name));
+        let rc = self.interner.intern(name);
+        self.init_type_ref(rc, node_name, type_ref)
     }
 
     pub(crate) fn init_type_ref(
         &mut self,
-        name: Rc<String>,
+        name: Rc<str>,
         node_name: Option<String>,
         type_ref: TypeRefs,
     ) -> BranchRef {
@@ -145,21 +180,221 @@ impl Store {
         // 1. create Diff of block store and remote state vector (it can have lifetime of bock store)
         // 2. make Diff implement Encode trait and encode it
         // this way we can add some extra utility method on top of Diff (like introspection) without need of decoding it.
-        self.write_blocks(remote_sv, encoder);
+        snapshot::materialize(self, None);
+        let diff = self.diff_clients(remote_sv);
+        self.write_blocks(&diff, encoder);
+        let delete_set = DeleteSet::from(&self.blocks);
+        delete_set.encode(encoder);
+    }
+
+    /// Works like [Store::encode_diff], but writes encoded update into a given `writer` in chunks
+    /// of [STREAM_CHUNK_SIZE] bytes as it goes, instead of building it entirely in memory.
+    /// Returns that writer back or the first error which occurred while writing into it.
+    pub fn encode_diff_to<W: std::io::Write>(
+        &self,
+        remote_sv: &StateVector,
+        mut writer: W,
+    ) -> std::io::Result<W> {
+        snapshot::materialize(self, None);
+        let diff = self.diff_clients(remote_sv);
+        let mut encoder = EncoderV1::with_capacity(STREAM_CHUNK_SIZE);
+        self.write_blocks_with(&diff, &mut encoder, |encoder| {
+            encoder.flush_to(&mut writer, STREAM_CHUNK_SIZE)
+        })?;
         let delete_set = DeleteSet::from(&self.blocks);
+        delete_set.encode(&mut encoder);
+        encoder.flush_to(&mut writer, 0)?;
+        writer.flush()?;
+        Ok(writer)
+    }
+
+    /// Encodes a difference between current store and a remote one using [EncoderV1]. Unlike
+    /// [Store::encode_diff] it computes an exact size of encoded update first, so that the
+    /// returned buffer is allocated only once and has no unused capacity.
+    ///
+    /// Encoded diffs are cached until the store changes, so that peers sharing the same
+    /// `remote_sv` can be served without encoding the same update again.
+    pub fn encode_diff_v1(&self, remote_sv: &StateVector) -> Vec<u8> {
+        snapshot::materialize(self, None);
+        let clock = self.blocks.iter().map(|(_, b)| b.get_state() as u64).sum();
+        let mut cache = self.diff_cache.borrow_mut();
+        if let Some(buf) = cache.get(clock, self.delete_version, remote_sv) {
+            return buf;
+        }
+        let diff = self.diff_clients(remote_sv);
+        let delete_set = DeleteSet::from(&self.blocks);
+        let len = self.blocks_encoded_len(&diff) + delete_set.encoded_len();
+        let mut encoder = EncoderV1::with_capacity(len);
+        self.write_blocks(&diff, &mut encoder);
+        delete_set.encode(&mut encoder);
+        let buf = encoder.to_vec();
+        debug_assert_eq!(buf.len(), len, "invalid encoded update length estimate");
+        cache.insert(remote_sv, &buf);
+        buf
+    }
+
+    /// Returns a number of bytes required to encode a difference between current store and
+    /// a remote one using [EncoderV1], as done by [Store::encode_diff].
+    pub fn encoded_diff_len(&self, remote_sv: &StateVector) -> usize {
+        snapshot::materialize(self, None);
+        let diff = self.diff_clients(remote_sv);
+        self.blocks_encoded_len(&diff) + DeleteSet::from(&self.blocks).encoded_len()
+    }
+
+    /// Compute a diff to sync with another client, which replicates only a subset of root types
+    /// identified by their `root_names`. Unlike [Store::encode_diff], only blocks belonging
+    /// (directly or through nested types) to one of these root types are encoded. Remaining
+    /// blocks are sent as content-less GC blocks, so that a remote peer's state vector still
+    /// advances and blocks of a selected roots never wait for a missing ones. Delete set is
+    /// restricted the same way, except for already garbage collected blocks, which are always
+    /// included, as they no longer carry an information about their parent.
+    ///
+    /// Since filtered out blocks are integrated by a remote peer as garbage collected, its state
+    /// vector covers them afterwards, and they will never be sent to it again - even if it asks
+    /// for a diff without a filter later on. A peer, which needs to replicate more root types
+    /// than it used to, must start over from an empty document.
+    pub fn encode_diff_filtered<E: Encoder>(
+        &self,
+        remote_sv: &StateVector,
+        root_names: &[&str],
+        encoder: &mut E,
+    ) {
+        snapshot::materialize(self, None);
+        let filter = |block: &Block| match block {
+            Block::Item(item) => match self.root_of(item) {
+                Some(name) => root_names.contains(&name.as_ref()),
+                None => false,
+            },
+            _ => false,
+        };
+        let diff = self.diff_clients(remote_sv);
+        encoder.write_uvar(diff.len());
+        for &(client, clock) in diff.iter() {
+            let blocks = self.blocks.get(&client).unwrap();
+            let clock = clock.max(blocks.first().id().clock); // make sure the first id exists
+            let start = blocks.find_pivot(clock).unwrap();
+            let offset = clock - blocks[start].id().clock;
+            // consecutive blocks, which are filtered out, are merged into a single GC block
+            let mut chunks: Vec<Result<usize, u32>> = Vec::new();
+            for i in start..blocks.integrated_len() {
+                let block = &blocks[i];
+                if filter(block) {
+                    chunks.push(Ok(i));
+                } else {
+                    let len = if i == start {
+                        block.len() - offset
+                    } else {
+                        block.len()
+                    };
+                    match chunks.last_mut() {
+                        Some(Err(gap)) => *gap += len,
+                        _ => chunks.push(Err(len)),
+                    }
+                }
+            }
+            encoder.write_uvar(chunks.len());
+            encoder.write_client(client);
+            encoder.write_uvar(clock);
+            for chunk in chunks {
+                match chunk {
+                    Ok(i) if i == start => blocks[i].encode_with_offset(encoder, offset),
+                    Ok(i) => blocks[i].encode(encoder),
+                    Err(len) => {
+                        encoder.write_info(BLOCK_GC_REF_NUMBER);
+                        encoder.write_len(len);
+                    }
+                }
+            }
+        }
+        let delete_set = DeleteSet::from_blocks_filtered(&self.blocks, |block| match block {
+            Block::GC(_) => true,
+            _ => filter(block),
+        });
         delete_set.encode(encoder);
     }
 
-    fn write_blocks<E: Encoder>(&self, remote_sv: &StateVector, encoder: &mut E) {
+    /// Returns a name of a root type, given `item` belongs to - either directly or through any
+    /// number of nested types. Returns `None` if any of the item's parents could not be found.
+    fn root_of<'a>(&'a self, item: &'a Item) -> Option<&'a Rc<str>> {
+        let mut item = item;
+        loop {
+            match &item.parent {
+                TypePtr::Named(name) => return Some(name),
+                TypePtr::Id(ptr) => item = self.blocks.get_item(ptr)?,
+                TypePtr::Unknown => return None,
+            }
+        }
+    }
+
+    /// Encodes blocks integrated since `before_state` together with a given `delete_set` using
+    /// lib0 v1 encoding. Unlike [Store::encode_diff_v1], it visits only clients, which state has
+    /// changed and doesn't compute a delete set of an entire store, so its cost depends only on
+    /// a number of changes.
+    pub(crate) fn encode_changes_v1(
+        &self,
+        before_state: &StateVector,
+        delete_set: &DeleteSet,
+    ) -> Vec<u8> {
+        let mut diff = Vec::new();
+        for (&client, blocks) in self.blocks.iter() {
+            let clock = before_state.get(&client);
+            if blocks.get_state() > clock {
+                diff.push((client, clock));
+            }
+        }
+        // Write items with higher client ids first
+        diff.sort_by(|a, b| b.0.cmp(&a.0));
+
+        let mut encoder = EncoderV1::new();
+        encoder.write_uvar(diff.len());
+        for &(client, clock) in diff.iter() {
+            let blocks = self.blocks.get(&client).unwrap();
+            let clock = clock.max(blocks.first().id().clock);
+            let start = blocks.find_pivot(clock).unwrap();
+            // new blocks may have been squashed into the ones existing before
+            let offset = clock - blocks[start].id().clock;
+            encoder.write_uvar(blocks.integrated_len() - start);
+            encoder.write_client(client);
+            encoder.write_uvar(clock);
+            blocks[start].encode_with_offset(&mut encoder, offset);
+            for i in (start + 1)..blocks.integrated_len() {
+                blocks[i].encode(&mut encoder);
+            }
+        }
+        delete_set.encode(&mut encoder);
+        encoder.to_vec()
+    }
+
+    /// Returns a list of clients and their clock values, starting from which blocks should be
+    /// encoded in order to send them to a remote peer.
+    fn diff_clients(&self, remote_sv: &StateVector) -> Vec<(u64, u32)> {
         let local_sv = self.blocks.get_state_vector();
         let mut diff = Self::diff_state_vectors(&local_sv, remote_sv);
 
         // Write items with higher client ids first
         // This heavily improves the conflict algorithm.
         diff.sort_by(|a, b| b.0.cmp(&a.0));
+        diff
+    }
 
+    fn write_blocks<E: Encoder>(&self, diff: &[(u64, u32)], encoder: &mut E) {
+        self.write_blocks_with(diff, encoder, |_| Ok(())).unwrap()
+    }
+
+    /// Encodes blocks of all clients from a given `diff`, calling `on_block` after every encoded
+    /// block, ie. to flush encoded data written so far.
+    fn write_blocks_with<E, F>(
+        &self,
+        diff: &[(u64, u32)],
+        encoder: &mut E,
+        mut on_block: F,
+    ) -> std::io::Result<()>
+    where
+        E: Encoder,
+        F: FnMut(&mut E) -> std::io::Result<()>,
+    {
         encoder.write_uvar(diff.len());
-        for (client, clock) in diff {
+        for &(client, clock) in diff {
             let blocks = self.blocks.get(&client).unwrap();
             let clock = clock.max(blocks.first().id().clock); // make sure the first id exists
             let start = blocks.find_pivot(clock).unwrap();
@@ -169,11 +404,30 @@ impl Store {
             encoder.write_uvar(clock);
             let first_block = &blocks[start];
             // write first struct with an offset
-            first_block.encode(encoder);
+            first_block.encode_with_offset(encoder, clock - first_block.id().clock);
+            on_block(encoder)?;
             for i in (start + 1)..blocks.integrated_len() {
                 blocks[i].encode(encoder);
+                on_block(encoder)?;
+            }
+        }
+        Ok(())
+    }
+
+    fn blocks_encoded_len(&self, diff: &[(u64, u32)]) -> usize {
+        let mut len = uvar_len(diff.len());
+        for &(client, clock) in diff {
+            let blocks = self.blocks.get(&client).unwrap();
+            let clock = clock.max(blocks.first().id().clock);
+            let start = blocks.find_pivot(clock).unwrap();
+            len += uvar_len(blocks.integrated_len() - start) + uvar_len(client) + uvar_len(clock);
+            let first_block = &blocks[start];
+            len += first_block.encoded_len_with_offset(clock - first_block.id().clock);
+            for i in (start + 1)..blocks.integrated_len() {
+                len += blocks[i].encoded_len();
             }
         }
+        len
     }
 
     fn diff_state_vectors(local_sv: &StateVector, remote_sv: &StateVector) -> Vec<(u64, u32)> {
@@ -216,7 +470,7 @@ impl Store {
         }
     }
 
-    pub(crate) fn get_root_type_key(&self, value: &BranchRef) -> Option<&Rc<String>> {
+    pub(crate) fn get_root_type_key(&self, value: &BranchRef) -> Option<&Rc<str>> {
         for (k, v) in self.types.iter() {
             if v == value {
                 return Some(k);
@@ -239,6 +493,14 @@ impl Encode for Store {
     fn encode<E: Encoder>(&self, encoder: &mut E) {
         self.encode_diff(&StateVector::default(), encoder)
     }
+
+    fn encoded_len(&self) -> usize {
+        self.encoded_diff_len(&StateVector::default())
+    }
+
+    fn encode_v1(&self) -> Vec<u8> {
+        self.encode_diff_v1(&StateVector::default())
+    }
 }
 
 impl std::fmt::Display for Store {
@@ -247,7 +509,7 @@ impl std::fmt::Display for Store {
         if !self.types.is_empty() {
             writeln!(f, "\ttypes: {{")?;
             for (k, v) in self.types.iter() {
-                writeln!(f, "\t\t'{}': {}", k.as_str(), *v.borrow())?;
+                writeln!(f, "\t\t'{}': {}", k, *v.borrow())?;
             }
 
             writeln!(f, "\t}}")?;
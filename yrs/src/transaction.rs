@@ -2,19 +2,20 @@ use crate::*;
 
 use crate::block::{Block, BlockPtr, Item, ItemContent, Prelim, ID};
 use crate::block_store::StateVector;
-use crate::event::UpdateEvent;
+use crate::event::{AfterTransactionEvent, UpdateEvent};
 use crate::id_set::{DeleteSet, IdSet};
 use crate::store::Store;
 use crate::types::array::Array;
 use crate::types::xml::{XmlElement, XmlText};
 use crate::types::{
-    Branch, Map, Text, TypePtr, TYPE_REFS_ARRAY, TYPE_REFS_MAP, TYPE_REFS_TEXT,
-    TYPE_REFS_XML_ELEMENT, TYPE_REFS_XML_TEXT,
+    Branch, BranchRef, Event, Events, Map, Text, TypePtr, TYPE_REFS_ARRAY, TYPE_REFS_MAP,
+    TYPE_REFS_TEXT, TYPE_REFS_XML_ELEMENT, TYPE_REFS_XML_TEXT,
 };
 use crate::update::Update;
 use std::cell::RefMut;
 use std::collections::{HashMap, HashSet};
 use std::ops::Range;
+use std::rc::Rc;
 use updates::encoder::*;
 
 /// Transaction is one of the core types in Yrs. All operations that need to touch a document's
@@ -22,8 +23,12 @@ use updates::encoder::*;
 pub struct Transaction<'a> {
     /// Store containing the state of the document.
     pub(crate) store: RefMut<'a, Store>,
-    /// State vector of a current transaction at the moment of its creation.
+    /// State vector of a current transaction at the moment of its creation or its last commit.
     pub before_state: StateVector,
+    /// State vector of a current transaction at the moment of its creation. Unlike
+    /// [Transaction::before_state] it's not reset on commit, so that [Transaction::encode_update_v1]
+    /// covers all changes made within a transaction.
+    initial_state: StateVector,
     /// Current state vector of a transaction, which includes all performed updates.
     pub after_state: StateVector,
     /// ID's of the blocks to be merged.
@@ -32,7 +37,7 @@ pub struct Transaction<'a> {
     pub delete_set: DeleteSet,
     /// All types that were directly modified (property added or child inserted/deleted).
     /// New types are not included in this Set.
-    changed: HashMap<TypePtr, HashSet<Option<String>>>,
+    changed: HashMap<TypePtr, HashSet<Option<Rc<str>>>>,
 }
 
 impl<'a> Transaction<'a> {
@@ -40,6 +45,7 @@ impl<'a> Transaction<'a> {
         let begin_timestamp = store.blocks.get_state_vector();
         Transaction {
             store,
+            initial_state: begin_timestamp.clone(),
             before_state: begin_timestamp,
             merge_blocks: Vec::new(),
             delete_set: DeleteSet::new(),
@@ -59,6 +65,83 @@ impl<'a> Transaction<'a> {
         self.store.encode_diff(state_vector, encoder)
     }
 
+    /// Works like [Transaction::encode_diff], but writes an update encoded using [EncoderV1]
+    /// into a given `writer` in chunks, instead of building it entirely in memory.
+    pub fn encode_diff_to<W: std::io::Write>(
+        &self,
+        state_vector: &StateVector,
+        writer: W,
+    ) -> std::io::Result<W> {
+        self.store.encode_diff_to(state_vector, writer)
+    }
+
+    /// Encodes the difference between remote peer state given its `state_vector` and the state
+    /// of a current local peer, limited only to the contents of root types with given
+    /// `root_names`. It's meant for peers, which replicate only a part of a document.
+    ///
+    /// Contents of remaining root types are sent as garbage collected blocks. Once applied, they
+    /// advance remote peer's state vector, so they cannot be requested again later on. See
+    /// [Store::encode_diff_filtered] for details.
+    pub fn encode_diff_filtered<E: Encoder>(
+        &self,
+        state_vector: &StateVector,
+        root_names: &[&str],
+        encoder: &mut E,
+    ) {
+        self.store
+            .encode_diff_filtered(state_vector, root_names, encoder)
+    }
+
+    /// Encodes the difference between remote peer state given its `state_vector` and the state
+    /// of a current local peer using lib0 v1 encoding. Returned buffer is allocated only once,
+    /// with an exact size of encoded update.
+    pub fn encode_diff_v1(&self, state_vector: &StateVector) -> Vec<u8> {
+        self.store.encode_diff_v1(state_vector)
+    }
+
+    /// Encodes entire state of a current document using a native snapshot format. Unlike lib0
+    /// updates, native snapshots describe a block store exactly as it's laid out in memory, which
+    /// makes them much faster to load using [Transaction::load_native_snapshot]. They are meant
+    /// only for persisting documents by the same application and should not be exchanged with
+    /// other peers.
+    pub fn encode_native_snapshot(&self) -> Vec<u8> {
+        crate::snapshot::encode(&self.store)
+    }
+
+    /// Restores a state of a document from a native snapshot produced by
+    /// [Transaction::encode_native_snapshot]. Blocks are loaded as they are, without being
+    /// integrated, therefore a document must be empty. Root types, which were already defined,
+    /// are reused. Unlike [Transaction::apply_update], this method doesn't notify update
+    /// subscribers.
+    ///
+    /// This method panics if document is not empty or when a snapshot is malformed.
+    pub fn load_native_snapshot(&mut self, snapshot: &[u8]) {
+        crate::snapshot::load(&mut self.store, snapshot)
+    }
+
+    /// Encodes entire state of a current document using an indexed snapshot format. It's
+    /// a variant of a native snapshot, in which blocks of every root type are stored separately,
+    /// so that they can be loaded independently from each other using
+    /// [Transaction::load_indexed_snapshot].
+    pub fn encode_indexed_snapshot(&self) -> Vec<u8> {
+        crate::snapshot::encode_indexed(&self.store)
+    }
+
+    /// Restores a state of a document from an indexed snapshot produced by
+    /// [Transaction::encode_indexed_snapshot]. Only a layout of a block store is loaded right
+    /// away, while contents of every root type are decoded once they are accessed for the first
+    /// time eg. via [Transaction::get_text] or [Transaction::get_map]. Applying remote updates
+    /// or encoding a document state loads all of the remaining root types.
+    ///
+    /// Just like [Transaction::load_native_snapshot], this method panics if document is not
+    /// empty or when a snapshot is malformed.
+    pub fn load_indexed_snapshot(&mut self, snapshot: Vec<u8>) {
+        crate::snapshot::load_indexed(&mut self.store, snapshot);
+        // loaded blocks are not a part of this transaction changes
+        self.before_state = self.store.blocks.get_state_vector();
+        self.initial_state = self.before_state.clone();
+    }
+
     /// Returns a [Text] data structure stored under a given `name`. Text structures are used for
     /// collaborative text editing: they expose operations to append and remove chunks of text,
     /// which are free to execute concurrently by multiple peers over remote boundaries.
@@ -147,11 +230,11 @@ impl<'a> Transaction<'a> {
     ///   end up with the same content.
     /// * Even if an update contains known information, the unknown information
     ///   is extracted and integrated into the document structure.
+    ///
+    /// Returned update contains all changes made since this transaction has started, even if it
+    /// has been committed in the meantime.
     pub fn encode_update_v1(&self) -> Vec<u8> {
-        let mut update_encoder = updates::encoder::EncoderV1::new();
-        self.store
-            .encode_diff(&self.before_state, &mut update_encoder);
-        update_encoder.to_vec()
+        self.store.encode_diff_v1(&self.initial_state)
     }
 
     pub(crate) fn iterate_structs<F>(&mut self, client: &u64, range: &Range<u32>, f: &F)
@@ -191,7 +274,7 @@ impl<'a> Transaction<'a> {
         if let Some(item) = block.as_item_mut() {
             if item.id.clock < clock {
                 // if we run over the clock, we need to the split item
-                let id = ID::new(*client, clock - item.id.clock);
+                let id = ID::new(*client, clock);
                 self.store
                     .blocks
                     .split_block(&BlockPtr::new(id, index as u32));
@@ -210,7 +293,7 @@ impl<'a> Transaction<'a> {
         for (client, ranges) in set.iter() {
             if self.store.blocks.contains_client(client) {
                 for range in ranges.iter() {
-                    self.iterate_structs(client, range, f);
+                    self.iterate_structs(client, &range, f);
                 }
             }
         }
@@ -238,10 +321,8 @@ impl<'a> Transaction<'a> {
                         if let Some(item) = blocks.get_mut(index).as_item_mut() {
                             // split the first item if necessary
                             if !item.is_deleted() && item.id.clock < clock {
-                                let split_ptr = BlockPtr::new(
-                                    ID::new(*client, clock - item.id.clock),
-                                    index as u32,
-                                );
+                                let split_ptr =
+                                    BlockPtr::new(ID::new(*client, clock), index as u32);
                                 let (_, right) = self.store.blocks.split_block(&split_ptr);
                                 if let Some(right) = right {
                                     index += 1;
@@ -311,27 +392,19 @@ impl<'a> Transaction<'a> {
                 item.mark_as_deleted();
                 self.delete_set.insert(item.id.clone(), item.len());
 
-                match &item.parent {
-                    TypePtr::Named(_) => {
-                        self.changed
-                            .entry(item.parent.clone())
-                            .or_default()
-                            .insert(item.parent_sub.clone());
+                let trigger = match &item.parent {
+                    TypePtr::Named(_) => true,
+                    TypePtr::Id(ptr) => {
+                        ptr.id.clock < self.before_state.get(&{ ptr.id.client })
+                            && !self.store.blocks.get_item(ptr).unwrap().is_deleted()
                     }
-                    TypePtr::Id(ptr)
-                        if ptr.id.clock < self.before_state.get(&ptr.id.client)
-                            && self.store.blocks.get_item(ptr).unwrap().is_deleted() =>
-                    {
-                        self.changed
-                            .entry(item.parent.clone())
-                            .or_default()
-                            .insert(item.parent_sub.clone());
-                    }
-                    _ => {}
-                }
-                if item.id.clock < self.before_state.get(&item.id.client) {
-                    let set = self.changed.entry(item.parent.clone()).or_default();
-                    set.insert(item.parent_sub.clone());
+                    TypePtr::Unknown => false,
+                };
+                if trigger {
+                    self.changed
+                        .entry(item.parent.clone())
+                        .or_default()
+                        .insert(item.parent_sub.clone());
                 }
 
                 match &item.content {
@@ -346,7 +419,8 @@ impl<'a> Transaction<'a> {
                     ItemContent::Type(t) => {
                         let inner = t.borrow_mut();
                         let mut ptr = inner.start;
-                        self.changed.remove(&item.parent);
+                        // deleted types are not observed anymore
+                        self.changed.remove(&inner.ptr);
 
                         while let Some(item) = ptr.and_then(|ptr| self.store.blocks.get_item(&ptr))
                         {
@@ -366,6 +440,9 @@ impl<'a> Transaction<'a> {
                 result = true;
             }
         }
+        if result {
+            self.store.delete_version += 1;
+        }
 
         for ptr in recurse.iter() {
             if !self.delete(ptr) {
@@ -381,6 +458,7 @@ impl<'a> Transaction<'a> {
     }
 
     pub fn apply_update(&mut self, mut update: Update) {
+        crate::snapshot::materialize(&self.store, None);
         if self.store.update_events.has_subscribers() {
             let event = UpdateEvent::new(update);
             self.store.update_events.publish(&event);
@@ -441,7 +519,7 @@ impl<'a> Transaction<'a> {
         &mut self,
         pos: &block::ItemPosition,
         value: T,
-        parent_sub: Option<String>,
+        parent_sub: Option<&str>,
     ) -> &Item {
         let left = pos.left;
         let right = pos.right;
@@ -479,7 +557,7 @@ impl<'a> Transaction<'a> {
             right,
             right.map(|r| r.id),
             pos.parent.clone(),
-            parent_sub,
+            parent_sub.map(|key| self.store.interner.intern(key)),
             content,
         );
 
@@ -505,6 +583,9 @@ impl<'a> Transaction<'a> {
     ///
     /// This step is performed automatically when a transaction is about to be dropped (its life
     /// scope comes to an end).
+    ///
+    /// Callbacks subscribed via [Doc::on_after_transaction] are called with an update containing
+    /// only the changes made since the transaction has started (or was last committed).
     pub fn commit(&mut self) {
         // 1. sort and merge delete set
         self.delete_set.squash();
@@ -512,12 +593,16 @@ impl<'a> Transaction<'a> {
 
         // 2. emit 'beforeObserverCalls'
         // 3. for each change observed by the transaction call 'afterTransaction'
+        self.call_observers();
+
         // 4. try GC delete set
         self.try_gc(); //TODO: eventually this is a configurable variant: if (doc.gc)
 
         // 5. try merge delete set
         self.delete_set.try_squash_with(&mut self.store);
 
+        // blocks of root types not yet loaded from an indexed snapshot must stay in place
+        let items_only = self.store.lazy.borrow().is_some();
         // 6. get transaction after state and try to merge to left
         for (client, &clock) in self.after_state.iter() {
             let before_clock = self.before_state.get(client);
@@ -526,7 +611,7 @@ impl<'a> Transaction<'a> {
                 let first_change = blocks.find_pivot(before_clock).unwrap().max(1);
                 let mut i = blocks.len() - 1;
                 while i >= first_change {
-                    if let Some(compaction) = blocks.squash_left(i) {
+                    if let Some(compaction) = blocks.squash_left(i, items_only) {
                         self.store.gc_cleanup(compaction);
                         blocks = self.store.blocks.get_mut(client).unwrap();
                     }
@@ -541,20 +626,121 @@ impl<'a> Transaction<'a> {
             let blocks = self.store.blocks.get_mut(&client).unwrap();
             let replaced_pos = blocks.find_pivot(clock).unwrap();
             if replaced_pos + 1 < blocks.len() {
-                if let Some(compaction) = blocks.squash_left(replaced_pos + 1) {
+                if let Some(compaction) = blocks.squash_left(replaced_pos + 1, items_only) {
                     self.store.gc_cleanup(compaction);
                 }
             } else if replaced_pos > 0 {
-                if let Some(compaction) = blocks.squash_left(replaced_pos) {
+                if let Some(compaction) = blocks.squash_left(replaced_pos, items_only) {
                     self.store.gc_cleanup(compaction);
                 }
             }
         }
         // 8. emit 'afterTransactionCleanup'
         // 9. emit 'update'
+        if self.store.after_transaction_events.has_subscribers()
+            && (self.after_state != self.before_state || !self.delete_set.is_empty())
+        {
+            let update = self
+                .store
+                .encode_changes_v1(&self.before_state, &self.delete_set);
+            let event = AfterTransactionEvent::new(update);
+            self.store.after_transaction_events.publish(&event);
+        }
         // 10. emit 'updateV2'
         // 11. add and remove subdocs
         // 12. emit 'subdocs'
+
+        // changes made after this point are going to be committed separately
+        self.before_state = self.after_state.clone();
+        self.delete_set = DeleteSet::new();
+        self.merge_blocks.clear();
+    }
+
+    /// Calls observers of all shared types changed within the scope of a current transaction.
+    /// Events are created only for the types observed either directly or by any of their parents,
+    /// while their changes are computed only when requested by a subscriber.
+    fn call_observers(&mut self) {
+        let changed = std::mem::take(&mut self.changed);
+        // deeply observed types with events of their nested types and their depths
+        let mut deep: HashMap<TypePtr, (BranchRef, Vec<(u32, Rc<Event>)>)> = HashMap::new();
+        for (ptr, keys) in changed {
+            let branch = match self.store.get_type(&ptr) {
+                Some(branch) => branch.clone(),
+                None => continue,
+            };
+            let (item, shallow) = {
+                let inner = branch.borrow();
+                let shallow = if inner.observers.has_shallow() {
+                    inner.observers.shallow.clone()
+                } else {
+                    None
+                };
+                (inner.item, shallow)
+            };
+            if let Some(item) = item.and_then(|ptr| self.store.blocks.get_item(&ptr)) {
+                if item.is_deleted() {
+                    continue;
+                }
+            }
+            let ancestors = self.deeply_observed(&branch);
+            if shallow.is_none() && ancestors.is_empty() {
+                continue;
+            }
+            let event = match Event::new(branch, keys) {
+                Some(event) => Rc::new(event),
+                None => continue,
+            };
+            if let Some(observer) = shallow {
+                observer.publish(self, &event);
+            }
+            for (ancestor, depth) in ancestors {
+                let ptr = ancestor.borrow().ptr.clone();
+                let (_, events) = deep.entry(ptr).or_insert_with(|| (ancestor, Vec::new()));
+                events.push((depth, event.clone()));
+            }
+        }
+
+        for (_, (branch, mut events)) in deep {
+            events.sort_by_key(|(depth, _)| *depth);
+            let events = Events::new(events.into_iter().map(|(_, e)| e).collect());
+            let observer = branch.borrow().observers.deep.clone();
+            if let Some(observer) = observer {
+                observer.publish(self, &events);
+            }
+        }
+    }
+
+    /// Returns a given `branch` and all of its parents, which have deep observers subscribed,
+    /// together with their distance from a `branch`.
+    fn deeply_observed(&self, branch: &BranchRef) -> Vec<(BranchRef, u32)> {
+        let mut result = Vec::new();
+        let mut current = Some(branch.clone());
+        let mut depth = 0;
+        while let Some(branch) = current {
+            let inner = branch.borrow();
+            current = inner
+                .item
+                .and_then(|ptr| self.store.blocks.get_item(&ptr))
+                .and_then(|item| self.store.get_type(&item.parent))
+                .cloned();
+            if inner.observers.has_deep() {
+                result.push((branch.clone(), depth));
+            }
+            depth += 1;
+        }
+        result
+    }
+
+    /// Checks if a block with a given `id` has been inserted within the scope of a current
+    /// transaction.
+    pub(crate) fn has_added(&self, id: &ID) -> bool {
+        id.clock >= self.before_state.get(&{ id.client })
+    }
+
+    /// Checks if a block with a given `id` has been deleted within the scope of a current
+    /// transaction.
+    pub(crate) fn has_deleted(&self, id: &ID) -> bool {
+        self.delete_set.is_deleted(id)
     }
 
     fn try_gc(&self) {
@@ -580,10 +766,10 @@ impl<'a> Transaction<'a> {
         }
     }
 
-    pub(crate) fn add_changed_type(&mut self, parent: &Branch, parent_sub: Option<&String>) {
+    pub(crate) fn add_changed_type(&mut self, parent: &Branch, parent_sub: Option<&Rc<str>>) {
         let trigger = match parent.item.as_ref() {
             None => true,
-            Some(ptr) if ptr.id.clock < (self.before_state.get(&ptr.id.client)) => {
+            Some(ptr) if ptr.id.clock < (self.before_state.get(&{ ptr.id.client })) => {
                 if let Some(item) = self.store.blocks.get_item(ptr) {
                     !item.is_deleted()
                 } else {
@@ -1,7 +1,12 @@
 use crate::block::{BlockPtr, ItemContent, ItemPosition, Prelim};
-use crate::types::{Branch, BranchRef, TypePtr, Value, TYPE_REFS_ARRAY};
+use crate::event::{Observer, Subscription};
+use crate::types::{
+    value_changes, Branch, BranchRef, Change, Events, ShallowObserver, TypePtr, Value,
+    TYPE_REFS_ARRAY,
+};
 use crate::Transaction;
 use lib0::any::Any;
+use std::cell::OnceCell;
 use std::collections::VecDeque;
 
 /// A collection used to store data in an indexed sequence structure. This type is internally
@@ -74,6 +79,24 @@ impl Array {
         self.insert(txn, index, PrelimRange(values))
     }
 
+    /// Inserts multiple floating point `values` at the given `index`. Unlike [Array::insert_range]
+    /// values are stored in a packed form, which doesn't require a conversion into [Any] and can be
+    /// read back directly using [Array::get_f64_range]. Other peers will see them as regular
+    /// JSON numbers.
+    ///
+    /// Using `index` value that's higher than current array length results in panic.
+    pub fn insert_f64_range(&self, txn: &mut Transaction, index: u32, values: Vec<f64>) {
+        self.insert(txn, index, PrelimPacked(ItemContent::F64Array(values)))
+    }
+
+    /// Inserts multiple integer `values` at the given `index`. Unlike [Array::insert_range] values
+    /// are stored in a packed form. Other peers will see them as [Any::BigInt] values.
+    ///
+    /// Using `index` value that's higher than current array length results in panic.
+    pub fn insert_i64_range(&self, txn: &mut Transaction, index: u32, values: Vec<i64>) {
+        self.insert(txn, index, PrelimPacked(ItemContent::I64Array(values)))
+    }
+
     /// Inserts given `value` at the end of the current array.
     pub fn push_back<V: Prelim>(&self, txn: &mut Transaction, value: V) {
         let len = self.len();
@@ -109,6 +132,22 @@ impl Array {
         Some(content.get_content(txn).remove(idx))
     }
 
+    /// Returns a slice of floating point numbers, starting at a given `index`, that were stored
+    /// together in a packed form using [Array::insert_f64_range]. Returned slice is borrowed
+    /// directly from the block store, and it spans up until the end of a block containing element
+    /// at given `index`, so it may be shorter than the rest of an array.
+    ///
+    /// Returns `None` if provided index was out of the range of a current array or if element at
+    /// that index was not stored in a packed form.
+    pub fn get_f64_range<'b>(&self, txn: &'b Transaction, index: u32) -> Option<&'b [f64]> {
+        let inner = self.0.borrow();
+        if let (ItemContent::F64Array(values), idx) = inner.get_at(txn, index)? {
+            Some(&values[idx..])
+        } else {
+            None
+        }
+    }
+
     /// Returns an iterator, that can be used to lazely traverse over all values stored in a current
     /// array.
     pub fn iter<'a, 'b, 'txn>(&'a self, txn: &'b Transaction<'txn>) -> ArrayIter<'b, 'txn> {
@@ -120,6 +159,73 @@ impl Array {
         let res = self.iter(txn).map(|v| v.to_json(txn)).collect();
         Any::Array(res)
     }
+
+    /// Writes all contents of current array as a JSON array into a given `writer`. Output is
+    /// equivalent to a serialized result of [Array::to_json], but it's produced directly from
+    /// array contents, without building an intermediate [Any] structure.
+    pub fn write_json<W: std::io::Write>(
+        &self,
+        txn: &Transaction,
+        writer: &mut W,
+    ) -> std::io::Result<()> {
+        crate::utils::json::write_array(writer, txn, &self.0.borrow())
+    }
+
+    /// Subscribes a given callback to be called once per transaction, in which this array has
+    /// been changed. Changes are described by [ArrayEvent::delta], which is computed only when
+    /// requested. Callback is unsubscribed once returned subscription is dropped.
+    pub fn observe<F>(&self, f: F) -> Subscription<ArrayEvent>
+    where
+        F: Fn(&Transaction, &ArrayEvent) -> () + 'static,
+    {
+        let mut inner = self.0.borrow_mut();
+        match inner
+            .observers
+            .shallow
+            .get_or_insert_with(|| ShallowObserver::Array(Observer::new()))
+        {
+            ShallowObserver::Array(observer) => observer.subscribe(f),
+            _ => panic!("Observed collection is of different type"),
+        }
+    }
+
+    /// Subscribes a given callback to be called once per transaction, in which this array or any
+    /// of its nested types have been changed. Callback is unsubscribed once returned subscription
+    /// is dropped.
+    pub fn observe_deep<F>(&self, f: F) -> Subscription<Events>
+    where
+        F: Fn(&Transaction, &Events) -> () + 'static,
+    {
+        self.0.observe_deep(f)
+    }
+}
+
+/// An event describing changes made to an [Array] within the scope of a single transaction.
+pub struct ArrayEvent {
+    target: Array,
+    delta: OnceCell<Vec<Change>>,
+}
+
+impl ArrayEvent {
+    pub(crate) fn new(target: Array) -> Self {
+        ArrayEvent {
+            target,
+            delta: OnceCell::new(),
+        }
+    }
+
+    /// Returns an [Array] instance, which has been changed.
+    pub fn target(&self) -> &Array {
+        &self.target
+    }
+
+    /// Returns a list of changes made to an array, described as consecutive runs of added,
+    /// removed and retained elements. Delta is computed on the first call, which must use
+    /// a transaction this event has been emitted for.
+    pub fn delta(&self, txn: &Transaction) -> &[Change] {
+        self.delta
+            .get_or_init(|| value_changes(txn, &self.target.0.borrow()))
+    }
 }
 
 pub struct ArrayIter<'b, 'txn> {
@@ -202,6 +308,17 @@ where
     fn integrate(self, _txn: &mut Transaction, _inner_ref: BranchRef) {}
 }
 
+/// Prelim used to insert already packed item content, like [ItemContent::F64Array].
+pub(crate) struct PrelimPacked(pub ItemContent);
+
+impl Prelim for PrelimPacked {
+    fn into_content(self, _txn: &mut Transaction, _ptr: TypePtr) -> (ItemContent, Option<Self>) {
+        (self.0, None)
+    }
+
+    fn integrate(self, _txn: &mut Transaction, _inner_ref: BranchRef) {}
+}
+
 impl<T, V> Prelim for PrelimArray<T, V>
 where
     V: Prelim,
@@ -292,6 +409,70 @@ mod test {
         assert_eq!(actual, vec!["Hi".into()]);
     }
 
+    #[test]
+    fn packed_f64_range() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let a1 = t1.get_array("array");
+
+        a1.insert_f64_range(&mut t1, 0, vec![1.0, 2.5, 4.0]);
+        a1.insert_f64_range(&mut t1, 3, vec![5.5]);
+        a1.insert(&mut t1, 1, "x");
+        t1.commit();
+
+        // squashed with the following range, but split by the "x" insert
+        assert_eq!(a1.get_f64_range(&t1, 0), Some(&[1.0][..]));
+        assert_eq!(a1.get_f64_range(&t1, 1), None);
+        assert_eq!(a1.get_f64_range(&t1, 3), Some(&[4.0, 5.5][..]));
+
+        let update = d1.encode_state_as_update_v1(&t1);
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        d2.apply_update_v1(&mut t2, update.as_slice());
+        let a2 = t2.get_array("array");
+
+        // remote peers see packed values as regular numbers
+        let expected: Any = Any::Array(vec![
+            Any::Number(1.0),
+            Any::String("x".into()),
+            Any::Number(2.5),
+            Any::Number(4.0),
+            Any::Number(5.5),
+        ]);
+        assert_eq!(a1.to_json(&t1), expected);
+        assert_eq!(a2.to_json(&t2), expected);
+    }
+
+    #[test]
+    fn write_json() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let a = txn.get_array("array");
+        a.insert_range(
+            &mut txn,
+            0,
+            vec![Any::BigInt(1), Any::String("a\"b\n".into())],
+        );
+        let mut nested = HashMap::new();
+        nested.insert("k".to_owned(), Any::Array(vec![Any::Bool(true), Any::Null]));
+        a.push_back(&mut txn, PrelimMap::from(nested));
+        a.insert_f64_range(&mut txn, 3, vec![2.5, f64::NAN]);
+        a.push_back(&mut txn, PrelimArray::from(vec![Any::Undefined]));
+        a.push_back(&mut txn, vec![1u8, 2]);
+        a.remove(&mut txn, 0);
+
+        let mut json = Vec::new();
+        a.write_json(&txn, &mut json).unwrap();
+        assert_eq!(
+            String::from_utf8(json).unwrap(),
+            r#"["a\"b\n",{"k":[true,null]},2.5,null,[null],[1,2]]"#
+        );
+
+        let mut json = Vec::new();
+        Value::YArray(a).write_json(&txn, &mut json).unwrap();
+        assert!(json.starts_with(b"[\"a"));
+    }
+
     #[test]
     fn len() {
         let d = Doc::with_client_id(1);
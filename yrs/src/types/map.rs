@@ -1,8 +1,14 @@
 use crate::block::{ItemContent, ItemPosition, Prelim};
-use crate::types::{Branch, BranchRef, Entries, TypePtr, Value, TYPE_REFS_MAP};
+use crate::event::Observer;
+use crate::types::{
+    entry_changes, Branch, BranchRef, Entries, EntryChange, Events, ShallowObserver, TypePtr,
+    Value, TYPE_REFS_MAP,
+};
 use crate::*;
 use lib0::any::Any;
-use std::collections::HashMap;
+use std::cell::OnceCell;
+use std::collections::{HashMap, HashSet};
+use std::rc::Rc;
 
 /// Collection used to store key-value entries in an unordered manner. Keys are always represented
 /// as UTF-8 strings. Values can be any value type supported by Yrs: JSON-like primitives as well as
@@ -28,13 +34,24 @@ impl Map {
                     } else {
                         Any::Null
                     };
-                    res.insert(key.clone(), any);
+                    res.insert(key.to_string(), any);
                 }
             }
         }
         Any::Map(res)
     }
 
+    /// Writes all entries of a current map as a JSON object into a given `writer`. Output is
+    /// equivalent to a serialized result of [Map::to_json], but it's produced directly from map
+    /// contents, without building an intermediate [Any] structure.
+    pub fn write_json<W: std::io::Write>(
+        &self,
+        txn: &Transaction<'_>,
+        writer: &mut W,
+    ) -> std::io::Result<()> {
+        crate::utils::json::write_map(writer, txn, &self.0.borrow())
+    }
+
     /// Returns a number of entries stored within current map.
     pub fn len(&self, txn: &Transaction<'_>) -> u32 {
         let mut len = 0;
@@ -78,7 +95,7 @@ impl Map {
         let previous = self.get(txn, &key);
         let pos = {
             let inner = self.0.borrow();
-            let left = inner.map.get(&key);
+            let left = inner.map.get(key.as_str());
             ItemPosition {
                 parent: inner.ptr.clone(),
                 left: left.cloned(),
@@ -87,7 +104,7 @@ impl Map {
             }
         };
 
-        txn.create_item(&pos, value, Some(key));
+        txn.create_item(&pos, value, Some(&key));
         previous
     }
 
@@ -123,12 +140,69 @@ impl Map {
             txn.delete(ptr);
         }
     }
+
+    /// Subscribes a given callback to be called once per transaction, in which entries of this
+    /// map have been changed. Changes are described by [MapEvent::keys], which are computed only
+    /// when requested. Callback is unsubscribed once returned subscription is dropped.
+    pub fn observe<F>(&self, f: F) -> Subscription<MapEvent>
+    where
+        F: Fn(&Transaction, &MapEvent) -> () + 'static,
+    {
+        let mut inner = self.0.borrow_mut();
+        match inner
+            .observers
+            .shallow
+            .get_or_insert_with(|| ShallowObserver::Map(Observer::new()))
+        {
+            ShallowObserver::Map(observer) => observer.subscribe(f),
+            _ => panic!("Observed collection is of different type"),
+        }
+    }
+
+    /// Subscribes a given callback to be called once per transaction, in which this map or any
+    /// of its nested types have been changed. Callback is unsubscribed once returned subscription
+    /// is dropped.
+    pub fn observe_deep<F>(&self, f: F) -> Subscription<Events>
+    where
+        F: Fn(&Transaction, &Events) -> () + 'static,
+    {
+        self.0.observe_deep(f)
+    }
+}
+
+/// An event describing changes made to a [Map] within the scope of a single transaction.
+pub struct MapEvent {
+    target: Map,
+    changed: HashSet<Option<Rc<str>>>,
+    keys: OnceCell<HashMap<Rc<str>, EntryChange>>,
+}
+
+impl MapEvent {
+    pub(crate) fn new(target: Map, changed: HashSet<Option<Rc<str>>>) -> Self {
+        MapEvent {
+            target,
+            changed,
+            keys: OnceCell::new(),
+        }
+    }
+
+    /// Returns a [Map] instance, which has been changed.
+    pub fn target(&self) -> &Map {
+        &self.target
+    }
+
+    /// Returns changes made to the entries of a map, indexed by their keys. Changes are computed
+    /// on the first call, which must use a transaction this event has been emitted for.
+    pub fn keys(&self, txn: &Transaction) -> &HashMap<Rc<str>, EntryChange> {
+        self.keys
+            .get_or_init(|| entry_changes(txn, &self.target.0.borrow(), &self.changed))
+    }
 }
 
 pub struct MapIter<'a, 'txn>(Entries<'a, 'txn>);
 
 impl<'a, 'txn> Iterator for MapIter<'a, 'txn> {
-    type Item = (&'a String, Value);
+    type Item = (&'a str, Value);
 
     fn next(&mut self) -> Option<Self::Item> {
         let (key, item) = self.0.next()?;
@@ -144,7 +218,7 @@ impl<'a, 'txn> Iterator for MapIter<'a, 'txn> {
 pub struct Keys<'a, 'txn>(Entries<'a, 'txn>);
 
 impl<'a, 'txn> Iterator for Keys<'a, 'txn> {
-    type Item = &'a String;
+    type Item = &'a str;
 
     fn next(&mut self) -> Option<Self::Item> {
         let (key, _) = self.0.next()?;
@@ -196,14 +270,17 @@ impl<T: Prelim> Prelim for PrelimMap<T> {
 
 #[cfg(test)]
 mod test {
+    use crate::block::PrelimText;
     use crate::test_utils::{exchange_updates, run_scenario};
-    use crate::types::{Map, Value};
-    use crate::{Doc, PrelimArray, PrelimMap, Transaction};
+    use crate::types::{Change, EntryChange, Event, Map, TypePtr, Value};
+    use crate::{Doc, PrelimArray, PrelimJson, PrelimMap, Transaction};
     use lib0::any::Any;
     use rand::distributions::Alphanumeric;
     use rand::prelude::{SliceRandom, StdRng};
     use rand::Rng;
+    use std::cell::RefCell;
     use std::collections::HashMap;
+    use std::rc::Rc;
 
     #[test]
     fn map_basic() {
@@ -264,6 +341,46 @@ mod test {
         compare_all(&t2, &m2);
     }
 
+    #[test]
+    fn map_write_json() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let map = txn.get_map("map");
+        map.insert(&mut txn, "text".to_owned(), PrelimText("ab\tc".to_owned()));
+
+        let mut json = Vec::new();
+        map.write_json(&txn, &mut json).unwrap();
+        assert_eq!(json, br#"{"text":"ab\tc"}"#.to_vec());
+
+        map.insert(&mut txn, "text".to_owned(), 1.5);
+        map.insert(&mut txn, "removed".to_owned(), "value");
+        map.remove(&mut txn, "removed");
+        let mut json = Vec::new();
+        map.write_json(&txn, &mut json).unwrap();
+        assert_eq!(json, br#"{"text":1.5}"#.to_vec());
+    }
+
+    #[test]
+    fn map_insert_json() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let m1 = t1.get_map("map");
+        let json = lib0::json::parse(r#"{"a": [1, 2, {"b": true}, 3, 4], "s": "x"}"#).unwrap();
+        m1.insert(&mut t1, "json".to_owned(), PrelimJson(json.clone()));
+
+        // entry, its 2 fields, 2 runs of array primitives, nested map and its field
+        assert_eq!(t1.store.blocks.get(&1).unwrap().integrated_len(), 7);
+        let a = m1.get(&t1, "json").unwrap().to_json(&t1);
+        assert_eq!(a, json);
+
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        let m2 = t2.get_map("map");
+        let update = d1.encode_state_as_update_v1(&t1);
+        d2.apply_update_v1(&mut t2, update.as_slice());
+        assert_eq!(m2.to_json(&t2), m1.to_json(&t1));
+    }
+
     #[test]
     fn map_get_set() {
         let d1 = Doc::with_client_id(1);
@@ -288,6 +405,36 @@ mod test {
         assert_eq!(m2.get(&t2, &"null".to_owned()), Some(Value::Any(Any::Null)));
     }
 
+    #[test]
+    fn map_keys_are_interned() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let m1 = t1.get_map("map");
+        for i in 0..10 {
+            m1.insert(&mut t1, "key".to_owned(), i);
+        }
+
+        let update = d1.encode_state_as_update_v1(&t1);
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        d2.apply_update_v1(&mut t2, update.as_slice());
+
+        for txn in vec![&t1, &t2] {
+            // all overridden entries share the same key allocation with a map itself
+            let branch = txn.store.get_type(&TypePtr::Named("map".into())).unwrap();
+            let (key, ptr) = branch.as_ref().map.iter().next().unwrap();
+            let mut next = Some(*ptr);
+            let mut count = 0;
+            while let Some(ptr) = next {
+                let item = txn.store.blocks.get_item(&ptr).unwrap();
+                assert!(Rc::ptr_eq(key, item.parent_sub.as_ref().unwrap()));
+                next = item.left;
+                count += 1;
+            }
+            assert_eq!(count, 10);
+        }
+    }
+
     #[test]
     fn map_get_set_sync_with_conflicts() {
         let d1 = Doc::with_client_id(1);
@@ -581,4 +728,109 @@ mod test {
     fn fuzzy_test_6() {
         fuzzy(6)
     }
+
+    #[test]
+    fn observer() {
+        let doc = Doc::with_client_id(1);
+        let map = doc.transact().get_map("map");
+        let keys = Rc::new(RefCell::new(None));
+        let _sub = {
+            let keys = keys.clone();
+            map.observe(move |txn, e| {
+                keys.replace(Some(e.keys(txn).clone()));
+            })
+        };
+
+        {
+            let mut txn = doc.transact();
+            map.insert(&mut txn, "a".to_owned(), 1);
+            map.insert(&mut txn, "b".to_owned(), 2);
+        }
+        let mut expected = HashMap::new();
+        expected.insert("a".into(), EntryChange::Inserted(Value::from(1)));
+        expected.insert("b".into(), EntryChange::Inserted(Value::from(2)));
+        assert_eq!(keys.take(), Some(expected));
+
+        {
+            let mut txn = doc.transact();
+            map.insert(&mut txn, "a".to_owned(), 3);
+            map.insert(&mut txn, "a".to_owned(), 4);
+            map.remove(&mut txn, "b");
+            map.insert(&mut txn, "c".to_owned(), 5);
+            map.remove(&mut txn, "c");
+        }
+        let mut expected = HashMap::new();
+        expected.insert(
+            "a".into(),
+            EntryChange::Updated(Value::from(1), Value::from(4)),
+        );
+        expected.insert("b".into(), EntryChange::Removed(Value::from(2)));
+        assert_eq!(keys.take(), Some(expected));
+
+        // entries removed in reverse order of their insertion
+        {
+            let mut txn = doc.transact();
+            map.insert(&mut txn, "x".to_owned(), 6);
+            map.insert(&mut txn, "y".to_owned(), 7);
+        }
+        {
+            let mut txn = doc.transact();
+            map.remove(&mut txn, "y");
+            map.remove(&mut txn, "a");
+        }
+        let mut expected = HashMap::new();
+        expected.insert("a".into(), EntryChange::Removed(Value::from(4)));
+        expected.insert("y".into(), EntryChange::Removed(Value::from(7)));
+        assert_eq!(keys.take(), Some(expected));
+    }
+
+    #[test]
+    fn observe_deep() {
+        let doc = Doc::with_client_id(1);
+        let (map, array) = {
+            let mut txn = doc.transact();
+            let map = txn.get_map("map");
+            map.insert(&mut txn, "array".to_owned(), PrelimArray::from(vec![1]));
+            match map.get(&txn, "array") {
+                Some(Value::YArray(array)) => (map, array),
+                other => panic!("expected array, got {:?}", other),
+            }
+        };
+        let events = Rc::new(RefCell::new(Vec::new()));
+        let _sub = {
+            let events = events.clone();
+            map.observe_deep(move |txn, e| {
+                for event in e.iter() {
+                    let change = match event {
+                        Event::Map(e) => format!("map {:?}", e.keys(txn)),
+                        Event::Array(e) => format!("array {:?}", e.delta(txn)),
+                        _ => panic!("unexpected event"),
+                    };
+                    events.borrow_mut().push(change);
+                }
+            })
+        };
+
+        {
+            let mut txn = doc.transact();
+            array.push_back(&mut txn, 2);
+            map.insert(&mut txn, "key".to_owned(), "value");
+        }
+        let mut keys: HashMap<Rc<str>, _> = HashMap::new();
+        keys.insert("key".into(), EntryChange::Inserted(Value::from("value")));
+        let delta = vec![Change::Retain(1), Change::Added(vec![Value::from(2)])];
+        assert_eq!(
+            events.take(),
+            vec![format!("map {:?}", keys), format!("array {:?}", delta)]
+        );
+
+        // changes of removed nested types are not reported
+        {
+            let mut txn = doc.transact();
+            array.push_back(&mut txn, 3);
+            map.remove(&mut txn, "array");
+        }
+        assert_eq!(events.borrow().len(), 1);
+        assert!(events.borrow()[0].starts_with("map"));
+    }
 }
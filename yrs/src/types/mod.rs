@@ -8,11 +8,14 @@ pub use map::Map;
 pub use text::Text;
 
 use crate::block::{BlockPtr, Item, ItemContent, ItemPosition, Prelim};
-use crate::types::array::Array;
-use crate::types::xml::{XmlElement, XmlText};
+use crate::event::Observer;
+use crate::types::array::{Array, ArrayEvent, PrelimPacked};
+use crate::types::map::MapEvent;
+use crate::types::text::TextEvent;
+use crate::types::xml::{XmlElement, XmlEvent, XmlText, XmlTextEvent};
 use lib0::any::Any;
 use std::cell::{BorrowMutError, Ref, RefCell, RefMut};
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::fmt::Formatter;
 use std::rc::Rc;
 
@@ -73,6 +76,20 @@ impl BranchRef {
         self.0.try_borrow_mut()
     }
 
+    /// Subscribes a given callback to be called once per transaction with events describing
+    /// changes made to this branch and all of its nested types.
+    pub(crate) fn observe_deep<F>(&self, f: F) -> Subscription<Events>
+    where
+        F: Fn(&Transaction, &Events) -> () + 'static,
+    {
+        let mut inner = self.borrow_mut();
+        inner
+            .observers
+            .deep
+            .get_or_insert_with(Observer::new)
+            .subscribe(f)
+    }
+
     /// Converts current branch data into a [Value]. It uses a type ref information to resolve,
     /// which value variant is a correct one for this branch. Since branch represent only complex
     /// types [Value::Any] will never be returned from this method.
@@ -209,7 +226,7 @@ pub struct Branch {
     /// - [Map]: all of the map elements are based on this field. The value of each entry points
     ///   to the last modified value.
     /// - [XmlElement]: this field stores attributes assigned to a given XML node.
-    pub map: HashMap<String, BlockPtr>,
+    pub map: HashMap<Rc<str>, BlockPtr>,
 
     /// Unique identifier of a current branch node. It can be contain either a named string - which
     /// means, this branch is a root-level complex data structure - or a block identifier. In latter
@@ -228,6 +245,9 @@ pub struct Branch {
 
     /// An identifier of an underlying complex data type (eg. is it an Array or a Map).
     type_ref: TypeRefs,
+
+    /// Callbacks subscribed to the changes of a current branch node and its nested types.
+    pub(crate) observers: Observers,
 }
 
 impl Branch {
@@ -240,6 +260,7 @@ impl Branch {
             ptr,
             name,
             type_ref,
+            observers: Observers::default(),
         }
     }
 
@@ -418,6 +439,17 @@ impl Value {
         }
     }
 
+    /// Writes a JSON representation of current value into a given `writer`. Output is equivalent
+    /// to a serialized result of [Value::to_json], but nested shared types are written directly
+    /// from their contents, without building an intermediate [Any] structure.
+    pub fn write_json<W: std::io::Write>(
+        &self,
+        txn: &Transaction,
+        writer: &mut W,
+    ) -> std::io::Result<()> {
+        crate::utils::json::write_value(writer, txn, self)
+    }
+
     /// Converts current value into stringified representation.
     pub fn to_string(self, txn: &Transaction) -> String {
         match self {
@@ -441,6 +473,84 @@ where
     }
 }
 
+/// A preliminary value created from JSON-like data, ie. parsed with [lib0::json::parse]. When
+/// inserted into another Yrs collection, JSON objects become [Map]s and JSON arrays become
+/// [Array]s, while all other values are stored as they are.
+///
+/// Consecutive primitive elements of arrays are integrated as a single block, so that importing
+/// a large JSON document doesn't create a separate block for every array element.
+pub struct PrelimJson(pub Any);
+
+impl Prelim for PrelimJson {
+    fn into_content(self, _txn: &mut Transaction, ptr: TypePtr) -> (ItemContent, Option<Self>) {
+        let type_ref = match &self.0 {
+            Any::Array(_) => TYPE_REFS_ARRAY,
+            Any::Map(_) => TYPE_REFS_MAP,
+            _ => return (ItemContent::Any(vec![self.0]), None),
+        };
+        let inner = BranchRef::new(Branch::new(ptr, type_ref, None));
+        (ItemContent::Type(inner), Some(self))
+    }
+
+    fn integrate(self, txn: &mut Transaction, inner_ref: BranchRef) {
+        let parent = inner_ref.borrow().ptr.clone();
+        match self.0 {
+            Any::Map(entries) => {
+                // branch is new, so there are no existing entries to override
+                for (key, value) in entries {
+                    let pos = ItemPosition {
+                        parent: parent.clone(),
+                        left: None,
+                        right: None,
+                        index: 0,
+                    };
+                    txn.create_item(&pos, PrelimJson(value), Some(&key));
+                }
+            }
+            Any::Array(values) => {
+                let mut left = None;
+                let mut run = Vec::new();
+                for value in values {
+                    match value {
+                        Any::Array(_) | Any::Map(_) => {
+                            if !run.is_empty() {
+                                let run = PrelimPacked(ItemContent::Any(std::mem::take(&mut run)));
+                                left = Some(Self::append(txn, &parent, left, run));
+                            }
+                            left = Some(Self::append(txn, &parent, left, PrelimJson(value)));
+                        }
+                        primitive => run.push(primitive),
+                    }
+                }
+                if !run.is_empty() {
+                    Self::append(txn, &parent, left, PrelimPacked(ItemContent::Any(run)));
+                }
+            }
+            _ => {}
+        }
+    }
+}
+
+impl PrelimJson {
+    /// Inserts a `value` right after the `left` block of a `parent` array, returning a pointer to
+    /// a newly created block.
+    fn append<P: Prelim>(
+        txn: &mut Transaction,
+        parent: &TypePtr,
+        left: Option<BlockPtr>,
+        value: P,
+    ) -> BlockPtr {
+        let pos = ItemPosition {
+            parent: parent.clone(),
+            left,
+            right: None,
+            index: 0,
+        };
+        let item = txn.create_item(&pos, value, None);
+        BlockPtr::from(item.id)
+    }
+}
+
 impl std::fmt::Display for Branch {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         match self.type_ref() {
@@ -529,7 +639,7 @@ impl std::fmt::Display for Branch {
 
 pub(crate) struct Entries<'a, 'txn> {
     pub txn: &'a Transaction<'txn>,
-    iter: std::collections::hash_map::Iter<'a, String, BlockPtr>,
+    iter: std::collections::hash_map::Iter<'a, Rc<str>, BlockPtr>,
 }
 
 impl<'a, 'txn> Entries<'a, 'txn> {
@@ -541,7 +651,7 @@ impl<'a, 'txn> Entries<'a, 'txn> {
 }
 
 impl<'a, 'txn> Iterator for Entries<'a, 'txn> {
-    type Item = (&'a String, &'a Item);
+    type Item = (&'a str, &'a Item);
 
     fn next(&mut self) -> Option<Self::Item> {
         let (mut key, ptr) = self.iter.next()?;
@@ -559,7 +669,7 @@ impl<'a, 'txn> Iterator for Entries<'a, 'txn> {
             }
         }
         let item = block.unwrap();
-        Some((key, item))
+        Some((key.as_ref(), item))
     }
 }
 
@@ -597,7 +707,7 @@ pub enum TypePtr {
     Id(block::BlockPtr),
 
     /// Pointer to a root-level type.
-    Named(Rc<String>),
+    Named(Rc<str>),
 }
 
 impl std::fmt::Display for TypePtr {
@@ -609,3 +719,273 @@ impl std::fmt::Display for TypePtr {
         }
     }
 }
+
+/// Callbacks subscribed to the changes of a single [Branch]. Observers are not a part of
+/// a document state, therefore they are ignored when comparing branches.
+#[derive(Default, Clone)]
+pub(crate) struct Observers {
+    /// Callbacks notified about changes made directly to a branch.
+    pub shallow: Option<ShallowObserver>,
+    /// Callbacks notified about changes made to a branch or any of its nested types.
+    pub deep: Option<Observer<Events>>,
+}
+
+impl Observers {
+    pub fn has_shallow(&self) -> bool {
+        match &self.shallow {
+            Some(observer) => observer.has_subscribers(),
+            None => false,
+        }
+    }
+
+    pub fn has_deep(&self) -> bool {
+        match &self.deep {
+            Some(observer) => observer.has_subscribers(),
+            None => false,
+        }
+    }
+}
+
+impl Eq for Observers {}
+
+impl PartialEq for Observers {
+    fn eq(&self, _: &Self) -> bool {
+        true
+    }
+}
+
+impl std::fmt::Debug for Observers {
+    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
+        write!(f, "Observers")
+    }
+}
+
+/// Callbacks subscribed to the changes of a specific shared type.
+#[derive(Clone)]
+pub(crate) enum ShallowObserver {
+    Text(Observer<TextEvent>),
+    Array(Observer<ArrayEvent>),
+    Map(Observer<MapEvent>),
+    XmlElement(Observer<XmlEvent>),
+    XmlText(Observer<XmlTextEvent>),
+}
+
+impl ShallowObserver {
+    fn has_subscribers(&self) -> bool {
+        match self {
+            ShallowObserver::Text(o) => o.has_subscribers(),
+            ShallowObserver::Array(o) => o.has_subscribers(),
+            ShallowObserver::Map(o) => o.has_subscribers(),
+            ShallowObserver::XmlElement(o) => o.has_subscribers(),
+            ShallowObserver::XmlText(o) => o.has_subscribers(),
+        }
+    }
+
+    /// Calls subscribed callbacks, as long as a given `event` matches a type of this observer.
+    pub fn publish(&self, txn: &Transaction, event: &Event) {
+        match (self, event) {
+            (ShallowObserver::Text(o), Event::Text(e)) => o.publish(txn, e),
+            (ShallowObserver::Array(o), Event::Array(e)) => o.publish(txn, e),
+            (ShallowObserver::Map(o), Event::Map(e)) => o.publish(txn, e),
+            (ShallowObserver::XmlElement(o), Event::XmlElement(e)) => o.publish(txn, e),
+            (ShallowObserver::XmlText(o), Event::XmlText(e)) => o.publish(txn, e),
+            _ => {}
+        }
+    }
+}
+
+/// An event describing changes made to a single shared type within the scope of a transaction.
+pub enum Event {
+    Text(TextEvent),
+    Array(ArrayEvent),
+    Map(MapEvent),
+    XmlElement(XmlEvent),
+    XmlText(XmlTextEvent),
+}
+
+impl Event {
+    /// Creates an event for a given `branch`. `keys` contain entries of a branch map component,
+    /// which have been changed within a transaction.
+    pub(crate) fn new(branch: BranchRef, keys: HashSet<Option<Rc<str>>>) -> Option<Self> {
+        let type_ref = branch.borrow().type_ref();
+        match type_ref {
+            TYPE_REFS_TEXT => Some(Event::Text(TextEvent::new(Text::from(branch)))),
+            TYPE_REFS_ARRAY => Some(Event::Array(ArrayEvent::new(Array::from(branch)))),
+            TYPE_REFS_MAP => Some(Event::Map(MapEvent::new(Map::from(branch), keys))),
+            TYPE_REFS_XML_ELEMENT | TYPE_REFS_XML_FRAGMENT => Some(Event::XmlElement(
+                XmlEvent::new(XmlElement::from(branch), keys),
+            )),
+            TYPE_REFS_XML_TEXT => Some(Event::XmlText(XmlTextEvent::new(
+                XmlText::from(branch),
+                keys,
+            ))),
+            _ => None,
+        }
+    }
+
+    /// Returns a shared type, which has been changed.
+    pub fn target(&self) -> Value {
+        match self {
+            Event::Text(e) => Value::YText(e.target().clone()),
+            Event::Array(e) => Value::YArray(e.target().clone()),
+            Event::Map(e) => Value::YMap(e.target().clone()),
+            Event::XmlElement(e) => Value::YXmlElement(e.target().clone()),
+            Event::XmlText(e) => Value::YXmlText(e.target().clone()),
+        }
+    }
+}
+
+/// A batch of events passed to deep observers. It describes changes made within the scope of
+/// a single transaction to an observed type and all of its nested types, ordered from the least
+/// to the most nested ones.
+pub struct Events(Vec<Rc<Event>>);
+
+impl Events {
+    pub(crate) fn new(events: Vec<Rc<Event>>) -> Self {
+        Events(events)
+    }
+
+    /// Returns an iterator over all events in this batch.
+    pub fn iter(&self) -> impl Iterator<Item = &Event> + '_ {
+        self.0.iter().map(|e| e.as_ref())
+    }
+
+    /// Returns a number of events in this batch.
+    pub fn len(&self) -> usize {
+        self.0.len()
+    }
+}
+
+/// A run of changes made to an indexed sequence component of a [Branch] within the scope of
+/// a transaction.
+pub(crate) enum SequenceChange<'a> {
+    /// An item inserted within a transaction.
+    Added(&'a Item),
+    /// A number of elements removed within a transaction.
+    Removed(u32),
+    /// A number of elements, which have not been changed.
+    Retain(u32),
+}
+
+/// Returns changes made to an indexed sequence component of a given `branch` within the scope of
+/// a transaction. Consecutive removed and retained elements are merged together, while retained
+/// elements at the end of a sequence are skipped.
+pub(crate) fn sequence_changes<'a>(
+    txn: &'a Transaction,
+    branch: &Branch,
+) -> Vec<SequenceChange<'a>> {
+    let mut changes = Vec::new();
+    let mut ptr = branch.start;
+    while let Some(item) = ptr.and_then(|ptr| txn.store.blocks.get_item(&ptr)) {
+        ptr = item.right;
+        if !item.is_countable() {
+            continue;
+        }
+        let change = if txn.has_added(&item.id) {
+            if txn.has_deleted(&item.id) {
+                continue;
+            }
+            SequenceChange::Added(item)
+        } else if txn.has_deleted(&item.id) {
+            SequenceChange::Removed(item.len())
+        } else if !item.is_deleted() {
+            SequenceChange::Retain(item.len())
+        } else {
+            continue;
+        };
+        match (changes.last_mut(), change) {
+            (Some(SequenceChange::Removed(n)), SequenceChange::Removed(m)) => *n += m,
+            (Some(SequenceChange::Retain(n)), SequenceChange::Retain(m)) => *n += m,
+            (_, change) => changes.push(change),
+        }
+    }
+    if let Some(SequenceChange::Retain(_)) = changes.last() {
+        changes.pop();
+    }
+    changes
+}
+
+/// A change made to an indexed sequence of elements, such as [Array] or children of
+/// [XmlElement].
+#[derive(Debug, Clone, PartialEq)]
+pub enum Change {
+    /// Elements inserted at the current position.
+    Added(Vec<Value>),
+    /// A number of elements removed at the current position.
+    Removed(u32),
+    /// A number of elements, which have not been changed.
+    Retain(u32),
+}
+
+/// Returns changes made to an indexed sequence component of a given `branch` in terms of
+/// inserted and removed values.
+pub(crate) fn value_changes(txn: &Transaction, branch: &Branch) -> Vec<Change> {
+    let mut changes = Vec::new();
+    for change in sequence_changes(txn, branch) {
+        match change {
+            SequenceChange::Added(item) => {
+                let values = item.content.get_content(txn);
+                if let Some(Change::Added(last)) = changes.last_mut() {
+                    last.extend(values);
+                } else {
+                    changes.push(Change::Added(values));
+                }
+            }
+            SequenceChange::Removed(len) => changes.push(Change::Removed(len)),
+            SequenceChange::Retain(len) => changes.push(Change::Retain(len)),
+        }
+    }
+    changes
+}
+
+/// A change made to a single entry of a map component, such as [Map] entries or attributes of
+/// [XmlElement].
+#[derive(Debug, Clone, PartialEq)]
+pub enum EntryChange {
+    /// A new entry has been inserted.
+    Inserted(Value),
+    /// An existing entry value has been replaced: old value comes first, new one - second.
+    Updated(Value, Value),
+    /// An existing entry has been removed. Contains its last value.
+    Removed(Value),
+}
+
+/// Returns changes made to the entries under given `keys` of a map component of a `branch`.
+pub(crate) fn entry_changes(
+    txn: &Transaction,
+    branch: &Branch,
+    keys: &HashSet<Option<Rc<str>>>,
+) -> HashMap<Rc<str>, EntryChange> {
+    let value = |item: &Item| {
+        item.content
+            .get_content_last(txn)
+            .unwrap_or(Value::Any(Any::Undefined))
+    };
+    let mut changes = HashMap::new();
+    for key in keys.iter().flatten() {
+        let item = match branch.map.get(key) {
+            Some(ptr) => txn.store.blocks.get_item(ptr).unwrap(),
+            None => continue,
+        };
+        let change = if txn.has_added(&item.id) {
+            // find a value, that was assigned to this entry before the transaction has started
+            let mut prev = item.left.and_then(|ptr| txn.store.blocks.get_item(&ptr));
+            while let Some(p) = prev.filter(|p| txn.has_added(&p.id)) {
+                prev = p.left.and_then(|ptr| txn.store.blocks.get_item(&ptr));
+            }
+            let prev = prev.filter(|p| txn.has_deleted(&p.id));
+            match (txn.has_deleted(&item.id), prev) {
+                (true, Some(prev)) => EntryChange::Removed(value(prev)),
+                (true, None) => continue,
+                (false, Some(prev)) => EntryChange::Updated(value(prev), value(item)),
+                (false, None) => EntryChange::Inserted(value(item)),
+            }
+        } else if txn.has_deleted(&item.id) {
+            EntryChange::Removed(value(item))
+        } else {
+            continue;
+        };
+        changes.insert(key.clone(), change);
+    }
+    changes
+}
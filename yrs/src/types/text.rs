@@ -1,8 +1,9 @@
 use crate::block::{BlockPtr, ItemContent};
+use crate::event::Observer;
 use crate::transaction::Transaction;
-use crate::types::{Branch, BranchRef};
+use crate::types::{sequence_changes, Branch, BranchRef, Events, SequenceChange, ShallowObserver};
 use crate::*;
-use std::cell::Ref;
+use std::cell::{OnceCell, Ref, RefMut};
 
 /// A shared data type used for collaborative text editing. It enables multiple users to add and
 /// remove chunks of text in efficient manner. This type is internally represented as a mutable
@@ -51,6 +52,10 @@ impl Text {
         self.0.borrow()
     }
 
+    pub(crate) fn inner_mut(&self) -> RefMut<Branch> {
+        self.0.borrow_mut()
+    }
+
     pub(crate) fn find_position(
         &self,
         txn: &mut Transaction<'_>,
@@ -126,6 +131,94 @@ impl Text {
             panic!("Couldn't remove {} elements from an array. Only {} of them were successfully removed.", len, removed);
         }
     }
+
+    /// Subscribes a given callback to be called once per transaction, in which this text has
+    /// been changed. Changes are described by [TextEvent::delta], which is computed only when
+    /// requested. Callback is unsubscribed once returned subscription is dropped.
+    pub fn observe<F>(&self, f: F) -> Subscription<TextEvent>
+    where
+        F: Fn(&Transaction, &TextEvent) -> () + 'static,
+    {
+        let mut inner = self.inner_mut();
+        match inner
+            .observers
+            .shallow
+            .get_or_insert_with(|| ShallowObserver::Text(Observer::new()))
+        {
+            ShallowObserver::Text(observer) => observer.subscribe(f),
+            _ => panic!("Observed collection is of different type"),
+        }
+    }
+
+    /// Subscribes a given callback to be called once per transaction, in which this text has
+    /// been changed. Since text has no nested types, events passed to a callback describe only
+    /// the changes of this text.
+    pub fn observe_deep<F>(&self, f: F) -> Subscription<Events>
+    where
+        F: Fn(&Transaction, &Events) -> () + 'static,
+    {
+        self.0.observe_deep(f)
+    }
+}
+
+/// An event describing changes made to a [Text] within the scope of a single transaction.
+pub struct TextEvent {
+    target: Text,
+    delta: OnceCell<Vec<Delta>>,
+}
+
+impl TextEvent {
+    pub(crate) fn new(target: Text) -> Self {
+        TextEvent {
+            target,
+            delta: OnceCell::new(),
+        }
+    }
+
+    /// Returns a [Text] instance, which has been changed.
+    pub fn target(&self) -> &Text {
+        &self.target
+    }
+
+    /// Returns a list of changes made to a text, described as consecutive runs of inserted,
+    /// deleted and retained characters. Delta is computed on the first call, which must use
+    /// a transaction this event has been emitted for.
+    pub fn delta(&self, txn: &Transaction) -> &[Delta] {
+        self.delta
+            .get_or_init(|| text_delta(txn, &self.target.inner()))
+    }
+}
+
+/// A single run of changes made to a text data structure.
+#[derive(Debug, Clone, PartialEq)]
+pub enum Delta {
+    /// A chunk of text inserted at the current position.
+    Inserted(String),
+    /// A number of characters deleted at the current position.
+    Deleted(u32),
+    /// A number of characters, which have not been changed.
+    Retain(u32),
+}
+
+/// Returns changes made to a text data stored within a given `branch` as a list of [Delta]s.
+pub(crate) fn text_delta(txn: &Transaction, branch: &Branch) -> Vec<Delta> {
+    let mut delta = Vec::new();
+    for change in sequence_changes(txn, branch) {
+        match change {
+            SequenceChange::Added(item) => {
+                if let ItemContent::String(s) = &item.content {
+                    if let Some(Delta::Inserted(text)) = delta.last_mut() {
+                        text.push_str(s.as_str());
+                    } else {
+                        delta.push(Delta::Inserted(s.as_str().to_owned()));
+                    }
+                }
+            }
+            SequenceChange::Removed(len) => delta.push(Delta::Deleted(len)),
+            SequenceChange::Retain(len) => delta.push(Delta::Retain(len)),
+        }
+    }
+    delta
 }
 
 impl Into<ItemContent> for Text {
@@ -143,9 +236,12 @@ impl From<BranchRef> for Text {
 #[cfg(test)]
 mod test {
     use crate::test_utils::{run_scenario, RngExt};
+    use crate::types::text::Delta;
     use crate::Doc;
     use rand::prelude::StdRng;
     use rand::Rng;
+    use std::cell::RefCell;
+    use std::rc::Rc;
 
     #[test]
     fn append_single_character_blocks() {
@@ -495,4 +591,87 @@ mod test {
     fn fuzzy_test_3() {
         fuzzy(3)
     }
+
+    #[test]
+    fn observer() {
+        let d1 = Doc::with_client_id(1);
+        let txt = d1.transact().get_text("text");
+        let delta = Rc::new(RefCell::new(None));
+        let _sub = {
+            let delta = delta.clone();
+            txt.observe(move |txn, e| {
+                delta.replace(Some(e.delta(txn).to_vec()));
+            })
+        };
+
+        {
+            let mut txn = d1.transact();
+            txt.insert(&mut txn, 0, "abcd");
+        }
+        assert_eq!(delta.take(), Some(vec![Delta::Inserted("abcd".into())]));
+
+        // changes are batched together once per transaction
+        {
+            let mut txn = d1.transact();
+            txt.insert(&mut txn, 4, "e");
+            txt.insert(&mut txn, 5, "f");
+            txt.remove_range(&mut txn, 1, 2);
+        }
+        assert_eq!(
+            delta.take(),
+            Some(vec![
+                Delta::Retain(1),
+                Delta::Deleted(2),
+                Delta::Retain(1),
+                Delta::Inserted("ef".into())
+            ])
+        );
+
+        // remote changes are observed as well
+        let d2 = Doc::with_client_id(2);
+        {
+            let mut t1 = d1.transact();
+            let mut t2 = d2.transact();
+            d2.apply_update_v1(&mut t2, &d1.encode_state_as_update_v1(&t1));
+            t2.get_text("text").insert(&mut t2, 1, "xy");
+            let update = t2.encode_update_v1();
+            d1.apply_update_v1(&mut t1, &update);
+        }
+        assert_eq!(
+            delta.take(),
+            Some(vec![Delta::Retain(1), Delta::Inserted("xy".into())])
+        );
+
+        // inserting and deleting within the same transaction is not a change
+        {
+            let mut txn = d1.transact();
+            txt.insert(&mut txn, 0, "zz");
+            txt.remove_range(&mut txn, 0, 2);
+        }
+        assert_eq!(delta.take(), Some(vec![]));
+
+        // deletions made from right to left
+        {
+            let mut txn = d1.transact();
+            txt.remove_range(&mut txn, 5, 1);
+            txt.remove_range(&mut txn, 3, 1);
+        }
+        assert_eq!(txt.to_string(&d1.transact()), "axye");
+        assert_eq!(
+            delta.take(),
+            Some(vec![
+                Delta::Retain(3),
+                Delta::Deleted(1),
+                Delta::Retain(1),
+                Delta::Deleted(1)
+            ])
+        );
+
+        drop(_sub);
+        {
+            let mut txn = d1.transact();
+            txt.insert(&mut txn, 0, "abc");
+        }
+        assert_eq!(delta.take(), None);
+    }
 }
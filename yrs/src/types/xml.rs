@@ -1,12 +1,20 @@
-use crate::block::{Item, ItemContent, ItemPosition, Prelim};
+use crate::block::{BlockPtr, Item, ItemContent, ItemPosition, Prelim};
+use crate::event::{Observer, Subscription};
+use crate::types::text::{text_delta, Delta};
 use crate::types::{
-    Branch, BranchRef, Entries, Map, Text, TypePtr, Value, TYPE_REFS_XML_ELEMENT,
-    TYPE_REFS_XML_FRAGMENT, TYPE_REFS_XML_TEXT,
+    entry_changes, value_changes, Branch, BranchRef, Change, Entries, EntryChange, Events, Map,
+    ShallowObserver, Text, TypePtr, Value, TYPE_REFS_XML_ELEMENT, TYPE_REFS_XML_FRAGMENT,
+    TYPE_REFS_XML_TEXT,
 };
+use crate::utils::xml::{parse_fragment, XmlNode};
 use crate::Transaction;
 use lib0::any::Any;
-use std::cell::Ref;
-use std::fmt::Write;
+use std::cell::{OnceCell, Ref};
+use std::collections::{HashMap, HashSet};
+use std::io;
+use std::rc::Rc;
+
+pub use crate::utils::xml::XmlParseError;
 
 /// An return type from XML elements retrieval methods. It's an enum of all supported values, that
 /// can be nested inside of [XmlElement]. These are other [XmlElement]s or [XmlText] values.
@@ -51,26 +59,14 @@ impl XmlElement {
     /// Converts current XML node into a textual representation. This representation if flat, it
     /// doesn't include any indentation.
     pub fn to_string(&self, txn: &Transaction) -> String {
-        let inner = self.inner();
-        let mut s = String::new();
-        let tag = inner
-            .name
-            .as_ref()
-            .map(|s| s.as_str())
-            .unwrap_or(&"UNDEFINED");
-        write!(&mut s, "<{}", tag).unwrap();
-        let attributes = Attributes(inner.entries(txn));
-        for (k, v) in attributes {
-            write!(&mut s, " \"{}\"=\"{}\"", k, v).unwrap();
-        }
-        write!(&mut s, ">").unwrap();
-        for i in inner.iter(txn) {
-            for content in i.content.get_content(txn) {
-                write!(&mut s, "{}", content.to_string(txn)).unwrap();
-            }
-        }
-        write!(&mut s, "</{}>", tag).unwrap();
-        s
+        to_string(|buf| self.write_xml(txn, buf))
+    }
+
+    /// Writes a textual representation of a current XML node, produced by [XmlElement::to_string],
+    /// into a given `writer`. An entire subtree is written in a single pass, without building
+    /// intermediate strings for nested nodes.
+    pub fn write_xml<W: io::Write>(&self, txn: &Transaction, writer: &mut W) -> io::Result<()> {
+        write_element(writer, txn, &self.inner())
     }
 
     /// A tag name of a current top-level XML node, eg. node `<p></p>` has "p" as it's tag name.
@@ -95,7 +91,7 @@ impl XmlElement {
         let value = crate::block::PrelimText(attr_value.to_string());
         let pos = {
             let inner = self.inner();
-            let left = inner.map.get(&key);
+            let left = inner.map.get(key.as_str());
             ItemPosition {
                 parent: inner.ptr.clone(),
                 left: left.cloned(),
@@ -104,7 +100,7 @@ impl XmlElement {
             }
         };
 
-        txn.create_item(&pos, value, Some(key));
+        txn.create_item(&pos, value, Some(&key));
     }
 
     /// Returns a value of an attribute given its `attr_name`. Returns `None` if no such attribute
@@ -219,6 +215,23 @@ impl XmlElement {
         self.0.insert_text(txn, index)
     }
 
+    /// Parses a given `xml` fragment - a sequence of XML elements and text nodes - and inserts
+    /// all of its top-level nodes into a current XML element, starting at the given `index`.
+    /// Returns an error without modifying current element if `xml` is not a well-formed fragment.
+    ///
+    /// An entire fragment is parsed before any of its nodes is integrated. Inserted position is
+    /// looked up only once and consecutive sibling nodes are appended one after another, which
+    /// makes it much faster than inserting nodes and attributes one by one.
+    /// This method will panic if `index` is greater than the length of current XML element.
+    pub fn insert_xml(
+        &self,
+        txn: &mut Transaction,
+        index: u32,
+        xml: &str,
+    ) -> Result<(), XmlParseError> {
+        self.0.insert_xml(txn, index, xml)
+    }
+
     /// Removes a range (defined by `len`) of XML nodes from the current XML element, starting at
     /// the given `index`. Returns the result which may contain an error if a number of elements
     /// removed is lesser than the expected one provided in `len` parameter.
@@ -253,6 +266,75 @@ impl XmlElement {
     pub fn get(&self, txn: &Transaction, index: u32) -> Option<Xml> {
         self.0.get(txn, index)
     }
+
+    /// Subscribes a given callback to be called once per transaction, in which attributes or
+    /// child nodes of this XML element have been changed. Changes are described by
+    /// [XmlEvent::delta] and [XmlEvent::keys], which are computed only when requested. Callback is
+    /// unsubscribed once returned subscription is dropped.
+    pub fn observe<F>(&self, f: F) -> Subscription<XmlEvent>
+    where
+        F: Fn(&Transaction, &XmlEvent) -> () + 'static,
+    {
+        let mut inner = self.0 .0.borrow_mut();
+        match inner
+            .observers
+            .shallow
+            .get_or_insert_with(|| ShallowObserver::XmlElement(Observer::new()))
+        {
+            ShallowObserver::XmlElement(observer) => observer.subscribe(f),
+            _ => panic!("Observed collection is of different type"),
+        }
+    }
+
+    /// Subscribes a given callback to be called once per transaction, in which this XML element
+    /// or any of its descendant nodes have been changed. Callback is unsubscribed once returned
+    /// subscription is dropped.
+    pub fn observe_deep<F>(&self, f: F) -> Subscription<Events>
+    where
+        F: Fn(&Transaction, &Events) -> () + 'static,
+    {
+        self.0 .0.observe_deep(f)
+    }
+}
+
+/// An event describing changes made to a [XmlElement] within the scope of a single transaction.
+pub struct XmlEvent {
+    target: XmlElement,
+    changed: HashSet<Option<Rc<str>>>,
+    delta: OnceCell<Vec<Change>>,
+    keys: OnceCell<HashMap<Rc<str>, EntryChange>>,
+}
+
+impl XmlEvent {
+    pub(crate) fn new(target: XmlElement, changed: HashSet<Option<Rc<str>>>) -> Self {
+        XmlEvent {
+            target,
+            changed,
+            delta: OnceCell::new(),
+            keys: OnceCell::new(),
+        }
+    }
+
+    /// Returns a [XmlElement] instance, which has been changed.
+    pub fn target(&self) -> &XmlElement {
+        &self.target
+    }
+
+    /// Returns a list of changes made to the child nodes of an XML element, described as
+    /// consecutive runs of added, removed and retained nodes. Delta is computed on the first call,
+    /// which must use a transaction this event has been emitted for.
+    pub fn delta(&self, txn: &Transaction) -> &[Change] {
+        self.delta
+            .get_or_init(|| value_changes(txn, &self.target.inner()))
+    }
+
+    /// Returns changes made to the attributes of an XML element, indexed by attribute names.
+    /// Changes are computed on the first call, which must use a transaction this event has been
+    /// emitted for.
+    pub fn keys(&self, txn: &Transaction) -> &HashMap<Rc<str>, EntryChange> {
+        self.keys
+            .get_or_init(|| entry_changes(txn, &self.target.inner(), &self.changed))
+    }
 }
 
 impl Into<ItemContent> for XmlElement {
@@ -267,6 +349,87 @@ impl From<BranchRef> for XmlElement {
     }
 }
 
+/// Runs a given serializer over an in-memory buffer and returns its output as a string.
+fn to_string<F>(f: F) -> String
+where
+    F: FnOnce(&mut Vec<u8>) -> io::Result<()>,
+{
+    let mut buf = Vec::new();
+    // writing into a vector never fails
+    f(&mut buf).unwrap();
+    // serializers only ever write complete UTF-8 strings
+    unsafe { String::from_utf8_unchecked(buf) }
+}
+
+fn write_element<W: io::Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    branch: &Branch,
+) -> io::Result<()> {
+    let tag = branch
+        .name
+        .as_ref()
+        .map(|s| s.as_str())
+        .unwrap_or(&"UNDEFINED");
+    write!(writer, "<{}", tag)?;
+    for (key, item) in branch.entries(txn) {
+        write!(writer, " \"{}\"=\"", key)?;
+        match &item.content {
+            ItemContent::Type(inner) => write_text(writer, txn, &inner.borrow())?,
+            content => {
+                if let Some(value) = content.get_content_last(txn) {
+                    write!(writer, "{}", value.to_string(txn))?;
+                }
+            }
+        }
+        writer.write_all(b"\"")?;
+    }
+    writer.write_all(b">")?;
+    write_children(writer, txn, branch)?;
+    write!(writer, "</{}>", tag)
+}
+
+fn write_children<W: io::Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    branch: &Branch,
+) -> io::Result<()> {
+    for item in branch.iter(txn) {
+        if item.is_deleted() {
+            continue;
+        }
+        if let ItemContent::Type(inner) = &item.content {
+            let inner = inner.borrow();
+            match inner.type_ref & 0b1111 {
+                TYPE_REFS_XML_ELEMENT => {
+                    write_element(writer, txn, &inner)?;
+                    continue;
+                }
+                TYPE_REFS_XML_TEXT => {
+                    write_text(writer, txn, &inner)?;
+                    continue;
+                }
+                _ => {}
+            }
+        }
+        for value in item.content.get_content(txn) {
+            write!(writer, "{}", value.to_string(txn))?;
+        }
+    }
+    Ok(())
+}
+
+fn write_text<W: io::Write>(writer: &mut W, txn: &Transaction, branch: &Branch) -> io::Result<()> {
+    for item in branch.iter(txn) {
+        if !item.is_deleted() {
+            if let ItemContent::String(s) = &item.content {
+                writer.write_all(s.as_str().as_bytes())?;
+            }
+        }
+    }
+    Ok(())
+}
+
 /// Iterator over the attributes (key-value pairs represented as a strings) of an [XmlElement].
 pub struct Attributes<'a, 'txn>(Entries<'a, 'txn>);
 
@@ -281,7 +444,7 @@ impl<'a, 'txn> Iterator for Attributes<'a, 'txn> {
             .map(|v| v.to_string(self.0.txn))
             .unwrap_or(String::default());
 
-        Some((key.as_str(), value))
+        Some((key, value))
     }
 }
 
@@ -328,14 +491,13 @@ impl XmlFragment {
     }
 
     pub fn to_string(&self, txn: &Transaction) -> String {
-        let mut s = String::new();
-        let inner = self.inner();
-        for i in inner.iter(txn) {
-            for content in i.content.get_content(txn) {
-                write!(&mut s, "{}", content.to_string(txn)).unwrap();
-            }
-        }
-        s
+        to_string(|buf| self.write_xml(txn, buf))
+    }
+
+    /// Writes a textual representation of all children of a current XML fragment into a given
+    /// `writer`.
+    pub fn write_xml<W: io::Write>(&self, txn: &Transaction, writer: &mut W) -> io::Result<()> {
+        write_children(writer, txn, &self.inner())
     }
 
     pub fn insert_elem<S: ToString>(
@@ -363,6 +525,30 @@ impl XmlFragment {
         }
     }
 
+    pub fn insert_xml(
+        &self,
+        txn: &mut Transaction,
+        index: u32,
+        xml: &str,
+    ) -> Result<(), XmlParseError> {
+        let nodes = parse_fragment(xml)?;
+        let (start, parent) = {
+            let inner = self.inner();
+            if index <= inner.len() {
+                (inner.start, inner.ptr.clone())
+            } else {
+                panic!("Cannot insert item at index over the length of an array")
+            }
+        };
+        let (left, right) = if index == 0 {
+            (None, None)
+        } else {
+            Branch::index_to_ptr(txn, start, index)
+        };
+        insert_nodes(txn, parent, left, right, nodes);
+        Ok(())
+    }
+
     pub fn remove(&self, txn: &mut Transaction, index: u32, len: u32) {
         let removed = self.0.remove_at(txn, index, len);
         if removed != len {
@@ -590,6 +776,11 @@ impl XmlText {
         self.0.to_string(txn)
     }
 
+    /// Writes a string representation of a current XML text into a given `writer`.
+    pub fn write_xml<W: io::Write>(&self, txn: &Transaction, writer: &mut W) -> io::Result<()> {
+        write_text(writer, txn, &self.inner())
+    }
+
     pub fn remove_attribute(&self, txn: &mut Transaction, attr_name: &str) {
         self.inner().remove(txn, attr_name);
     }
@@ -604,7 +795,7 @@ impl XmlText {
         let value = crate::block::PrelimText(attr_value.to_string());
         let pos = {
             let inner = self.inner();
-            let left = inner.map.get(&key);
+            let left = inner.map.get(key.as_str());
             ItemPosition {
                 parent: inner.ptr.clone(),
                 left: left.cloned(),
@@ -613,7 +804,7 @@ impl XmlText {
             }
         };
 
-        txn.create_item(&pos, value, Some(key));
+        txn.create_item(&pos, value, Some(&key));
     }
 
     pub fn get_attribute(&self, txn: &Transaction, attr_name: &str) -> Option<String> {
@@ -672,6 +863,74 @@ impl XmlText {
     pub fn remove_range(&self, txn: &mut Transaction, index: u32, len: u32) {
         self.0.remove_range(txn, index, len)
     }
+
+    /// Subscribes a given callback to be called once per transaction, in which contents or
+    /// attributes of this XML text have been changed. Changes are described by
+    /// [XmlTextEvent::delta] and [XmlTextEvent::keys], which are computed only when requested.
+    /// Callback is unsubscribed once returned subscription is dropped.
+    pub fn observe<F>(&self, f: F) -> Subscription<XmlTextEvent>
+    where
+        F: Fn(&Transaction, &XmlTextEvent) -> () + 'static,
+    {
+        let mut inner = self.0.inner_mut();
+        match inner
+            .observers
+            .shallow
+            .get_or_insert_with(|| ShallowObserver::XmlText(Observer::new()))
+        {
+            ShallowObserver::XmlText(observer) => observer.subscribe(f),
+            _ => panic!("Observed collection is of different type"),
+        }
+    }
+
+    /// Subscribes a given callback to be called once per transaction, in which this XML text has
+    /// been changed. Callback is unsubscribed once returned subscription is dropped.
+    pub fn observe_deep<F>(&self, f: F) -> Subscription<Events>
+    where
+        F: Fn(&Transaction, &Events) -> () + 'static,
+    {
+        self.0.observe_deep(f)
+    }
+}
+
+/// An event describing changes made to a [XmlText] within the scope of a single transaction.
+pub struct XmlTextEvent {
+    target: XmlText,
+    changed: HashSet<Option<Rc<str>>>,
+    delta: OnceCell<Vec<Delta>>,
+    keys: OnceCell<HashMap<Rc<str>, EntryChange>>,
+}
+
+impl XmlTextEvent {
+    pub(crate) fn new(target: XmlText, changed: HashSet<Option<Rc<str>>>) -> Self {
+        XmlTextEvent {
+            target,
+            changed,
+            delta: OnceCell::new(),
+            keys: OnceCell::new(),
+        }
+    }
+
+    /// Returns a [XmlText] instance, which has been changed.
+    pub fn target(&self) -> &XmlText {
+        &self.target
+    }
+
+    /// Returns a list of changes made to the contents of an XML text, described as consecutive
+    /// runs of inserted, deleted and retained characters. Delta is computed on the first call,
+    /// which must use a transaction this event has been emitted for.
+    pub fn delta(&self, txn: &Transaction) -> &[Delta] {
+        self.delta
+            .get_or_init(|| text_delta(txn, &self.target.inner()))
+    }
+
+    /// Returns changes made to the attributes of an XML text, indexed by attribute names.
+    /// Changes are computed on the first call, which must use a transaction this event has been
+    /// emitted for.
+    pub fn keys(&self, txn: &Transaction) -> &HashMap<Rc<str>, EntryChange> {
+        self.keys
+            .get_or_init(|| entry_changes(txn, &self.target.inner(), &self.changed))
+    }
 }
 
 impl Into<ItemContent> for XmlText {
@@ -711,6 +970,74 @@ impl Prelim for PrelimXml {
     fn integrate(self, _txn: &mut Transaction, _inner_ref: BranchRef) {}
 }
 
+impl Prelim for XmlNode {
+    fn into_content(self, _txn: &mut Transaction, ptr: TypePtr) -> (ItemContent, Option<Self>) {
+        let inner = match self {
+            XmlNode::Element(name, attributes, children) => {
+                let inner = Branch::new(ptr, TYPE_REFS_XML_ELEMENT, Some(name));
+                let remainder = XmlNode::Element(String::new(), attributes, children);
+                return (ItemContent::Type(BranchRef::new(inner)), Some(remainder));
+            }
+            XmlNode::Text(_) => BranchRef::new(Branch::new(ptr, TYPE_REFS_XML_TEXT, None)),
+        };
+        (ItemContent::Type(inner), Some(self))
+    }
+
+    fn integrate(self, txn: &mut Transaction, inner_ref: BranchRef) {
+        let parent = inner_ref.borrow().ptr.clone();
+        match self {
+            XmlNode::Element(_, attributes, children) => {
+                for (key, value) in attributes {
+                    // duplicated attributes override the previous ones
+                    let left = inner_ref.borrow().map.get(key.as_str()).cloned();
+                    let pos = ItemPosition {
+                        parent: parent.clone(),
+                        left,
+                        right: None,
+                        index: 0,
+                    };
+                    txn.create_item(&pos, crate::block::PrelimText(value), Some(&key));
+                }
+                insert_nodes(txn, parent, None, None, children);
+            }
+            XmlNode::Text(text) => {
+                if !text.is_empty() {
+                    let pos = ItemPosition {
+                        parent,
+                        left: None,
+                        right: None,
+                        index: 0,
+                    };
+                    txn.create_item(&pos, crate::block::PrelimText(text), None);
+                }
+            }
+        }
+    }
+}
+
+/// Inserts a sequence of sibling `nodes` into a `parent` XML node between `left` and `right`
+/// blocks. Every node is placed right after the previously inserted one, without looking up
+/// positions by their index.
+fn insert_nodes(
+    txn: &mut Transaction,
+    parent: TypePtr,
+    mut left: Option<BlockPtr>,
+    mut right: Option<BlockPtr>,
+    nodes: Vec<XmlNode>,
+) {
+    for node in nodes {
+        let pos = ItemPosition {
+            parent: parent.clone(),
+            left,
+            right,
+            index: 0,
+        };
+        let item = txn.create_item(&pos, node, None);
+        left = Some(BlockPtr::from(item.id));
+        right = item.right;
+    }
+}
+
 fn next_sibling(inner: Ref<Branch>, txn: &Transaction) -> Option<Xml> {
     let mut current = inner
         .item
@@ -764,7 +1091,11 @@ fn parent(inner: Ref<Branch>, txn: &Transaction) -> Option<XmlElement> {
 #[cfg(test)]
 mod test {
     use crate::types::xml::Xml;
+    use crate::types::{Change, EntryChange, Value};
     use crate::Doc;
+    use lib0::any::Any;
+    use std::cell::RefCell;
+    use std::rc::Rc;
 
     #[test]
     fn insert_attribute() {
@@ -884,6 +1215,53 @@ mod test {
         assert_eq!(r2.to_string(&t2), expected);
     }
 
+    #[test]
+    fn write_xml() {
+        let doc = Doc::with_client_id(1);
+        let mut txn = doc.transact();
+        let root = txn.get_xml_element("root");
+        let div = root.push_elem_back(&mut txn, "div");
+        div.insert_attribute(&mut txn, "class", "a");
+        let text = div.push_text_back(&mut txn);
+        text.push(&mut txn, "hello");
+        root.push_elem_back(&mut txn, "span");
+        root.remove_range(&mut txn, 1, 1);
+
+        let expected = "<UNDEFINED><div \"class\"=\"a\">hello</div></UNDEFINED>";
+        let mut buf = Vec::new();
+        root.write_xml(&txn, &mut buf).unwrap();
+        assert_eq!(buf, expected.as_bytes());
+        assert_eq!(root.to_string(&txn), expected);
+
+        let mut buf = Vec::new();
+        text.write_xml(&txn, &mut buf).unwrap();
+        assert_eq!(buf, b"hello");
+    }
+
+    #[test]
+    fn insert_xml() {
+        let d1 = Doc::with_client_id(1);
+        let mut t1 = d1.transact();
+        let r1 = t1.get_xml_element("root");
+        r1.push_elem_back(&mut t1, "a");
+        r1.push_elem_back(&mut t1, "z");
+        r1.insert_xml(&mut t1, 1, r#"<p id="x">hi <b>there</b></p>&lt;text"#)
+            .unwrap();
+        assert!(r1.insert_xml(&mut t1, 0, "<p>").is_err());
+        assert_eq!(r1.len(&t1), 4);
+
+        let expected =
+            "<UNDEFINED><a></a><p \"id\"=\"x\">hi <b>there</b></p><text<z></z></UNDEFINED>";
+        assert_eq!(r1.to_string(&t1), expected);
+
+        let d2 = Doc::with_client_id(2);
+        let mut t2 = d2.transact();
+        let r2 = t2.get_xml_element("root");
+        let u1 = d1.encode_state_as_update_v1(&t1);
+        d2.apply_update_v1(&mut t2, u1.as_slice());
+        assert_eq!(r2.to_string(&t2), expected);
+    }
+
     #[test]
     fn serialization_compatibility() {
         let d1 = Doc::with_client_id(1);
@@ -912,4 +1290,46 @@ mod test {
         let u1 = d1.encode_state_as_update_v1(&t1);
         assert_eq!(u1.as_slice(), expected);
     }
+
+    #[test]
+    fn observer() {
+        let doc = Doc::with_client_id(1);
+        let xml = doc.transact().get_xml_element("xml");
+        let changes = Rc::new(RefCell::new(None));
+        let _sub = {
+            let changes = changes.clone();
+            xml.observe(move |txn, e| {
+                changes.replace(Some((e.delta(txn).to_vec(), e.keys(txn).clone())));
+            })
+        };
+
+        let p = {
+            let mut txn = doc.transact();
+            let p = xml.push_elem_back(&mut txn, "p");
+            xml.insert_attribute(&mut txn, "class", "main");
+            p
+        };
+        let (delta, keys) = changes.take().unwrap();
+        assert_eq!(delta, vec![Change::Added(vec![Value::YXmlElement(p)])]);
+        assert_eq!(
+            keys.get("class"),
+            Some(&EntryChange::Inserted(Value::Any(Any::String(
+                "main".into()
+            ))))
+        );
+
+        {
+            let mut txn = doc.transact();
+            xml.push_text_front(&mut txn);
+            xml.remove_attribute(&mut txn, "class");
+        }
+        let (delta, keys) = changes.take().unwrap();
+        assert_eq!(delta.len(), 1);
+        assert_eq!(
+            keys.get("class"),
+            Some(&EntryChange::Removed(Value::Any(Any::String(
+                "main".into()
+            ))))
+        );
+    }
 }
@@ -9,12 +9,13 @@ use crate::types::TypePtr;
 use crate::updates::decoder::{Decode, Decoder};
 use crate::updates::encoder::{Encode, Encoder};
 use crate::utils::client_hasher::ClientHasher;
+use crate::utils::interner::StringInterner;
 use crate::{StateVector, Transaction, ID};
+use lib0::encoding::uvar_len;
 use std::cmp::Ordering;
 use std::collections::hash_map::Entry;
 use std::collections::{HashMap, VecDeque};
 use std::hash::BuildHasherDefault;
-use std::rc::Rc;
 
 #[derive(Debug, PartialEq, Default, Clone)]
 pub(crate) struct UpdateBlocks {
@@ -57,7 +58,7 @@ impl UpdateBlocks {
                 blocks = if right_ptr.id.client == client {
                     blocks
                 } else {
-                    self.clients.get_mut(&right_ptr.id.client).unwrap()
+                    self.clients.get_mut(&{ right_ptr.id.client }).unwrap()
                 };
                 let right = &mut blocks[right_ptr.pivot()];
                 if let Some(right_item) = right.as_item_mut() {
@@ -188,7 +189,7 @@ impl Update {
             while let Some(mut block) = stack_head {
                 let id = block.id();
                 if local_sv.contains(id) {
-                    let offset = local_sv.get(&id.client) as i32 - id.clock as i32;
+                    let offset = local_sv.get(&{ id.client }) as i32 - id.clock as i32;
                     if let Some(dep) = Self::missing(&block, &local_sv) {
                         stack.push(block);
                         // get the struct reader that has the missing struct
@@ -343,7 +344,7 @@ impl Update {
         }
     }
 
-    fn decode_block<D: Decoder>(id: ID, decoder: &mut D) -> Block {
+    fn decode_block<D: Decoder>(id: ID, decoder: &mut D, keys: &mut StringInterner) -> Block {
         let info = decoder.read_info();
         match info {
             BLOCK_SKIP_REF_NUMBER => {
@@ -368,7 +369,7 @@ impl Update {
                 };
                 let parent = if cant_copy_parent_info {
                     if decoder.read_parent_info() {
-                        TypePtr::Named(Rc::new(decoder.read_string().to_owned()))
+                        TypePtr::Named(keys.intern(decoder.read_string()))
                     } else {
                         TypePtr::Id(BlockPtr::from(decoder.read_left_id()))
                     }
@@ -376,7 +377,7 @@ impl Update {
                     TypePtr::Unknown
                 };
                 let parent_sub = if cant_copy_parent_info && (info & HAS_PARENT_SUB != 0) {
-                    Some(decoder.read_string().to_owned())
+                    Some(keys.intern(decoder.read_string()))
                 } else {
                     None
                 };
@@ -397,6 +398,45 @@ impl Update {
     }
 
     pub(crate) fn encode_diff<E: Encoder>(&self, remote_sv: &StateVector, encoder: &mut E) {
+        let clients = self.diff_clients(remote_sv);
+
+        // finish lazy struct writing
+        encoder.write_uvar(clients.len());
+        for (client, offset, blocks) in clients {
+            encoder.write_uvar(blocks.len());
+            encoder.write_uvar(client);
+
+            let mut block = blocks[0];
+            encoder.write_uvar(block.id().clock + offset);
+            block.encode_with_offset(encoder, offset);
+            for i in 1..blocks.len() {
+                block = blocks[i];
+                block.encode_with_offset(encoder, 0);
+            }
+        }
+        self.delete_set.encode(encoder);
+    }
+
+    /// Returns a number of bytes required to encode a difference between current update and
+    /// a remote peer state using [crate::updates::encoder::EncoderV1], as done by [Update::encode_diff].
+    pub(crate) fn encoded_diff_len(&self, remote_sv: &StateVector) -> usize {
+        let clients = self.diff_clients(remote_sv);
+        let mut len = uvar_len(clients.len());
+        for (client, offset, blocks) in clients {
+            len += uvar_len(blocks.len())
+                + uvar_len(client)
+                + uvar_len(blocks[0].id().clock + offset)
+                + blocks[0].encoded_len_with_offset(offset);
+            for block in &blocks[1..] {
+                len += block.encoded_len_with_offset(0);
+            }
+        }
+        len + self.delete_set.encoded_len()
+    }
+
+    /// Returns blocks which are not known to a remote peer, grouped by their clients in
+    /// descending order, together with an offset of the first block of each client.
+    fn diff_clients(&self, remote_sv: &StateVector) -> Vec<(u64, u32, Vec<&Block>)> {
         let mut clients = HashMap::new();
         for (client, blocks) in self.blocks.clients.iter() {
             let remote_clock = remote_sv.get(client);
@@ -422,25 +462,13 @@ impl Update {
         }
 
         // Write higher clients first ⇒ sort by clientID & clock and remove decoders without content
-        let mut sorted_clients: Vec<_> =
-            clients.iter().filter(|(_, (_, q))| !q.is_empty()).collect();
-        sorted_clients.sort_by(|&(x_id, _), &(y_id, _)| y_id.cmp(x_id));
-
-        // finish lazy struct writing
-        encoder.write_uvar(sorted_clients.len());
-        for (&client, (offset, blocks)) in sorted_clients {
-            encoder.write_uvar(blocks.len());
-            encoder.write_uvar(client);
-
-            let mut block = blocks[0];
-            encoder.write_uvar(block.id().clock + offset);
-            block.encode_with_offset(encoder, *offset);
-            for i in 1..blocks.len() {
-                block = blocks[i];
-                block.encode_with_offset(encoder, 0);
-            }
-        }
-        self.delete_set.encode(encoder);
+        let mut sorted_clients: Vec<_> = clients
+            .into_iter()
+            .filter(|(_, (_, q))| !q.is_empty())
+            .map(|(client, (offset, blocks))| (client, offset, blocks))
+            .collect();
+        sorted_clients.sort_by(|(x_id, _, _), (y_id, _, _)| y_id.cmp(x_id));
+        sorted_clients
     }
 
     pub fn merge_updates<T: std::iter::IntoIterator<Item = Update>>(block_stores: T) -> Update {
@@ -500,7 +528,8 @@ impl Update {
                         }
                     }
                 } else {
-                    right.id().client.cmp(&left.id().client)
+                    let (left, right) = (left.id().client, right.id().client);
+                    right.cmp(&left)
                 }
             });
 
@@ -628,6 +657,10 @@ impl Encode for Update {
     fn encode<E: Encoder>(&self, encoder: &mut E) {
         self.encode_diff(&StateVector::default(), encoder);
     }
+
+    fn encoded_len(&self) -> usize {
+        self.encoded_diff_len(&StateVector::default())
+    }
 }
 
 impl Decode for Update {
@@ -640,6 +673,8 @@ impl Decode for Update {
                 BuildHasherDefault::default(),
             ),
         };
+        // keys and root type names are usually repeated many times within a single update
+        let mut keys = StringInterner::new();
         for _ in 0..clients_len {
             let blocks_len = decoder.read_uvar::<u32>() as usize;
 
@@ -652,7 +687,7 @@ impl Decode for Update {
 
             for _ in 0..blocks_len {
                 let id = ID::new(client, clock);
-                let block = Self::decode_block(id, decoder);
+                let block = Self::decode_block(id, decoder, &mut keys);
                 clock += block.len();
                 blocks.push_back(block);
             }
@@ -761,7 +796,6 @@ mod test {
     use crate::updates::decoder::{Decode, DecoderV1};
     use crate::{Doc, ID};
     use lib0::decoding::Cursor;
-    use std::rc::Rc;
 
     #[test]
     fn update_decode() {
@@ -786,7 +820,7 @@ mod test {
         let u = Update::decode(&mut decoder);
 
         let id = ID::new(2026372272, 0);
-        let block = u.blocks.clients.get(&id.client).unwrap();
+        let block = u.blocks.clients.get(&{ id.client }).unwrap();
         let mut expected = Vec::new();
         expected.push(Block::Item(Item::new(
             id,
@@ -794,8 +828,8 @@ mod test {
             None,
             None,
             None,
-            TypePtr::Named(Rc::new("".to_owned())),
-            Some("keyB".to_owned()),
+            TypePtr::Named("".into()),
+            Some("keyB".into()),
             ItemContent::Any(vec!["valueB".into()]),
         )));
         assert_eq!(block, &expected);
@@ -1,6 +1,8 @@
 use crate::*;
 use lib0::decoding::Read;
+use lib0::number::Uint;
 use lib0::{any::Any, decoding::Cursor};
+use std::ops::Range;
 
 /// A trait that can be implemented by any other type in order to support lib0 decoding capability.
 pub trait Decode: Sized {
@@ -29,6 +31,16 @@ pub trait Decoder: Read {
     /// Read the number of clients stored in encoded [DeleteSet].
     fn read_ds_len(&mut self) -> u32;
 
+    /// Read `len` clock ranges of a single client stored in encoded [DeleteSet].
+    fn read_ds_ranges(&mut self, len: u32, ranges: &mut Vec<Range<u32>>) {
+        ranges.reserve(len as usize);
+        for _ in 0..len {
+            let clock = self.read_ds_clock();
+            let len = self.read_ds_len();
+            ranges.push(clock..(clock + len));
+        }
+    }
+
     /// Read left origin of a currently decoded [Block].
     fn read_left_id(&mut self) -> block::ID;
 
@@ -96,6 +108,22 @@ impl<'a> Read for DecoderV1<'a> {
     fn read(&mut self, len: usize) -> &[u8] {
         self.cursor.read(len)
     }
+
+    fn read_uvar<T: Uint>(&mut self) -> T {
+        self.cursor.read_uvar()
+    }
+
+    fn read_ivar(&mut self) -> i64 {
+        self.cursor.read_ivar()
+    }
+
+    fn read_uvar_into<T: Uint>(&mut self, len: usize, out: &mut Vec<T>) {
+        self.cursor.read_uvar_into(len, out)
+    }
+
+    fn read_string(&mut self) -> &str {
+        self.cursor.read_string()
+    }
 }
 
 impl<'a> Decoder for DecoderV1<'a> {
@@ -111,6 +139,15 @@ impl<'a> Decoder for DecoderV1<'a> {
         self.read_uvar()
     }
 
+    fn read_ds_ranges(&mut self, len: u32, ranges: &mut Vec<Range<u32>>) {
+        let mut values: Vec<u32> = Vec::with_capacity(len as usize * 2);
+        self.read_uvar_into(len as usize * 2, &mut values);
+        ranges.reserve(len as usize);
+        for pair in values.chunks_exact(2) {
+            ranges.push(pair[0]..(pair[0] + pair[1]));
+        }
+    }
+
     fn read_left_id(&mut self) -> ID {
         self.read_id()
     }
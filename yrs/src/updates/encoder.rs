@@ -1,14 +1,28 @@
 use crate::*;
 use lib0::any::Any;
 use lib0::encoding::Write;
+use lib0::number::Uint;
+use std::iter::once;
+use std::ops::Range;
 
 /// A trait that can be implemented by any other type in order to support lib0 encoding capability.
 pub trait Encode {
     fn encode<E: Encoder>(&self, encoder: &mut E);
 
+    /// Returns a number of bytes required to encode current value using [EncoderV1], so that
+    /// an output buffer of the right size can be allocated up front.
+    ///
+    /// By default it encodes current value into a temporary buffer and returns its length.
+    /// Types encoded on hot paths override it with a cheaper computation.
+    fn encoded_len(&self) -> usize {
+        let mut encoder = EncoderV1::new();
+        self.encode(&mut encoder);
+        encoder.buf.len()
+    }
+
     /// Helper function for encoding 1st version of lib0 encoding.
     fn encode_v1(&self) -> Vec<u8> {
-        let mut encoder = EncoderV1::new();
+        let mut encoder = EncoderV1::with_capacity(self.encoded_len());
         self.encode(&mut encoder);
         encoder.to_vec()
     }
@@ -33,6 +47,14 @@ pub trait Encoder: Write {
     /// Write a number of client entries used by currently encoded [DeleteSet].
     fn write_ds_len(&mut self, len: u32);
 
+    /// Write a sequence of clock ranges of a single client of currently encoded [DeleteSet].
+    fn write_ds_ranges(&mut self, ranges: &[Range<u32>]) {
+        for range in ranges {
+            self.write_ds_clock(range.start);
+            self.write_ds_len(range.end - range.start);
+        }
+    }
+
     /// Write unique identifier of a currently encoded [Block]'s left origin.
     fn write_left_id(&mut self, id: &block::ID);
 
@@ -64,17 +86,39 @@ pub trait Encoder: Write {
     fn write_key(&mut self, string: &str);
 }
 
+/// Encoder using 1st version of lib0 encoding.
 pub struct EncoderV1 {
     buf: Vec<u8>,
 }
 
 impl EncoderV1 {
     pub fn new() -> Self {
+        Self::with_capacity(1024)
+    }
+
+    /// Creates a new encoder with an output buffer able to fit `capacity` bytes without
+    /// reallocating. Exact capacity can be computed using [Encode::encoded_len].
+    pub fn with_capacity(capacity: usize) -> Self {
         EncoderV1 {
-            buf: Vec::with_capacity(1024),
+            buf: Vec::with_capacity(capacity),
         }
     }
 
+    /// Writes data encoded so far into a given `writer` and clears it from the encoder, but
+    /// only once there are at least `min_len` bytes of it. This way the same encoder can be used
+    /// to stream a large update in chunks.
+    pub(crate) fn flush_to<W: std::io::Write>(
+        &mut self,
+        writer: &mut W,
+        min_len: usize,
+    ) -> std::io::Result<()> {
+        if !self.buf.is_empty() && self.buf.len() >= min_len {
+            writer.write_all(&self.buf)?;
+            self.buf.clear();
+        }
+        Ok(())
+    }
+
     fn write_id(&mut self, id: &ID) {
         self.write_uvar(id.client);
         self.write_uvar(id.clock);
@@ -89,6 +133,19 @@ impl Write for EncoderV1 {
     fn write(&mut self, buf: &[u8]) {
         self.buf.write(buf)
     }
+
+    fn write_uvar_slice<T: Uint + Copy>(&mut self, values: &[T]) {
+        self.buf.write_uvar_slice(values)
+    }
+
+    fn write_uvar_iter<T, I>(&mut self, count: usize, values: I)
+    where
+        T: Uint,
+        I: IntoIterator<Item = T>,
+        I::IntoIter: Clone,
+    {
+        self.buf.write_uvar_iter(count, values)
+    }
 }
 
 impl Encoder for EncoderV1 {
@@ -108,6 +165,13 @@ impl Encoder for EncoderV1 {
         self.write_uvar(len)
     }
 
+    fn write_ds_ranges(&mut self, ranges: &[Range<u32>]) {
+        let values = ranges
+            .iter()
+            .flat_map(|range| once(range.start).chain(once(range.end - range.start)));
+        self.write_uvar_iter(ranges.len() * 2, values)
+    }
+
     fn write_left_id(&mut self, id: &ID) {
         self.write_id(id)
     }
@@ -0,0 +1,69 @@
+use std::collections::HashSet;
+use std::rc::Rc;
+
+/// A string interner, which deduplicates strings used repeatedly across a single document, such
+/// as map keys, XML attribute names or root type names. Every distinct string is allocated only
+/// once and then shared as a reference-counted [Rc] among all structures that use it.
+///
+/// Interned strings are never removed, since the number of distinct keys used by a document is
+/// usually very small compared to the number of blocks referencing them.
+#[derive(Debug, Default)]
+pub(crate) struct StringInterner {
+    strings: HashSet<Rc<str>>,
+}
+
+impl StringInterner {
+    pub fn new() -> Self {
+        StringInterner::default()
+    }
+
+    /// Returns a shared reference to a given string `value`. If the same string has been interned
+    /// before, its existing allocation is reused.
+    pub fn intern(&mut self, value: &str) -> Rc<str> {
+        if let Some(existing) = self.strings.get(value) {
+            existing.clone()
+        } else {
+            let rc: Rc<str> = Rc::from(value);
+            self.strings.insert(rc.clone());
+            rc
+        }
+    }
+
+    /// Returns a shared reference to a string equal to a given `value`. Unlike [Self::intern]
+    /// it reuses a `value` allocation if no such string has been interned before.
+    pub fn intern_rc(&mut self, value: &Rc<str>) -> Rc<str> {
+        if let Some(existing) = self.strings.get(value) {
+            existing.clone()
+        } else {
+            self.strings.insert(value.clone());
+            value.clone()
+        }
+    }
+
+    /// Returns a number of distinct strings interned so far.
+    #[cfg(test)]
+    pub fn len(&self) -> usize {
+        self.strings.len()
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::utils::interner::StringInterner;
+    use std::rc::Rc;
+
+    #[test]
+    fn intern_reuses_allocation() {
+        let mut interner = StringInterner::new();
+        let a = interner.intern("key");
+        let b = interner.intern(&"key".to_string());
+        let c = interner.intern("other");
+        assert!(Rc::ptr_eq(&a, &b));
+        assert!(!Rc::ptr_eq(&a, &c));
+
+        let d: Rc<str> = Rc::from("key");
+        let d = interner.intern_rc(&d);
+        assert!(Rc::ptr_eq(&a, &d));
+        assert_eq!(interner.len(), 2);
+    }
+}
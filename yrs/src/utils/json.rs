@@ -0,0 +1,181 @@
+use crate::block::{Item, ItemContent};
+use crate::types::{Branch, Value};
+use crate::Transaction;
+use lib0::any::Any;
+use lib0::json::{write_any, write_escaped, write_f64, write_string};
+use std::io::{Result, Write};
+
+/// Writes a JSON representation of a given `value` into a `writer`. It produces the same output
+/// as serializing a result of [Value::to_json], but it walks over the blocks of shared types
+/// directly instead of building an intermediate [Any] tree.
+pub(crate) fn write_value<W: Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    value: &Value,
+) -> Result<()> {
+    match value {
+        Value::Any(any) => write_any(writer, any),
+        Value::YText(text) => write_text(writer, txn, text.inner().start),
+        Value::YArray(array) => array.write_json(txn, writer),
+        Value::YMap(map) => map.write_json(txn, writer),
+        Value::YXmlElement(xml) => write_string(writer, &xml.to_string(txn)),
+        Value::YXmlText(xml) => write_string(writer, &xml.to_string(txn)),
+    }
+}
+
+/// Writes a sequence of string chunks of a text, starting from block at a given `start` pointer,
+/// as a single JSON string.
+fn write_text<W: Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    mut start: Option<crate::block::BlockPtr>,
+) -> Result<()> {
+    writer.write_all(b"\"")?;
+    while let Some(item) = start.and_then(|ptr| txn.store.blocks.get_item(&ptr)) {
+        if !item.is_deleted() {
+            if let ItemContent::String(s) = &item.content {
+                write_escaped(writer, s.as_str())?;
+            }
+        }
+        start = item.right;
+    }
+    writer.write_all(b"\"")
+}
+
+/// Writes all elements of an indexed sequence of a given branch as a JSON array.
+pub(crate) fn write_array<W: Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    branch: &Branch,
+) -> Result<()> {
+    writer.write_all(b"[")?;
+    let mut first = true;
+    let mut ptr = branch.start;
+    while let Some(item) = ptr.and_then(|ptr| txn.store.blocks.get_item(&ptr)) {
+        if !item.is_deleted() && item.is_countable() {
+            write_content(writer, txn, &item.content, &mut first)?;
+        }
+        ptr = item.right;
+    }
+    writer.write_all(b"]")
+}
+
+/// Writes all entries of a given branch map component as a JSON object.
+pub(crate) fn write_map<W: Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    branch: &Branch,
+) -> Result<()> {
+    writer.write_all(b"{")?;
+    let mut first = true;
+    for (key, ptr) in branch.map.iter() {
+        if let Some(item) = txn.store.blocks.get_item(ptr) {
+            if !item.is_deleted() {
+                if !first {
+                    writer.write_all(b",")?;
+                }
+                first = false;
+                write_string(writer, key)?;
+                writer.write_all(b":")?;
+                write_content_last(writer, txn, item)?;
+            }
+        }
+    }
+    writer.write_all(b"}")
+}
+
+/// Writes all elements of a given block content as consecutive JSON array elements. Produces
+/// the same elements as [ItemContent::get_content].
+fn write_content<W: Write>(
+    writer: &mut W,
+    txn: &Transaction,
+    content: &ItemContent,
+    first: &mut bool,
+) -> Result<()> {
+    let mut separator = |writer: &mut W| -> Result<()> {
+        if !std::mem::replace(first, false) {
+            writer.write_all(b",")?;
+        }
+        Ok(())
+    };
+    match content {
+        ItemContent::Any(values) => {
+            for value in values.iter() {
+                separator(writer)?;
+                write_any(writer, value)?;
+            }
+        }
+        ItemContent::F64Array(values) => {
+            for value in values.iter() {
+                separator(writer)?;
+                write_f64(writer, *value)?;
+            }
+        }
+        ItemContent::I64Array(values) => {
+            for value in values.iter() {
+                separator(writer)?;
+                write!(writer, "{}", value)?;
+            }
+        }
+        ItemContent::Binary(buf) => {
+            separator(writer)?;
+            write_any(writer, &Any::Buffer(buf.clone()))?;
+        }
+        ItemContent::Doc(_, value) => {
+            separator(writer)?;
+            write_any(writer, value)?;
+        }
+        ItemContent::JSON(values) => {
+            for value in values.iter() {
+                separator(writer)?;
+                write_string(writer, value)?;
+            }
+        }
+        ItemContent::Embed(value) => {
+            separator(writer)?;
+            write_string(writer, value)?;
+        }
+        ItemContent::String(value) => {
+            let mut buf = [0u8; 4];
+            for c in value.chars() {
+                separator(writer)?;
+                write_string(writer, c.encode_utf8(&mut buf))?;
+            }
+        }
+        ItemContent::Type(branch) => {
+            separator(writer)?;
+            write_value(writer, txn, &branch.clone().into_value(txn))?;
+        }
+        ItemContent::Deleted(_) | ItemContent::Format(_, _) => {}
+    }
+    Ok(())
+}
+
+/// Writes the last element of a given item content as a JSON value, or `null` if content has no
+/// value. Produces the same value as [ItemContent::get_content_last].
+fn write_content_last<W: Write>(writer: &mut W, txn: &Transaction, item: &Item) -> Result<()> {
+    match &item.content {
+        ItemContent::Any(values) => match values.last() {
+            Some(value) => write_any(writer, value),
+            None => writer.write_all(b"null"),
+        },
+        ItemContent::F64Array(values) => match values.last() {
+            Some(value) => write_f64(writer, *value),
+            None => writer.write_all(b"null"),
+        },
+        ItemContent::I64Array(values) => match values.last() {
+            Some(value) => write!(writer, "{}", value),
+            None => writer.write_all(b"null"),
+        },
+        ItemContent::JSON(values) => match values.last() {
+            Some(value) => write_string(writer, value),
+            None => writer.write_all(b"null"),
+        },
+        ItemContent::Binary(buf) => write_any(writer, &Any::Buffer(buf.clone())),
+        ItemContent::Doc(_, value) => write_any(writer, value),
+        ItemContent::Embed(value) => write_string(writer, value),
+        ItemContent::String(value) => write_string(writer, value.as_str()),
+        ItemContent::Type(branch) => write_value(writer, txn, &branch.clone().into_value(txn)),
+        ItemContent::Deleted(_) | ItemContent::Format(_, _) => writer.write_all(b"null"),
+    }
+}
@@ -1 +1,4 @@
 pub mod client_hasher;
+pub(crate) mod interner;
+pub(crate) mod json;
+pub(crate) mod xml;
@@ -0,0 +1,272 @@
+/// Error returned when parsing an invalid XML fragment.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct XmlParseError {
+    /// Byte offset in the parsed input at which the error has been detected.
+    pub offset: usize,
+    /// Description of what was expected at a given offset.
+    pub reason: &'static str,
+}
+
+impl std::fmt::Display for XmlParseError {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{} at offset {}", self.reason, self.offset)
+    }
+}
+
+impl std::error::Error for XmlParseError {}
+
+/// A node of a parsed XML fragment.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub(crate) enum XmlNode {
+    /// XML element with its tag name, attributes (in order of their declaration) and child nodes.
+    Element(String, Vec<(String, String)>, Vec<XmlNode>),
+    Text(String),
+}
+
+/// Parses an XML fragment - a sequence of XML elements and text nodes - with entity references
+/// resolved. Comments, processing instructions and document type declarations are skipped, while
+/// CDATA sections are treated as text.
+///
+/// Parser doesn't use recursion, so that deeply nested inputs cannot overflow the stack.
+pub(crate) fn parse_fragment(xml: &str) -> Result<Vec<XmlNode>, XmlParseError> {
+    let mut parser = Parser {
+        src: xml,
+        buf: xml.as_bytes(),
+        pos: 0,
+    };
+    parser.parse()
+}
+
+struct Parser<'a> {
+    src: &'a str,
+    buf: &'a [u8],
+    pos: usize,
+}
+
+/// Element, which children are being parsed.
+struct Frame {
+    name: String,
+    attributes: Vec<(String, String)>,
+    children: Vec<XmlNode>,
+}
+
+impl<'a> Parser<'a> {
+    fn error(&self, reason: &'static str) -> XmlParseError {
+        XmlParseError {
+            offset: self.pos,
+            reason,
+        }
+    }
+
+    fn starts_with(&self, prefix: &str) -> bool {
+        self.buf[self.pos..].starts_with(prefix.as_bytes())
+    }
+
+    fn skip_whitespace(&mut self) {
+        while let Some(b' ' | b'\t' | b'\n' | b'\r') = self.buf.get(self.pos) {
+            self.pos += 1;
+        }
+    }
+
+    /// Moves right after the next occurrence of a given `terminator`.
+    fn skip_past(&mut self, terminator: &str) -> Result<&'a str, XmlParseError> {
+        match self.src[self.pos..].find(terminator) {
+            Some(i) => {
+                let skipped = &self.src[self.pos..self.pos + i];
+                self.pos += i + terminator.len();
+                Ok(skipped)
+            }
+            None => Err(self.error("unterminated markup")),
+        }
+    }
+
+    fn parse(&mut self) -> Result<Vec<XmlNode>, XmlParseError> {
+        let mut root = Vec::new();
+        let mut stack: Vec<Frame> = Vec::new();
+        while self.pos < self.buf.len() {
+            let node = if self.starts_with("<!--") {
+                self.pos += 4;
+                self.skip_past("-->")?;
+                continue;
+            } else if self.starts_with("<![CDATA[") {
+                self.pos += 9;
+                XmlNode::Text(self.skip_past("]]>")?.to_owned())
+            } else if self.starts_with("<?") || self.starts_with("<!") {
+                self.skip_past(">")?;
+                continue;
+            } else if self.starts_with("</") {
+                self.pos += 2;
+                let name = self.parse_name()?;
+                self.skip_whitespace();
+                if !self.starts_with(">") {
+                    return Err(self.error("expected '>'"));
+                }
+                match stack.pop() {
+                    Some(frame) if frame.name == name => {
+                        self.pos += 1;
+                        XmlNode::Element(frame.name, frame.attributes, frame.children)
+                    }
+                    _ => return Err(self.error("unexpected closing tag")),
+                }
+            } else if self.starts_with("<") {
+                self.pos += 1;
+                let name = self.parse_name()?.to_owned();
+                let attributes = self.parse_attributes()?;
+                if self.starts_with("/>") {
+                    self.pos += 2;
+                    XmlNode::Element(name, attributes, Vec::new())
+                } else {
+                    self.pos += 1;
+                    stack.push(Frame {
+                        name,
+                        attributes,
+                        children: Vec::new(),
+                    });
+                    continue;
+                }
+            } else {
+                let end = self.src[self.pos..]
+                    .find('<')
+                    .map(|i| self.pos + i)
+                    .unwrap_or(self.buf.len());
+                let text = self.decode(end)?;
+                XmlNode::Text(text)
+            };
+
+            let children = match stack.last_mut() {
+                Some(frame) => &mut frame.children,
+                None => &mut root,
+            };
+            // adjacent text and CDATA sections form a single text node
+            match (children.last_mut(), node) {
+                (Some(XmlNode::Text(prev)), XmlNode::Text(text)) => prev.push_str(&text),
+                (_, node) => children.push(node),
+            }
+        }
+        if stack.is_empty() {
+            Ok(root)
+        } else {
+            Err(self.error("unclosed element"))
+        }
+    }
+
+    fn parse_name(&mut self) -> Result<&'a str, XmlParseError> {
+        let start = self.pos;
+        while let Some(&b) = self.buf.get(self.pos) {
+            match b {
+                b' ' | b'\t' | b'\n' | b'\r' | b'/' | b'>' | b'=' | b'<' | b'"' | b'\'' => break,
+                _ => self.pos += 1,
+            }
+        }
+        if self.pos == start {
+            Err(self.error("expected name"))
+        } else {
+            Ok(&self.src[start..self.pos])
+        }
+    }
+
+    /// Parses attributes of an opening tag, stopping right before its closing `>` or `/>`.
+    fn parse_attributes(&mut self) -> Result<Vec<(String, String)>, XmlParseError> {
+        let mut attributes = Vec::new();
+        loop {
+            self.skip_whitespace();
+            if self.starts_with(">") || self.starts_with("/>") {
+                return Ok(attributes);
+            }
+            let name = self.parse_name()?.to_owned();
+            self.skip_whitespace();
+            if !self.starts_with("=") {
+                return Err(self.error("expected '='"));
+            }
+            self.pos += 1;
+            self.skip_whitespace();
+            let quote = match self.buf.get(self.pos) {
+                Some(&q @ (b'"' | b'\'')) => q as char,
+                _ => return Err(self.error("expected quoted attribute value")),
+            };
+            self.pos += 1;
+            let end = match self.src[self.pos..].find(quote) {
+                Some(i) => self.pos + i,
+                None => return Err(self.error("unterminated attribute value")),
+            };
+            let value = self.decode(end)?;
+            self.pos += 1;
+            attributes.push((name, value));
+        }
+    }
+
+    /// Reads characters up to the `end` offset, resolving entity references on the way.
+    fn decode(&mut self, end: usize) -> Result<String, XmlParseError> {
+        let mut result = String::with_capacity(end - self.pos);
+        while let Some(i) = self.src[self.pos..end].find('&') {
+            result.push_str(&self.src[self.pos..self.pos + i]);
+            self.pos += i;
+            let len = match self.src[self.pos..end].find(';') {
+                Some(len) => len,
+                None => return Err(self.error("unterminated entity reference")),
+            };
+            let c = match &self.src[self.pos + 1..self.pos + len] {
+                "lt" => Some('<'),
+                "gt" => Some('>'),
+                "amp" => Some('&'),
+                "quot" => Some('"'),
+                "apos" => Some('\''),
+                entity => {
+                    let code = if let Some(hex) = entity.strip_prefix("#x") {
+                        u32::from_str_radix(hex, 16).ok()
+                    } else if let Some(dec) = entity.strip_prefix('#') {
+                        dec.parse().ok()
+                    } else {
+                        None
+                    };
+                    code.and_then(std::char::from_u32)
+                }
+            };
+            match c {
+                Some(c) => result.push(c),
+                None => return Err(self.error("invalid entity reference")),
+            }
+            self.pos += len + 1;
+        }
+        result.push_str(&self.src[self.pos..end]);
+        self.pos = end;
+        Ok(result)
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use crate::utils::xml::{parse_fragment, XmlNode};
+
+    #[test]
+    fn parse_xml_fragment() {
+        let xml = r#"<?xml version="1.0"?><!-- comment -->
+            <p class="a" id='b &amp; c'>hello &lt;<b>world</b><![CDATA[<raw>]]>&#33;</p><br/>"#;
+        let nodes = parse_fragment(xml).unwrap();
+        let expected = vec![
+            XmlNode::Text("\n            ".to_owned()),
+            XmlNode::Element(
+                "p".to_owned(),
+                vec![
+                    ("class".to_owned(), "a".to_owned()),
+                    ("id".to_owned(), "b & c".to_owned()),
+                ],
+                vec![
+                    XmlNode::Text("hello <".to_owned()),
+                    XmlNode::Element(
+                        "b".to_owned(),
+                        vec![],
+                        vec![XmlNode::Text("world".to_owned())],
+                    ),
+                    XmlNode::Text("<raw>!".to_owned()),
+                ],
+            ),
+            XmlNode::Element("br".to_owned(), vec![], vec![]),
+        ];
+        assert_eq!(nodes, expected);
+
+        for invalid in &["<p>", "<p></b>", "</p>", "<p a=1/>", "a &foo; b", "<!-- x"] {
+            assert!(parse_fragment(invalid).is_err(), "{} should fail", invalid);
+        }
+    }
+}
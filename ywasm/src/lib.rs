@@ -17,7 +17,7 @@ use yrs::types::{
     TYPE_REFS_XML_ELEMENT, TYPE_REFS_XML_TEXT,
 };
 use yrs::updates::decoder::{Decode, DecoderV1};
-use yrs::updates::encoder::{Encode, Encoder, EncoderV1};
+use yrs::updates::encoder::Encode;
 use yrs::{
     Array, DeleteSet, Doc, Map, StateVector, Text, Transaction, Update, Xml, XmlElement, XmlText,
 };
@@ -443,14 +443,12 @@ impl YTransaction {
     /// ```
     #[wasm_bindgen(js_name = diffV1)]
     pub fn diff_v1(&self, vector: Option<Uint8Array>) -> Uint8Array {
-        let mut encoder = EncoderV1::new();
         let sv = if let Some(vector) = vector {
             StateVector::decode_v1(vector.to_vec().as_slice())
         } else {
             StateVector::default()
         };
-        self.0.encode_diff(&sv, &mut encoder);
-        let payload = encoder.to_vec();
+        let payload = self.0.encode_diff_v1(&sv);
         Uint8Array::from(&payload[..payload.len()])
     }
 
@@ -1057,8 +1055,8 @@ impl Drop for YMapIterator {
     }
 }
 
-impl<'a> From<Option<(&'a String, Value)>> for IteratorNext {
-    fn from(entry: Option<(&'a String, Value)>) -> Self {
+impl<'a> From<Option<(&'a str, Value)>> for IteratorNext {
+    fn from(entry: Option<(&'a str, Value)>) -> Self {
         match entry {
             None => IteratorNext::finished(),
             Some((k, v)) => {